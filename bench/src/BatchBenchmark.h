@@ -0,0 +1,180 @@
+/*
+ * AI Dance Mirror
+ *
+ * Multi stream batching benchmark.
+ */
+#pragma once
+
+#include "BenchUtils.h"
+#include "StreamBatcher.h"
+#include "FrameSources.h"
+
+/// \class BatchBenchmark
+/// \brief frames per second for 1 to N streams: one model run per stream
+///        vs. one batched run for all streams
+///
+/// every stream has its own style and frames, either from its own input
+/// source or generated; each step stylizes one frame of every stream, the
+/// separate case runs them one after the other on the same model, the
+/// batched case through StreamBatcher
+class BatchBenchmark {
+	public:
+
+		/// load the model and inputs and run 1..streams streams, inputs are
+		/// frame source specs used in turn by the streams, empty for
+		/// generated frames; returns false if the model or an input could not
+		/// be loaded
+		bool run(const std::string & modelPath, const std::vector<std::string> & inputs,
+		         int streams, int frames, int width, int height) {
+			styleTransfer.setUseTexture(false); // no GL context
+			if(!styleTransfer.setup(width, height, modelPath)) {
+				return false;
+			}
+			streams = std::min(std::max(streams, 1), (int)StreamBatcher::MAX_STREAMS);
+			for(int i = 0; i < streams; i++) {
+				ofPixels pixels;
+				SyntheticFrameSource::render(pixels, i * 50, ofxStyleTransfer::STYLE_W, ofxStyleTransfer::STYLE_H);
+				styles.push_back(styleTransfer.prepareStyle(pixels));
+				sequences.emplace_back();
+				if(inputs.empty()) {
+					// a few distinct frames per stream, cycled
+					for(int f = 0; f < std::min(frames, 30); f++) {
+						sequences.back().emplace_back();
+						SyntheticFrameSource::render(sequences.back().back().pixels, i * 100 + f, width, height);
+					}
+				}
+				else if(!loadFrames(inputs[i % inputs.size()], std::min(frames, 30), sequences.back())) {
+					return false;
+				}
+			}
+
+			std::cout << width << "x" << height << ", " << frames << " steps per stream count" << std::endl;
+			std::cout << "streams  separate fps  batched fps  speedup  batch ms" << std::endl;
+			for(int count = 1; count <= streams; count++) {
+				double separate = measureSeparate(count, frames);
+				StreamBatcher::Stats stats;
+				double batched = measureBatched(count, frames, stats);
+				std::cout << std::left << std::setw(9) << count
+				          << std::setw(14) << ofToString(separate, 2)
+				          << std::setw(13) << ofToString(batched, 2)
+				          << std::setw(9) << (ofToString(batched / std::max(separate, 1e-6), 2) + "x")
+				          << ofToString(stats.inference, 1) << std::endl;
+			}
+			return true;
+		}
+
+	protected:
+
+		/// a frame of a stream
+		struct StreamFrame {
+			ofPixels pixels;
+			PixelSpan::Layout layout = PixelSpan::RGB;
+		};
+
+		/// one model run per stream and step, returns frames per second
+		double measureSeparate(int streams, int steps) {
+			int warmup = 2;
+			BenchTimer timer;
+			for(int step = -warmup; step < steps; step++) {
+				if(step == 0) {
+					timer.reset();
+				}
+				for(int i = 0; i < streams; i++) {
+					float * data = nullptr;
+					cppflow::tensor input = buffers.allocate({1, styleTransfer.getModelHeight(),
+					                                          styleTransfer.getModelWidth(), 3}, data);
+					preprocess(frame(i, step + warmup), data, styleTransfer.getModelWidth(), styleTransfer.getModelHeight());
+					ofPixels pixels;
+					ofxStyleTransfer::tensorToPixels(styleTransfer.run(input, styleTransfer.getStyleTensor(styles[i])),
+					                                 pixels, styleTransfer.getWidth(), styleTransfer.getHeight());
+				}
+			}
+			return streams * steps / std::max(timer.elapsed() / 1000.0, 1e-6);
+		}
+
+		/// one batched run per step, returns frames per second
+		double measureBatched(int streams, int steps, StreamBatcher::Stats & stats) {
+			StreamBatcher batcher;
+			batcher.start(styleTransfer, streams, 1000); // always full batches
+			for(int i = 0; i < streams; i++) {
+				batcher.setStyle(i, styles[i]);
+			}
+			int warmup = 2;
+			BenchTimer timer;
+			for(int step = -warmup; step < steps; step++) {
+				if(step == 0) {
+					timer.reset();
+				}
+				for(int i = 0; i < streams; i++) {
+					batcher.submit(i, frame(i, step + warmup), nullptr, step + warmup, ofGetElapsedTimeMicros());
+				}
+				// wait for every stream's output
+				std::vector<bool> done(streams, false);
+				int remaining = streams;
+				while(remaining > 0) {
+					for(int i = 0; i < streams; i++) {
+						if(!done[i] && batcher.poll(i)) {
+							done[i] = true;
+							remaining--;
+						}
+					}
+					if(remaining > 0) {
+						std::this_thread::sleep_for(std::chrono::microseconds(100));
+					}
+				}
+			}
+			double seconds = timer.elapsed() / 1000.0;
+			stats = batcher.getStats();
+			batcher.stop();
+			return streams * steps / std::max(seconds, 1e-6);
+		}
+
+		/// frame of stream i at step
+		PixelSpan frame(int stream, int step) const {
+			const StreamFrame & frame = sequences[stream][step % sequences[stream].size()];
+			return PixelSpan(frame.pixels.getData(), frame.pixels.getWidth(), frame.pixels.getHeight(), frame.layout);
+		}
+
+		/// read up to count frames of an input into memory
+		static bool loadFrames(const std::string & spec, int count, std::vector<StreamFrame> & frames) {
+			std::shared_ptr<FrameSource> source = createFrameSource(spec);
+			if(!source) {
+				return false;
+			}
+			source->setPacing(FrameSource::PACING_FAST);
+			source->setLoop(true);
+			if(!source->open()) {
+				std::cout << "failed to open " << spec << std::endl;
+				return false;
+			}
+			Frame frame;
+			int timeouts = 0;
+			while((int)frames.size() < count && timeouts < 10) {
+				frame.releaseExternal();
+				if(!source->grab(frame)) {
+					timeouts++;
+					continue;
+				}
+				PixelSpan span = frame.getSpan();
+				StreamFrame copy;
+				copy.layout = span.layout;
+				copy.pixels.allocate(span.width, span.height, span.getNumChannels());
+				for(int y = 0; y < span.height; y++) {
+					std::memcpy(copy.pixels.getData() + y * copy.pixels.getBytesStride(),
+					            span.row(y), copy.pixels.getBytesStride());
+				}
+				frames.push_back(std::move(copy));
+			}
+			source->close();
+			if(frames.empty()) {
+				std::cout << "no frames from " << spec << std::endl;
+				return false;
+			}
+			return true;
+		}
+
+		ofxStyleTransfer styleTransfer;
+		TensorBufferPool buffers; ///< separate run inputs
+		std::vector<ofxStyleTransfer::Style> styles; ///< one per stream
+		std::vector<std::vector<StreamFrame>> sequences; ///< frames per stream
+};
@@ -0,0 +1,168 @@
+/*
+ * AI Dance Mirror
+ *
+ * Benchmark timing helpers.
+ */
+#pragma once
+
+#include "ofMain.h"
+#include <chrono>
+#include <iomanip>
+#include <fstream>
+#include <limits>
+#include <sys/resource.h>
+
+/// \class BenchTimer
+/// \brief wall clock stopwatch in ms
+class BenchTimer {
+	public:
+
+		BenchTimer() {
+			reset();
+		}
+
+		/// restart
+		void reset() {
+			start = Clock::now();
+		}
+
+		/// elapsed ms since the last reset
+		double elapsed() const {
+			return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		}
+
+	private:
+		typedef std::chrono::steady_clock Clock;
+		Clock::time_point start;
+};
+
+/// \class BenchSamples
+/// \brief collects timing samples and reports summary statistics
+class BenchSamples {
+	public:
+
+		void add(double value) {
+			values.push_back(value);
+			sorted = false;
+		}
+
+		void clear() {
+			values.clear();
+		}
+
+		std::size_t size() const {return values.size();}
+
+		double mean() const {
+			if(values.empty()) {
+				return 0;
+			}
+			double sum = 0;
+			for(auto v : values) {
+				sum += v;
+			}
+			return sum / values.size();
+		}
+
+		/// nearest rank percentile, p in 0-100
+		double percentile(double p) {
+			if(values.empty()) {
+				return 0;
+			}
+			if(!sorted) {
+				std::sort(values.begin(), values.end());
+				sorted = true;
+			}
+			std::size_t rank = (std::size_t)std::ceil(p / 100.0 * values.size());
+			return values[std::min(std::max(rank, (std::size_t)1), values.size()) - 1];
+		}
+
+		double median() {return percentile(50);}
+
+	private:
+		std::vector<double> values;
+		bool sorted = false;
+};
+
+/// time iterations of fn after a few warm-up calls, returns samples in ms
+template<typename Function>
+BenchSamples benchmark(Function fn, int iterations, int warmup=3) {
+	for(int i = 0; i < warmup; i++) {
+		fn();
+	}
+	BenchSamples samples;
+	for(int i = 0; i < iterations; i++) {
+		BenchTimer timer;
+		fn();
+		samples.add(timer.elapsed());
+	}
+	return samples;
+}
+
+/// reset the peak resident set size, Linux only: afterwards peakMemory()
+/// reports the peak since this call instead of since process start
+inline void resetPeakMemory() {
+	std::ofstream clear("/proc/self/clear_refs");
+	if(clear) {
+		clear << "5";
+	}
+}
+
+/// peak resident set size in MB
+inline double peakMemory() {
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while(std::getline(status, line)) {
+		if(line.compare(0, 6, "VmHWM:") == 0) {
+			return ofToDouble(line.substr(6)) / 1024.0; // kB
+		}
+	}
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss / 1024.0; // kB on Linux
+}
+
+/// peak signal to noise ratio of two RGB images of the same size in dB,
+/// infinity if they are identical
+inline double psnr(const ofPixels & a, const ofPixels & b) {
+	double sum = 0;
+	for(std::size_t i = 0; i < a.size(); i++) {
+		double d = (double)a[i] - b[i];
+		sum += d * d;
+	}
+	double mse = sum / std::max(a.size(), (std::size_t)1);
+	return (mse > 0 ? 10 * std::log10(255.0 * 255.0 / mse) : std::numeric_limits<double>::infinity());
+}
+
+/// structural similarity of two RGB images of the same size on luma, 0 - 1,
+/// with 8x8 box windows every 4 pixels instead of the Gaussian window of
+/// the reference implementation
+inline double ssim(const ofPixels & a, const ofPixels & b) {
+	const int w = (int)a.getWidth(), h = (int)a.getHeight();
+	const int channels = (int)a.getNumChannels();
+	auto luma = [&](const ofPixels & p, int x, int y) {
+		const unsigned char * c = p.getData() + ((std::size_t)y * w + x) * channels;
+		return 0.299 * c[0] + 0.587 * c[1] + 0.114 * c[2];
+	};
+	const double c1 = (0.01 * 255) * (0.01 * 255), c2 = (0.03 * 255) * (0.03 * 255);
+	const int size = 8, step = 4;
+	double total = 0;
+	int windows = 0;
+	for(int y = 0; y + size <= h; y += step) {
+		for(int x = 0; x + size <= w; x += step) {
+			double sa = 0, sb = 0, saa = 0, sbb = 0, sab = 0;
+			for(int j = y; j < y + size; j++) {
+				for(int i = x; i < x + size; i++) {
+					double va = luma(a, i, j), vb = luma(b, i, j);
+					sa += va; sb += vb;
+					saa += va * va; sbb += vb * vb; sab += va * vb;
+				}
+			}
+			const double n = size * size;
+			double ma = sa / n, mb = sb / n;
+			double va = saa / n - ma * ma, vb = sbb / n - mb * mb, cov = sab / n - ma * mb;
+			total += ((2 * ma * mb + c1) * (2 * cov + c2)) / ((ma * ma + mb * mb + c1) * (va + vb + c2));
+			windows++;
+		}
+	}
+	return (windows > 0 ? total / windows : 1);
+}
@@ -0,0 +1,174 @@
+/*
+ * AI Dance Mirror
+ *
+ * SIMD pixel kernel verification & micro-benchmark.
+ */
+#pragma once
+
+#include "BenchUtils.h"
+#include "PixelKernels.h"
+#include <cstring>
+#include <limits>
+#include <random>
+
+/// \class KernelBenchmark
+/// \brief checks every supported PixelKernels instruction set bit-exact
+///        against the scalar reference, then times them
+///
+/// verification uses random data with odd lengths to exercise the scalar
+/// tails plus edge values for the float -> u8 path (negative, > 1, NaN, inf,
+/// values right at the rounding boundaries)
+class KernelBenchmark {
+	public:
+
+		/// verify & time all kernels, returns false on any mismatch
+		bool run(int iterations) {
+			std::vector<PixelKernels::Isa> isas;
+			for(auto isa : {PixelKernels::ISA_SCALAR, PixelKernels::ISA_SSE41,
+			                PixelKernels::ISA_AVX2, PixelKernels::ISA_NEON}) {
+				if(PixelKernels::isSupported(isa)) {
+					isas.push_back(isa);
+				}
+			}
+			PixelKernels::Isa detected = PixelKernels::activeIsa();
+
+			bool ok = true;
+			for(auto isa : isas) {
+				int failures = verify(isa);
+				std::cout << "verify " << std::left << std::setw(8) << PixelKernels::isaName(isa)
+				          << (failures ? "FAILED (" + ofToString(failures) + " mismatches)" : "ok")
+				          << std::endl;
+				ok = ok && failures == 0;
+			}
+
+			// 1280x736 model input / output
+			const std::size_t pixels = 1280 * 736;
+			std::vector<uint8_t> rgba(pixels * 4), rgb(pixels * 3);
+			std::vector<float> values(pixels * 3);
+			fillBytes(rgba);
+			fillFloats(values, false);
+			std::cout << "kernel (1280x736)   ";
+			for(auto isa : isas) {
+				std::cout << std::setw(10) << PixelKernels::isaName(isa);
+			}
+			std::cout << std::endl;
+			printTimings("rgb -> float ms", isas, iterations, [&]() {
+				PixelKernels::toFloat(rgba.data(), values.data(), pixels, PixelSpan::RGB);
+			});
+			printTimings("bgra -> float ms", isas, iterations, [&]() {
+				PixelKernels::toFloat(rgba.data(), values.data(), pixels, PixelSpan::BGRA);
+			});
+			fillFloats(values, false);
+			printTimings("float -> u8 ms", isas, iterations, [&]() {
+				PixelKernels::toUnsignedChar(values.data(), rgb.data(), values.size());
+			});
+			printTimings("rgba -> rgb ms", isas, iterations, [&]() {
+				PixelKernels::rgbaToRgb(rgba.data(), rgb.data(), pixels);
+			});
+			std::vector<float> scales(pixels * 3), offsets(pixels * 3);
+			fillFloats(scales, false);
+			fillFloats(offsets, false);
+			printTimings("a * x + b -> u8 ms", isas, iterations, [&]() {
+				PixelKernels::affineToUnsignedChar(scales.data(), values.data(), offsets.data(),
+				                                   rgb.data(), values.size());
+			});
+
+			PixelKernels::setIsa(detected);
+			std::cout << "active: " << PixelKernels::isaName(detected) << std::endl;
+			return ok;
+		}
+
+		/// compare all kernels of an instruction set with the scalar reference,
+		/// returns the number of mismatching lengths / layouts
+		int verify(PixelKernels::Isa isa) {
+			const std::vector<std::size_t> lengths = {0, 1, 2, 3, 5, 7, 8, 15, 16, 17, 31, 33, 63, 64, 65, 257, 1001, 4099};
+			const std::vector<PixelSpan::Layout> layouts = {PixelSpan::RGB, PixelSpan::BGR, PixelSpan::RGBA, PixelSpan::BGRA};
+			int failures = 0;
+			for(auto length : lengths) {
+				std::vector<uint8_t> src(length * 4 + 1);
+				fillBytes(src);
+				for(auto layout : layouts) {
+					std::vector<float> expected(length * 3 + 1, -1), actual(length * 3 + 1, -1);
+					PixelKernels::scalar::toFloat(src.data(), expected.data(), length, layout);
+					PixelKernels::setIsa(isa);
+					PixelKernels::toFloat(src.data(), actual.data(), length, layout);
+					if(std::memcmp(expected.data(), actual.data(), actual.size() * sizeof(float)) != 0) {
+						failures++;
+					}
+				}
+
+				std::vector<uint8_t> expected(length * 3 + 1, 0xAA), actual(length * 3 + 1, 0xAA);
+				PixelKernels::scalar::rgbaToRgb(src.data(), expected.data(), length);
+				PixelKernels::setIsa(isa);
+				PixelKernels::rgbaToRgb(src.data(), actual.data(), length);
+				if(expected != actual) {
+					failures++;
+				}
+
+				std::vector<float> values(length * 3);
+				fillFloats(values, true);
+				PixelKernels::scalar::toUnsignedChar(values.data(), expected.data(), values.size());
+				PixelKernels::setIsa(isa);
+				PixelKernels::toUnsignedChar(values.data(), actual.data(), values.size());
+				if(expected != actual) {
+					failures++;
+				}
+
+				std::vector<float> scales(length * 3), offsets(length * 3);
+				fillFloats(scales, true);
+				fillFloats(offsets, true);
+				PixelKernels::scalar::affineToUnsignedChar(scales.data(), values.data(), offsets.data(),
+				                                           expected.data(), values.size());
+				PixelKernels::setIsa(isa);
+				PixelKernels::affineToUnsignedChar(scales.data(), values.data(), offsets.data(),
+				                                   actual.data(), values.size());
+				if(expected != actual) {
+					failures++;
+				}
+			}
+			return failures;
+		}
+
+	private:
+
+		template<typename Function>
+		void printTimings(const std::string & name, const std::vector<PixelKernels::Isa> & isas,
+		                  int iterations, Function fn) {
+			std::cout << std::left << std::setw(20) << name;
+			for(auto isa : isas) {
+				PixelKernels::setIsa(isa);
+				std::cout << std::setw(10) << ofToString(benchmark(fn, iterations).median(), 3);
+			}
+			std::cout << std::endl;
+		}
+
+		void fillBytes(std::vector<uint8_t> & data) {
+			std::uniform_int_distribution<int> dist(0, 255);
+			for(auto & v : data) {
+				v = (uint8_t)dist(random);
+			}
+		}
+
+		/// random floats, optionally mixed with out of range & special values
+		void fillFloats(std::vector<float> & data, bool edges) {
+			const float special[] = {
+				-1.f, -0.f, 0.f, 1.f, 2.f, 1.f / 255.f, 254.5f / 255.f, 0.5f / 255.f,
+				std::numeric_limits<float>::quiet_NaN(),
+				std::numeric_limits<float>::infinity(),
+				-std::numeric_limits<float>::infinity(),
+				std::numeric_limits<float>::max()
+			};
+			std::uniform_real_distribution<float> dist(edges ? -0.25f : 0.f, edges ? 1.25f : 1.f);
+			std::uniform_int_distribution<int> pick(0, 7);
+			for(auto & v : data) {
+				v = (edges && pick(random) == 0) ? special[pick(random) + 4] : dist(random);
+			}
+			if(edges) {
+				for(std::size_t i = 0; i < data.size() && i < 12; i++) {
+					data[i] = special[i];
+				}
+			}
+		}
+
+		std::mt19937 random{1234};
+};
@@ -0,0 +1,290 @@
+/*
+ * AI Dance Mirror
+ *
+ * Reduced precision inference: calibration set export & quality vs. speed.
+ */
+#pragma once
+
+#include "BenchUtils.h"
+#include "ofxStyleTransfer.h"
+#include "FrameSources.h"
+
+/// \class PrecisionBenchmark
+/// \brief CPU speed, memory & output quality of each precision against fp32
+///
+/// every precision runs the same frames on the CPU, loaded & run exactly as
+/// the app does with --device cpu --precision <name>, through
+/// ofxStyleTransfer::loadNetwork() & run():
+///   * fp32: the model as saved, the reference output
+///   * fp16: mixed precision graph rewrite, bfloat16 through oneDNN on the CPU,
+///           in a ModelSession with InferenceDevice::getSessionOptions()
+///   * int8: the quantized variant <model>.int8, see calibrate()
+///
+/// outputs are compared to the fp32 output of the same frame as 8 bit RGB
+/// with PSNR & SSIM, memory is the peak resident set growth while loading &
+/// running the session
+///
+/// calibrate() writes the frames & styles for int8 post-training
+/// quantization to <model>.calibration, quantize_model.sh reads them
+class PrecisionBenchmark {
+	public:
+
+		/// benchmark settings
+		struct Options {
+			std::string modelPath; ///< model folder
+			std::string input = "synthetic"; ///< frame source spec, ie. a recording
+			std::string styleFolder; ///< style images, synthetic style if empty
+			std::vector<std::string> precisions = {"fp32", "fp16", "int8"};
+			int frames = 50; ///< frames per precision or calibration samples
+			int width = 640; ///< model input size
+			int height = 480;
+		};
+
+		/// time every precision and print the report, returns false if the
+		/// model or the frames could not be loaded
+		bool run(const Options & options) {
+			if(!setup(options)) {
+				return false;
+			}
+			// reference & scratch outputs, touched now so they do not count
+			// towards the sessions' memory
+			std::vector<ofPixels> reference(inputs.size());
+			for(auto & pixels : reference) {
+				pixels.allocate(options.width, options.height, OF_PIXELS_RGB);
+				pixels.set(0);
+			}
+			ofPixels output;
+			output.allocate(options.width, options.height, OF_PIXELS_RGB);
+			output.set(0);
+
+			std::cout << inputs.size() << " frames of " << options.input << " at "
+			          << options.width << "x" << options.height << " on "
+			          << std::max((int)std::thread::hardware_concurrency(), 1) << " CPU cores" << std::endl;
+			std::cout << std::left << std::setw(11) << "precision" << std::right
+			          << std::setw(10) << "ms/frame" << std::setw(8) << "fps" << std::setw(9) << "speedup"
+			          << std::setw(10) << "mem MB" << std::setw(9) << "PSNR dB" << std::setw(8) << "SSIM" << std::endl;
+			double baseline = 0;
+			std::vector<std::string> precisions = options.precisions;
+			if(std::find(precisions.begin(), precisions.end(), "fp32") == precisions.end()) {
+				precisions.insert(precisions.begin(), "fp32"); // the reference
+			}
+			std::stable_partition(precisions.begin(), precisions.end(),
+			                      [](const std::string & name) {return name == "fp32";});
+			for(auto & name : precisions) {
+				ModelSession::Precision precision;
+				ModelSession::precisionFromString(name, precision);
+				std::cout << std::left << std::setw(11) << name << std::right;
+				std::string path = ModelSession::precisionPath(options.modelPath, precision);
+				if(!ofDirectory::doesDirectoryExist(path)) {
+					std::cout << "n/a: no " << path << ", see bench calibrate" << std::endl;
+					continue;
+				}
+
+				resetPeakMemory();
+				double before = peakMemory();
+				std::shared_ptr<ofxStyleTransfer::Network> loaded = styleTransfer.loadNetwork(path, precision);
+				if(!loaded || (precision == ModelSession::PRECISION_FP16 && !loaded->session)) {
+					std::cout << "n/a: failed to load" << std::endl;
+					continue;
+				}
+				BenchSamples samples;
+				double psnrSum = 0, ssimSum = 0;
+				try {
+					for(int i = 0; i < WARMUP; i++) {
+						styleTransfer.run(*loaded, inputs[i % inputs.size()], style);
+					}
+					for(std::size_t i = 0; i < inputs.size(); i++) {
+						BenchTimer timer;
+						cppflow::tensor result = styleTransfer.run(*loaded, inputs[i], style);
+						samples.add(timer.elapsed());
+						if(precision == ModelSession::PRECISION_FP32) {
+							ofxStyleTransfer::tensorToPixels(result, reference[i], options.width, options.height);
+						}
+						else {
+							ofxStyleTransfer::tensorToPixels(result, output, options.width, options.height);
+							psnrSum += std::min(psnr(reference[i], output), MAX_PSNR);
+							ssimSum += ssim(reference[i], output);
+						}
+					}
+				}
+				catch(const std::exception & e) {
+					std::cout << "n/a: " << e.what() << std::endl;
+					continue;
+				}
+				double memory = peakMemory() - before;
+				double ms = samples.mean();
+				if(precision == ModelSession::PRECISION_FP32) {
+					baseline = ms;
+				}
+				bool isReference = (precision == ModelSession::PRECISION_FP32);
+				std::cout << std::setw(10) << ofToString(ms, 2)
+				          << std::setw(8) << ofToString(1000.0 / std::max(ms, 1e-6), 1)
+				          << std::setw(9) << (ofToString(baseline / std::max(ms, 1e-6), 2) + "x")
+				          << std::setw(10) << ofToString(memory, 0)
+				          << std::setw(9) << (isReference ? "-" : ofToString(psnrSum / inputs.size(), 2))
+				          << std::setw(8) << (isReference ? "-" : ofToString(ssimSum / inputs.size(), 4)) << std::endl;
+			}
+			return true;
+		}
+
+		/// write the calibration set for int8 quantization: the frames at
+		/// the model size as content.npy, a style per frame, cycling through
+		/// the styles, as style.npy, and the model's signature input names
+		/// (content, style) as inputs.txt; returns false on error
+		bool calibrate(const Options & options) {
+			if(!setup(options)) {
+				return false;
+			}
+			std::string directory = calibrationPath(options.modelPath);
+			ofDirectory::createDirectory(directory, false, true);
+
+			std::vector<float> content;
+			for(auto & input : inputs) {
+				std::shared_ptr<TF_Tensor> tensor = input.get_tensor();
+				const float * data = (const float *)TF_TensorData(tensor.get());
+				content.insert(content.end(), data, data + (std::size_t)options.width * options.height * 3);
+			}
+			std::vector<float> styleValues;
+			std::vector<int64_t> styleShape;
+			for(std::size_t i = 0; i < inputs.size(); i++) {
+				cppflow::tensor tensor = styles[i % styles.size()];
+				styleShape = tensor.shape();
+				std::shared_ptr<TF_Tensor> data = tensor.get_tensor();
+				const float * values = (const float *)TF_TensorData(data.get());
+				styleValues.insert(styleValues.end(), values, values + TF_TensorByteSize(data.get()) / sizeof(float));
+			}
+			styleShape[0] = (int64_t)inputs.size();
+
+			std::ofstream names(ofToDataPath(ofFilePath::join(directory, "inputs.txt"), true));
+			for(auto & name : network->inputNames) {
+				names << signatureKey(name) << "\n";
+			}
+			if(!writeNpy(ofFilePath::join(directory, "content.npy"), content,
+			             {(int64_t)inputs.size(), options.height, options.width, 3}) ||
+			   !writeNpy(ofFilePath::join(directory, "style.npy"), styleValues, styleShape)) {
+				std::cout << "failed to write " << directory << std::endl;
+				return false;
+			}
+			std::cout << "wrote " << inputs.size() << " frames & " << styles.size() << " styles to "
+			          << directory << ", next: ./quantize_model.sh " << options.modelPath << std::endl;
+			return true;
+		}
+
+		/// calibration set folder of a model, ie. "models/my_model.calibration"
+		static std::string calibrationPath(const std::string & modelPath) {
+			std::string path = ModelSession::precisionPath(modelPath, ModelSession::PRECISION_INT8);
+			return path.substr(0, path.size() - 5) + ".calibration";
+		}
+
+		static const int WARMUP = 3; ///< untimed runs per precision
+		static constexpr double MAX_PSNR = 100; ///< identical outputs count as this
+
+	protected:
+
+		/// load the fp32 model, the frames as input tensors at the model
+		/// size, and the style tensors
+		bool setup(const Options & options) {
+			InferenceDevice::configure(InferenceDevice::DEVICE_CPU);
+			styleTransfer.setUseTexture(false); // no GL context
+			if(!styleTransfer.setup(options.width, options.height, options.modelPath)) {
+				return false;
+			}
+			network = styleTransfer.getNetwork();
+			if(!loadFrames(options)) {
+				return false;
+			}
+			std::vector<ofPixels> images;
+			if(!options.styleFolder.empty()) {
+				ofDirectory dir(options.styleFolder);
+				dir.allowExt("png");
+				dir.allowExt("jpg");
+				dir.allowExt("jpeg");
+				dir.listDir();
+				dir.sort();
+				for(std::size_t i = 0; i < dir.size(); i++) {
+					ofPixels pixels;
+					if(ofLoadImage(pixels, dir.getPath(i))) {
+						pixels.setImageType(OF_IMAGE_COLOR);
+						images.push_back(pixels);
+					}
+				}
+			}
+			if(images.empty()) {
+				images.resize(1);
+				SyntheticFrameSource::render(images[0], 0, ofxStyleTransfer::STYLE_W, ofxStyleTransfer::STYLE_H);
+			}
+			for(auto & image : images) {
+				styles.push_back(styleTransfer.getStyleTensor(styleTransfer.prepareStyle(image)));
+			}
+			style = styles.front();
+			return true;
+		}
+
+		/// read frames from the input & convert them at the model size,
+		/// repeating short inputs
+		bool loadFrames(const Options & options) {
+			std::shared_ptr<FrameSource> source = createFrameSource(options.input);
+			if(!source) {
+				return false;
+			}
+			source->setPacing(FrameSource::PACING_FAST);
+			source->setLoop(true);
+			if(!source->open()) {
+				std::cout << "failed to open " << options.input << std::endl;
+				return false;
+			}
+			Frame frame;
+			int timeouts = 0;
+			while((int)inputs.size() < options.frames && timeouts < 10) {
+				frame.releaseExternal();
+				if(!source->grab(frame)) {
+					timeouts++;
+					continue;
+				}
+				std::vector<float> values((std::size_t)options.width * options.height * 3);
+				preprocess(frame.getSpan(), values.data(), options.width, options.height);
+				inputs.push_back(cppflow::tensor(values, {1, options.height, options.width, 3}));
+			}
+			source->close();
+			if(inputs.empty()) {
+				std::cout << "no frames from " << options.input << std::endl;
+				return false;
+			}
+			return true;
+		}
+
+		/// serving_default signature key of an input operation name
+		static std::string signatureKey(const std::string & name) {
+			std::string key = ModelSignature::operationName(name);
+			const std::string prefix = "serving_default_";
+			return (key.compare(0, prefix.size(), prefix) == 0 ? key.substr(prefix.size()) : key);
+		}
+
+		/// write a little endian float32 NumPy array file
+		static bool writeNpy(const std::string & path, const std::vector<float> & values,
+		                     const std::vector<int64_t> & shape) {
+			std::string dims;
+			for(auto dim : shape) {
+				dims += ofToString(dim) + ", ";
+			}
+			std::string header = "{'descr': '<f4', 'fortran_order': False, 'shape': (" +
+			                     dims.substr(0, shape.size() == 1 ? dims.size() - 1 : dims.size() - 2) + "), }";
+			// magic + version + length + header, padded to 64 bytes
+			std::size_t total = 10 + header.size() + 1;
+			header += std::string((64 - total % 64) % 64, ' ') + "\n";
+			std::ofstream file(ofToDataPath(path, true), std::ios::binary);
+			const char magic[] = {'\x93', 'N', 'U', 'M', 'P', 'Y', 1, 0};
+			uint16_t length = (uint16_t)header.size();
+			file.write(magic, sizeof(magic));
+			file.write((const char *)&length, sizeof(length));
+			file << header;
+			file.write((const char *)values.data(), values.size() * sizeof(float));
+			return (bool)file;
+		}
+
+		ofxStyleTransfer styleTransfer; ///< fp32 model for names & styles
+		std::shared_ptr<ofxStyleTransfer::Network> network;
+		std::vector<cppflow::tensor> inputs; ///< preprocessed frames
+		std::vector<cppflow::tensor> styles; ///< style model inputs
+		cppflow::tensor style; ///< style used for timing
+};
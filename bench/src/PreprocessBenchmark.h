@@ -0,0 +1,91 @@
+/*
+ * AI Dance Mirror
+ *
+ * Input preprocessing micro-benchmark.
+ */
+#pragma once
+
+#include "BenchUtils.h"
+#include "ofxStyleTransfer.h"
+#include "SyntheticFrameSource.h"
+
+/// \class PreprocessBenchmark
+/// \brief compares the fused camera buffer -> input tensor path against the
+///        previous multi-copy path
+///
+/// previous path per frame: ofImage::setFromPixels() copy, RGB copy in
+/// pixelsToFloatTensor(), eager pixelsToTensor, expand_dims, cast, mul and
+/// resize_bicubic to the model size (the GL texture upload is not included),
+/// max diff is the largest difference of the fused input values to it
+class PreprocessBenchmark {
+	public:
+
+		/// run for 640x480, 1280x720, and 1920x1080, prints a table
+		void run(int iterations) {
+			std::vector<std::pair<int, int>> sizes = {{640, 480}, {1280, 720}, {1920, 1080}};
+			std::cout << "size        model       previous ms  fused ms  fused rgba ms  speedup  max diff" << std::endl;
+			for(auto & size : sizes) {
+				run(size.first, size.second, iterations);
+			}
+		}
+
+		/// run one frame size
+		void run(int width, int height, int iterations) {
+			int modelWidth = ofxStyleTransfer::roundupto(width, 32);
+			int modelHeight = ofxStyleTransfer::roundupto(height, 32);
+
+			ofPixels frame;
+			SyntheticFrameSource::render(frame, 0, width, height);
+			ofPixels frameRGBA;
+			frameRGBA.allocate(width, height, OF_PIXELS_RGBA);
+			for(std::size_t i = 0; i < frame.size() / 3; i++) {
+				std::memcpy(&frameRGBA[i * 4], &frame[i * 3], 3);
+				frameRGBA[i * 4 + 3] = 255;
+			}
+
+			ofImage colorImage;
+			colorImage.setUseTexture(false);
+			cppflow::tensor reference;
+			BenchSamples previous = benchmark([&]() {
+				colorImage.setFromPixels(frame);
+				ofPixels rgbPixels = colorImage.getPixels();
+				auto t = ofxTF2::pixelsToTensor(rgbPixels);
+				t = cppflow::expand_dims(t, 0);
+				t = cppflow::cast(t, TF_UINT8, TF_FLOAT);
+				t = cppflow::mul(t, cppflow::tensor({1.0f / 255.f}));
+				if(width != modelWidth || height != modelHeight) {
+					t = cppflow::resize_bicubic(t, cppflow::tensor({modelHeight, modelWidth}), true);
+				}
+				reference = t;
+			}, iterations);
+
+			TensorBufferPool buffers;
+			auto fused = [&](const PixelSpan & pixels) {
+				return benchmark([&]() {
+					float * data = nullptr;
+					cppflow::tensor t = buffers.allocate({1, modelHeight, modelWidth, 3}, data);
+					preprocess(pixels, data, modelWidth, modelHeight);
+				}, iterations);
+			};
+			BenchSamples fusedRGB = fused(PixelSpan(frame));
+			BenchSamples fusedRGBA = fused(PixelSpan(frameRGBA));
+
+			// largest difference of the fused input to the previous path's
+			std::vector<float> values((std::size_t)modelWidth * modelHeight * 3);
+			preprocess(PixelSpan(frame), values.data(), modelWidth, modelHeight);
+			std::shared_ptr<TF_Tensor> data = reference.get_tensor();
+			const float * expected = (const float *)TF_TensorData(data.get());
+			float difference = 0;
+			for(std::size_t i = 0; i < values.size(); i++) {
+				difference = std::max(difference, std::abs(values[i] - expected[i]));
+			}
+
+			std::cout << std::left << std::setw(12) << (ofToString(width) + "x" + ofToString(height))
+			          << std::setw(12) << (ofToString(modelWidth) + "x" + ofToString(modelHeight))
+			          << std::setw(13) << ofToString(previous.median(), 3)
+			          << std::setw(10) << ofToString(fusedRGB.median(), 3)
+			          << std::setw(15) << ofToString(fusedRGBA.median(), 3)
+			          << std::setw(9) << (ofToString(previous.median() / std::max(fusedRGB.median(), 1e-6), 2) + "x")
+			          << ofToString(difference, 6) << std::endl;
+		}
+};
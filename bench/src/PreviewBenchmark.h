@@ -0,0 +1,87 @@
+/*
+ * AI Dance Mirror
+ *
+ * Style preview sheet benchmark.
+ */
+#pragma once
+
+#include "BenchUtils.h"
+#include "StylePreview.h"
+#include "SyntheticFrameSource.h"
+
+/// \class PreviewBenchmark
+/// \brief time to a complete style preview sheet and thumbnails per second
+///        for each preview batch size
+///
+/// a sheet of one generated frame in count generated styles is requested
+/// repeatedly through StylePreview, batches are allowed to run right away,
+/// so the times are those of an idle model
+class PreviewBenchmark {
+	public:
+
+		/// load the model and time sheets of count styles at thumbnail size
+		/// width x height for every batch size, returns false if the model
+		/// could not be loaded or a preview batch failed
+		bool run(const std::string & modelPath, const std::vector<int> & batchSizes,
+		         int count, int sheets, int width, int height) {
+			styleTransfer.setUseTexture(false); // no GL context
+			if(!styleTransfer.setup(width, height, modelPath)) {
+				return false;
+			}
+			std::vector<ofxStyleTransfer::Style> styles;
+			for(int i = 0; i < count; i++) {
+				ofPixels pixels;
+				SyntheticFrameSource::render(pixels, i * 37, ofxStyleTransfer::STYLE_W, ofxStyleTransfer::STYLE_H);
+				styles.push_back(styleTransfer.prepareStyle(pixels));
+			}
+			ofPixels frame;
+			SyntheticFrameSource::render(frame, 0, width, height);
+
+			StylePreview preview;
+			preview.start(styleTransfer, width, height);
+			std::cout << count << " styles at " << width << "x" << height << ", "
+			          << sheets << " sheets per batch size" << std::endl;
+			std::cout << "batch  sheet ms  thumbnails/s  batch ms" << std::endl;
+			for(int batchSize : batchSizes) {
+				preview.setBatchSize(batchSize);
+				double ms = 0;
+				BenchSamples samples;
+				// first sheet is the warm-up: graph setup for this shape
+				for(int i = 0; i <= sheets; i++) {
+					if(!measureSheet(preview, frame, styles, ms)) {
+						std::cout << preview.getFailed() << " of " << count << " thumbnails failed with batch "
+						          << preview.getBatchSize() << ", see the log" << std::endl;
+						preview.stop();
+						return false;
+					}
+					if(i > 0) {
+						samples.add(ms);
+					}
+				}
+				std::cout << std::left << std::setw(7) << preview.getBatchSize()
+				          << std::setw(10) << ofToString(samples.mean(), 1)
+				          << std::setw(14) << ofToString(count * 1000.0 / std::max(samples.mean(), 1e-6), 1)
+				          << ofToString(preview.getStats().batchMs, 1) << std::endl;
+			}
+			preview.stop();
+			return true;
+		}
+
+	protected:
+
+		/// request a sheet and let batches run until it is done, sets ms,
+		/// returns false if a batch failed
+		static bool measureSheet(StylePreview & preview, const ofPixels & frame,
+		                         const std::vector<ofxStyleTransfer::Style> & styles, double & ms) {
+			BenchTimer timer;
+			preview.request(PixelSpan(frame), styles);
+			while(preview.getDone() + preview.getFailed() < styles.size()) {
+				preview.allowBatch();
+				std::this_thread::sleep_for(std::chrono::microseconds(200));
+			}
+			ms = timer.elapsed();
+			return preview.getFailed() == 0;
+		}
+
+		ofxStyleTransfer styleTransfer;
+};
@@ -0,0 +1,368 @@
+/*
+ * AI Dance Mirror
+ *
+ * Style transfer throughput & latency sweep with JSON reports.
+ */
+#pragma once
+
+#include "BenchUtils.h"
+#include "StylePipeline.h"
+#include "FrameSources.h"
+
+/// \class SweepBenchmark
+/// \brief runs ofxStyleTransfer over a fixed frame set for every combination
+///        of size, style, and run mode, writes a JSON report
+///
+/// run modes:
+///   * sync: blocking ofxStyleTransfer::update()
+///   * threaded: ofxStyleTransfer background thread, one frame at a time
+///   * pipeline: StylePipeline without frame dropping, for every worker count
+///     and intra-op thread setting
+///
+/// the frame set is read into memory before timing, every mode processes the
+/// same frames; latency is measured per frame from input to output pixels
+class SweepBenchmark {
+	public:
+
+		/// sweep settings
+		struct Options {
+			std::string modelPath; ///< model folder
+			std::string input = "synthetic"; ///< frame source spec
+			int frames = 100; ///< frames per combination
+			std::string styleFolder; ///< style images, synthetic style if empty
+			std::vector<std::pair<int, int>> sizes = {{320, 240}, {640, 480}, {1280, 720}};
+			std::vector<std::string> modes = {"sync", "threaded", "pipeline"};
+			std::vector<int> workers = {1}; ///< pipeline worker counts
+			std::vector<int> intraOp = {0}; ///< pipeline intra-op threads per worker, 2+ workers only
+			std::string report = "report.json"; ///< output path
+		};
+
+		/// run all combinations and write the report, returns false on error
+		bool run(const Options & options) {
+			this->options = options;
+			if(!loadFrames()) {
+				return false;
+			}
+			styleTransfer.setUseTexture(false); // no GL context
+			if(!styleTransfer.setup(options.sizes.front().first, options.sizes.front().second,
+			                        options.modelPath)) {
+				return false;
+			}
+			if(!loadStyles()) {
+				return false;
+			}
+
+			ofJson results = ofJson::array();
+			std::cout << std::left << std::setw(36) << "configuration" << std::right
+			          << std::setw(8) << "fps" << std::setw(8) << "p50" << std::setw(8) << "p95"
+			          << std::setw(8) << "p99" << std::setw(9) << "rss MB" << std::endl;
+			for(auto & size : options.sizes) {
+				styleTransfer.setSize(size.first, size.second);
+				for(auto & style : styles) {
+					styleTransfer.setStyle(style.second);
+					for(auto & mode : options.modes) {
+						if(mode != "pipeline") {
+							results.push_back(measure(size, style.first, mode, 1, 0));
+							continue;
+						}
+						for(int workers : options.workers) {
+							// one worker runs the shared model, intra-op threads
+							// only size the sessions of several workers
+							std::vector<int> intraOps = (workers > 1 ? options.intraOp : std::vector<int>{0});
+							for(int intraOp : intraOps) {
+								results.push_back(measure(size, style.first, mode, workers, intraOp));
+							}
+						}
+					}
+				}
+			}
+
+			ofJson report;
+			report["version"] = 1;
+			report["date"] = ofGetTimestampString("%Y-%m-%d %H:%M:%S");
+			report["model"] = options.modelPath;
+			report["input"] = options.input;
+			report["frames"] = options.frames;
+			report["cores"] = (int)std::thread::hardware_concurrency();
+			report["tensorflow"] = std::string(TF_Version());
+			report["results"] = results;
+			if(!ofSavePrettyJson(options.report, report)) {
+				std::cout << "failed to write " << options.report << std::endl;
+				return false;
+			}
+			std::cout << "wrote " << options.report << std::endl;
+			return true;
+		}
+
+		/// compare two reports by configuration key, prints fps & p95 changes
+		/// and returns false if any configuration regressed by more than
+		/// threshold percent
+		static bool compare(const std::string & previousPath, const std::string & currentPath,
+		                    double threshold=5) {
+			ofJson previous = ofLoadJson(previousPath);
+			ofJson current = ofLoadJson(currentPath);
+			if(!previous.contains("results") || !current.contains("results")) {
+				std::cout << "invalid report(s)" << std::endl;
+				return false;
+			}
+			std::map<std::string, ofJson> before;
+			for(auto & result : previous["results"]) {
+				before[result.value("key", std::string())] = result;
+			}
+			int regressions = 0;
+			std::cout << std::left << std::setw(36) << "configuration" << std::right
+			          << std::setw(9) << "fps old" << std::setw(9) << "fps new" << std::setw(9) << "change"
+			          << std::setw(9) << "p95 old" << std::setw(9) << "p95 new" << std::setw(9) << "change"
+			          << std::endl;
+			for(auto & result : current["results"]) {
+				std::string key = result.value("key", std::string());
+				auto it = before.find(key);
+				if(it == before.end()) {
+					std::cout << std::left << std::setw(36) << key << "  new" << std::endl;
+					continue;
+				}
+				double fpsOld = it->second.value("fps", 0.0);
+				double fpsNew = result.value("fps", 0.0);
+				double p95Old = it->second["latency"].value("p95", 0.0);
+				double p95New = result["latency"].value("p95", 0.0);
+				double fpsChange = percentChange(fpsOld, fpsNew);
+				double p95Change = percentChange(p95Old, p95New);
+				bool regressed = (fpsChange < -threshold || p95Change > threshold);
+				regressions += regressed;
+				std::cout << std::left << std::setw(36) << key << std::right << std::fixed << std::setprecision(1)
+				          << std::setw(9) << fpsOld << std::setw(9) << fpsNew
+				          << std::setw(8) << fpsChange << "%"
+				          << std::setw(9) << p95Old << std::setw(9) << p95New
+				          << std::setw(8) << p95Change << "%"
+				          << (regressed ? "  REGRESSION" : "") << std::endl;
+				before.erase(it);
+			}
+			for(auto & missing : before) {
+				std::cout << std::left << std::setw(36) << missing.first << "  missing" << std::endl;
+			}
+			std::cout << regressions << " regression(s) over " << threshold << "%" << std::endl;
+			return regressions == 0;
+		}
+
+	protected:
+
+		/// a frame from the input set
+		struct BenchFrame {
+			ofPixels pixels;
+			PixelSpan::Layout layout = PixelSpan::RGB;
+			PixelSpan getSpan() const {
+				return PixelSpan(pixels.getData(), pixels.getWidth(), pixels.getHeight(), layout);
+			}
+		};
+
+		/// read the frame set into memory, repeating short inputs
+		bool loadFrames() {
+			std::shared_ptr<FrameSource> source = createFrameSource(options.input);
+			if(!source) {
+				return false;
+			}
+			source->setPacing(FrameSource::PACING_FAST);
+			source->setLoop(true);
+			if(!source->open()) {
+				std::cout << "failed to open " << options.input << std::endl;
+				return false;
+			}
+			Frame frame;
+			int timeouts = 0;
+			while((int)frames.size() < options.frames && timeouts < 10) {
+				frame.releaseExternal();
+				if(!source->grab(frame)) {
+					timeouts++;
+					continue;
+				}
+				PixelSpan span = frame.getSpan();
+				BenchFrame copy;
+				copy.layout = span.layout;
+				copy.pixels.allocate(span.width, span.height, span.getNumChannels());
+				for(int y = 0; y < span.height; y++) {
+					std::memcpy(copy.pixels.getData() + y * copy.pixels.getBytesStride(),
+					            span.row(y), copy.pixels.getBytesStride());
+				}
+				frames.push_back(std::move(copy));
+			}
+			source->close();
+			if(frames.empty()) {
+				std::cout << "no frames from " << options.input << std::endl;
+				return false;
+			}
+			return true;
+		}
+
+		/// prepare style images, or a generated one
+		bool loadStyles() {
+			if(options.styleFolder.empty()) {
+				ofPixels pixels;
+				SyntheticFrameSource::render(pixels, 0, ofxStyleTransfer::STYLE_W, ofxStyleTransfer::STYLE_H);
+				styles.push_back({"synthetic", styleTransfer.prepareStyle(pixels)});
+				return true;
+			}
+			ofDirectory dir(options.styleFolder);
+			dir.allowExt("png");
+			dir.allowExt("jpg");
+			dir.allowExt("jpeg");
+			dir.listDir();
+			dir.sort();
+			for(std::size_t i = 0; i < dir.size(); i++) {
+				ofPixels pixels;
+				if(ofLoadImage(pixels, dir.getPath(i))) {
+					pixels.setImageType(OF_IMAGE_COLOR);
+					styles.push_back({ofFilePath::getBaseName(dir.getName(i)),
+					                  styleTransfer.prepareStyle(pixels)});
+				}
+			}
+			if(styles.empty()) {
+				std::cout << "no style images in " << options.styleFolder << std::endl;
+				return false;
+			}
+			return true;
+		}
+
+		/// run one combination, returns its report entry
+		ofJson measure(const std::pair<int, int> & size, const std::string & style,
+		               const std::string & mode, int workers, int intraOp) {
+			std::string key = ofToString(size.first) + "x" + ofToString(size.second) + "/" +
+			                  style + "/" + mode;
+			if(mode == "pipeline") {
+				key += "/w" + ofToString(workers) + (intraOp > 0 ? "/t" + ofToString(intraOp) : "");
+			}
+
+			resetPeakMemory();
+			BenchSamples latency;
+			double seconds = 0;
+			if(mode == "sync") {
+				seconds = runSync(latency);
+			}
+			else if(mode == "threaded") {
+				seconds = runThreaded(latency);
+			}
+			else {
+				seconds = runPipeline(latency, workers, intraOp);
+			}
+			double fps = latency.size() / std::max(seconds, 1e-6);
+			double rss = peakMemory();
+
+			std::cout << std::left << std::setw(36) << key << std::right << std::fixed << std::setprecision(1)
+			          << std::setw(8) << fps
+			          << std::setw(8) << latency.percentile(50)
+			          << std::setw(8) << latency.percentile(95)
+			          << std::setw(8) << latency.percentile(99)
+			          << std::setw(9) << rss << std::endl;
+
+			ofJson result;
+			result["key"] = key;
+			result["width"] = size.first;
+			result["height"] = size.second;
+			result["style"] = style;
+			result["mode"] = mode;
+			result["workers"] = workers;
+			result["intraOp"] = intraOp;
+			result["frames"] = (int)latency.size();
+			result["fps"] = fps;
+			result["latency"] = {
+				{"mean", latency.mean()},
+				{"p50", latency.percentile(50)},
+				{"p95", latency.percentile(95)},
+				{"p99", latency.percentile(99)},
+				{"max", latency.percentile(100)}
+			};
+			result["peakRssMB"] = rss;
+			return result;
+		}
+
+		/// blocking update(), returns elapsed seconds
+		double runSync(BenchSamples & latency) {
+			for(int i = 0; i < WARMUP; i++) {
+				styleTransfer.setInput(frames[i % frames.size()].getSpan());
+				styleTransfer.update();
+			}
+			BenchTimer total;
+			for(auto & frame : frames) {
+				BenchTimer timer;
+				styleTransfer.setInput(frame.getSpan());
+				styleTransfer.update();
+				latency.add(timer.elapsed());
+			}
+			return total.elapsed() / 1000.0;
+		}
+
+		/// background thread update(), one frame at a time,
+		/// returns elapsed seconds
+		double runThreaded(BenchSamples & latency) {
+			styleTransfer.startThread();
+			BenchSamples warmup;
+			auto process = [this](const BenchFrame & frame, BenchSamples & samples) {
+				BenchTimer timer;
+				styleTransfer.setInput(frame.getSpan());
+				while(!styleTransfer.update()) {
+					std::this_thread::sleep_for(std::chrono::microseconds(50));
+				}
+				samples.add(timer.elapsed());
+			};
+			for(int i = 0; i < WARMUP; i++) {
+				process(frames[i % frames.size()], warmup);
+			}
+			BenchTimer total;
+			for(auto & frame : frames) {
+				process(frame, latency);
+			}
+			double seconds = total.elapsed() / 1000.0;
+			styleTransfer.stopThread();
+			return seconds;
+		}
+
+		/// StylePipeline without frame dropping, returns elapsed seconds
+		double runPipeline(BenchSamples & latency, int workers, int intraOp) {
+			StylePipeline pipeline;
+			StylePipeline::WorkerOptions options;
+			options.workers = workers;
+			options.intraOpThreads = intraOp;
+			pipeline.setWorkers(options);
+			pipeline.start(styleTransfer, workers + 1, false);
+
+			BenchSamples warmup;
+			feed(pipeline, WARMUP * workers, warmup);
+			BenchTimer total;
+			feed(pipeline, frames.size(), latency);
+			double seconds = total.elapsed() / 1000.0;
+			pipeline.stop();
+			return seconds;
+		}
+
+		/// push count frames through the pipeline, collects every output
+		void feed(StylePipeline & pipeline, std::size_t count, BenchSamples & latency) {
+			std::size_t submitted = 0;
+			std::size_t received = 0;
+			uint64_t lost = pipeline.getStats().failed;
+			while(received + (pipeline.getStats().failed - lost) < count) {
+				if(submitted < count) {
+					const BenchFrame & frame = frames[submitted % frames.size()];
+					if(pipeline.submit(frame.getSpan(), nullptr, submitted, ofGetElapsedTimeMicros())) {
+						submitted++;
+						continue;
+					}
+				}
+				while(pipeline.next()) {
+					const FrameTimes & times = pipeline.getOutput().times;
+					latency.add((times.postprocessEnd - times.submit) / 1000.0);
+					received++;
+				}
+				std::this_thread::sleep_for(std::chrono::microseconds(50));
+			}
+		}
+
+		static double percentChange(double before, double after) {
+			return before != 0 ? (after - before) / before * 100.0 : 0;
+		}
+
+		static const int WARMUP = 3; ///< untimed frames per combination
+
+		Options options;
+		ofxStyleTransfer styleTransfer;
+		std::vector<BenchFrame> frames;
+		std::vector<std::pair<std::string, ofxStyleTransfer::Style>> styles;
+};
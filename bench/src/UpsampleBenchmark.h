@@ -0,0 +1,77 @@
+/*
+ * AI Dance Mirror
+ *
+ * Guided vs. bicubic output upsampling micro-benchmark.
+ */
+#pragma once
+
+#include "BenchUtils.h"
+#include "ofxStyleTransfer.h"
+#include "GuidedUpsampler.h"
+#include "SyntheticFrameSource.h"
+
+/// \class UpsampleBenchmark
+/// \brief times model output -> display size conversion: the bicubic resize
+///        of ofxStyleTransfer::tensorToPixels() vs. GuidedUpsampler with 1 to
+///        N threads, for model sizes of 1/2 and 1/4 of the display size
+///
+/// the model output is simulated by a downsampled synthetic frame
+class UpsampleBenchmark {
+	public:
+
+		/// run for a display size, ie. 1920x1080, prints a table
+		void run(int width, int height, int iterations) {
+			ofPixels frame;
+			SyntheticFrameSource::render(frame, 0, width, height);
+			int cores = std::max((int)std::thread::hardware_concurrency(), 1);
+			std::vector<int> threads = {1};
+			for(int n = 2; n <= cores; n *= 2) {
+				threads.push_back(n);
+			}
+
+			std::cout << "display " << width << "x" << height << std::endl;
+			std::cout << std::left << std::setw(12) << "model" << std::setw(12) << "bicubic ms";
+			for(int n : threads) {
+				std::cout << std::setw(12) << ("guided " + ofToString(n) + "t");
+			}
+			std::cout << std::endl;
+			for(int divisor : {2, 4}) {
+				int lowWidth = ofxStyleTransfer::roundupto(width / divisor, 32);
+				int lowHeight = ofxStyleTransfer::roundupto(height / divisor, 32);
+				std::vector<float> low(lowWidth * lowHeight * 3);
+				downsample(frame, low, lowWidth, lowHeight);
+				cppflow::tensor tensor(low, {1, lowHeight, lowWidth, 3});
+				ofPixels output;
+
+				std::cout << std::setw(12) << (ofToString(lowWidth) + "x" + ofToString(lowHeight));
+				BenchSamples bicubic = benchmark([&]() {
+					ofxStyleTransfer::tensorToPixels(tensor, output, width, height);
+				}, iterations);
+				std::cout << std::setw(12) << ofToString(bicubic.median(), 2);
+				for(int n : threads) {
+					GuidedUpsampler upsampler;
+					upsampler.setThreads(n);
+					BenchSamples guided = benchmark([&]() {
+						upsampler.process(low.data(), lowWidth, lowHeight, PixelSpan(frame), output);
+					}, iterations);
+					std::cout << std::setw(12) << ofToString(guided.median(), 2);
+				}
+				std::cout << std::endl;
+			}
+		}
+
+	private:
+
+		/// nearest neighbor downsample to normalized floats
+		static void downsample(const ofPixels & frame, std::vector<float> & low, int lowWidth, int lowHeight) {
+			for(int y = 0; y < lowHeight; y++) {
+				int sy = y * (int)frame.getHeight() / lowHeight;
+				for(int x = 0; x < lowWidth; x++) {
+					int sx = x * (int)frame.getWidth() / lowWidth;
+					for(int c = 0; c < 3; c++) {
+						low[(y * lowWidth + x) * 3 + c] = frame[(sy * frame.getWidth() + sx) * 3 + c] / 255.f;
+					}
+				}
+			}
+		}
+};
@@ -0,0 +1,110 @@
+/*
+ * AI Dance Mirror
+ *
+ * Inference worker scaling benchmark.
+ */
+#pragma once
+
+#include "BenchUtils.h"
+#include "StylePipeline.h"
+#include "SyntheticFrameSource.h"
+
+/// \class WorkerBenchmark
+/// \brief frames per second of the style pipeline for 1 to N workers
+///
+/// every run processes the same synthetic frame sequence without dropping
+/// frames, so the numbers only differ by the worker count; each worker
+/// gets cores / workers pinned cores and as many intra-op threads
+class WorkerBenchmark {
+	public:
+
+		/// load the model and run 1..maxWorkers workers (0 for all cores),
+		/// returns false if the model could not be loaded
+		bool run(const std::string & modelPath, int frames, int width, int height, int maxWorkers=0) {
+			styleTransfer.setUseTexture(false); // no GL context
+			if(!styleTransfer.setup(width, height, modelPath)) {
+				return false;
+			}
+			ofPixels style;
+			SyntheticFrameSource::render(style, 0, ofxStyleTransfer::STYLE_W, ofxStyleTransfer::STYLE_H);
+			styleTransfer.setStyle(style);
+
+			// same input for every run, a few distinct frames cycled
+			sequence.resize(std::min(frames, 30));
+			for(std::size_t i = 0; i < sequence.size(); i++) {
+				SyntheticFrameSource::render(sequence[i], i, width, height);
+			}
+
+			int cores = std::max((int)std::thread::hardware_concurrency(), 1);
+			if(maxWorkers <= 0) {
+				maxWorkers = cores;
+			}
+			std::cout << width << "x" << height << ", " << frames << " frames, "
+			          << cores << " cores" << std::endl;
+			std::cout << "workers  fps      speedup  latency ms  reordered" << std::endl;
+			double baseline = 0;
+			for(int workers = 1; workers <= maxWorkers; workers++) {
+				StylePipeline::Stats stats;
+				double fps = measure(workers, frames, stats);
+				if(workers == 1) {
+					baseline = fps;
+				}
+				std::cout << std::left << std::setw(9) << workers
+				          << std::setw(9) << ofToString(fps, 2)
+				          << std::setw(9) << (ofToString(fps / std::max(baseline, 1e-6), 2) + "x")
+				          << std::setw(12) << ofToString(stats.latency, 1)
+				          << stats.reordered << std::endl;
+			}
+			return true;
+		}
+
+	protected:
+
+		/// push all frames through a pipeline with the given number of
+		/// workers, returns frames per second
+		double measure(int workers, int frames, StylePipeline::Stats & stats) {
+			StylePipeline pipeline;
+			StylePipeline::WorkerOptions options;
+			options.workers = workers;
+			pipeline.setWorkers(options);
+			pipeline.start(styleTransfer, workers + 1, false);
+
+			// warm up every worker session before timing
+			int warmup = workers * 2;
+			feed(pipeline, warmup, 0);
+
+			BenchTimer timer;
+			feed(pipeline, frames, warmup);
+			double seconds = timer.elapsed() / 1000.0;
+			stats = pipeline.getStats();
+			pipeline.stop();
+			return frames / std::max(seconds, 1e-6);
+		}
+
+		/// submit count frames and wait until all are done
+		void feed(StylePipeline & pipeline, int count, uint64_t first) {
+			uint64_t done = finished(pipeline) + count;
+			int submitted = 0;
+			while(finished(pipeline) < done) {
+				if(submitted < count) {
+					const ofPixels & pixels = sequence[(first + submitted) % sequence.size()];
+					if(pipeline.submit(PixelSpan(pixels), nullptr, first + submitted, ofGetElapsedTimeMicros())) {
+						submitted++;
+						continue;
+					}
+				}
+				pipeline.poll();
+				std::this_thread::sleep_for(std::chrono::microseconds(100));
+			}
+			pipeline.poll();
+		}
+
+		/// frames which left the pipeline
+		static uint64_t finished(const StylePipeline & pipeline) {
+			StylePipeline::Stats stats = pipeline.getStats();
+			return stats.completed + stats.failed;
+		}
+
+		ofxStyleTransfer styleTransfer;
+		std::vector<ofPixels> sequence;
+};
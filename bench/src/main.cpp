@@ -0,0 +1,267 @@
+/*
+ * AI Dance Mirror
+ *
+ * Headless benchmarks.
+ */
+#include "ofMain.h"
+#include "PreprocessBenchmark.h"
+#include "KernelBenchmark.h"
+#include "WorkerBenchmark.h"
+#include "SweepBenchmark.h"
+#include "UpsampleBenchmark.h"
+#include "BatchBenchmark.h"
+#include "PreviewBenchmark.h"
+#include "PrecisionBenchmark.h"
+
+void printUsage() {
+	std::cout << "Usage: bench MODE [options]" << std::endl
+	          << "modes:" << std::endl
+	          << "  preprocess        camera buffer -> input tensor conversion," << std::endl
+	          << "                    previous vs. fused path" << std::endl
+	          << "  kernels           SIMD pixel kernels: verify against the scalar" << std::endl
+	          << "                    reference and time each instruction set" << std::endl
+	          << "  upsample          model output -> display size: bicubic vs. guided" << std::endl
+	          << "                    upsampling per thread count, see --size" << std::endl
+	          << "  workers           style pipeline fps for 1 to N inference workers" << std::endl
+	          << "  batch             fps for 1 to N streams with their own styles: one" << std::endl
+	          << "                    model run per stream vs. one batched run, see" << std::endl
+	          << "                    --streams & --input" << std::endl
+	          << "  preview           style preview sheet time & thumbnails/s per batch" << std::endl
+	          << "                    size, see --batches & --count, --size is the" << std::endl
+	          << "                    thumbnail size (default 160x128)" << std::endl
+	          << "  precision         CPU ms/frame, speedup, memory & PSNR/SSIM against" << std::endl
+	          << "                    fp32 for each precision, see --precisions, --input" << std::endl
+	          << "                    & --styles, --frames defaults to 50" << std::endl
+	          << "  calibrate         write the int8 calibration set from --input frames" << std::endl
+	          << "                    & --styles to <model>.calibration for" << std::endl
+	          << "                    quantize_model.sh, --frames defaults to 100" << std::endl
+	          << "  sweep             fps, latency & memory for every size, style, and" << std::endl
+	          << "                    run mode combination, writes a JSON report" << std::endl
+	          << "  compare OLD NEW   compare two sweep reports, fails on regressions" << std::endl
+	          << "options:" << std::endl
+	          << "  --iterations N    timed iterations per case (default 50)" << std::endl
+	          << "  --model DIR       model folder (default ../../bin/data/models/my_model)" << std::endl
+	          << "  --frames N        frames per worker count or sweep run, preview: sheets" << std::endl
+	          << "                    per batch size (default 200, preview 5)" << std::endl
+	          << "  --size WxH        input size (default 640x480)" << std::endl
+	          << "  --max-workers N   highest worker count (default all cores)" << std::endl
+	          << "  --streams N       batch: highest stream count (default 4)" << std::endl
+	          << "  --batches LIST    preview: batch sizes (default 1,2,4,8,16)" << std::endl
+	          << "  --count N         preview: styles on the sheet (default 24)" << std::endl
+	          << "  --precisions LIST precision: fp32, fp16, int8 (default all)" << std::endl
+	          << "sweep options:" << std::endl
+	          << "  --input SPEC      frame source, see the app's --source (default synthetic)," << std::endl
+	          << "                    batch: repeat for one source per stream" << std::endl
+	          << "  --styles DIR      style image folder (default a generated style)" << std::endl
+	          << "  --sizes LIST      input sizes (default 320x240,640x480,1280x720)" << std::endl
+	          << "  --modes LIST      sync, threaded, pipeline (default all)" << std::endl
+	          << "  --workers LIST    pipeline worker counts (default 1)" << std::endl
+	          << "  --intra-op LIST   pipeline intra-op threads per worker, 0 for" << std::endl
+	          << "                    cores / workers, ignored for 1 worker (default 0)" << std::endl
+	          << "  --report FILE     report path (default report.json)" << std::endl
+	          << "  --threshold PCT   compare: allowed fps or p95 change (default 5)" << std::endl;
+}
+
+/// parse "WxH", returns false if invalid
+bool parseSize(const std::string & text, int & width, int & height) {
+	std::vector<std::string> size = ofSplitString(text, "x", true, true);
+	if(size.size() != 2) {
+		return false;
+	}
+	width = std::max(ofToInt(size[0]), 32);
+	height = std::max(ofToInt(size[1]), 32);
+	return true;
+}
+
+/// parse a comma separated list of non-negative ints
+std::vector<int> parseInts(const std::string & text) {
+	std::vector<int> values;
+	for(auto & value : ofSplitString(text, ",", true, true)) {
+		values.push_back(std::max(ofToInt(value), 0));
+	}
+	return values;
+}
+
+//========================================================================
+int main(int argc, char *argv[]) {
+	if(argc < 2) {
+		printUsage();
+		return EXIT_FAILURE;
+	}
+	std::string mode = argv[1];
+	int iterations = 50;
+	std::string modelPath = "../../bin/data/models/my_model";
+	int frames = 200;
+	int width = 640, height = 480;
+	int maxWorkers = 0;
+	int streams = 4;
+	std::vector<std::string> inputs;
+	SweepBenchmark::Options sweep;
+	double threshold = 5;
+	std::vector<std::string> reports;
+	bool framesSet = false;
+	bool sizeSet = false;
+	std::vector<int> batches = {1, 2, 4, 8, 16};
+	int count = 24;
+	PrecisionBenchmark::Options precision;
+	for(int i = 2; i < argc; i++) {
+		std::string arg = argv[i];
+		if(arg == "--iterations" && i + 1 < argc) {
+			iterations = std::max(ofToInt(argv[++i]), 1);
+		}
+		else if(arg == "--model" && i + 1 < argc) {
+			modelPath = ofFilePath::getAbsolutePath(argv[++i], false);
+		}
+		else if(arg == "--frames" && i + 1 < argc) {
+			frames = std::max(ofToInt(argv[++i]), 1);
+			framesSet = true;
+		}
+		else if(arg == "--size" && i + 1 < argc) {
+			if(!parseSize(argv[++i], width, height)) {
+				printUsage();
+				return EXIT_FAILURE;
+			}
+			sizeSet = true;
+		}
+		else if(arg == "--max-workers" && i + 1 < argc) {
+			maxWorkers = std::max(ofToInt(argv[++i]), 0);
+		}
+		else if(arg == "--input" && i + 1 < argc) {
+			sweep.input = argv[++i];
+			inputs.push_back(sweep.input);
+		}
+		else if(arg == "--streams" && i + 1 < argc) {
+			streams = std::max(ofToInt(argv[++i]), 1);
+		}
+		else if(arg == "--batches" && i + 1 < argc) {
+			batches = parseInts(argv[++i]);
+		}
+		else if(arg == "--count" && i + 1 < argc) {
+			count = std::max(ofToInt(argv[++i]), 1);
+		}
+		else if(arg == "--precisions" && i + 1 < argc) {
+			precision.precisions = ofSplitString(argv[++i], ",", true, true);
+			for(auto & name : precision.precisions) {
+				ModelSession::Precision value;
+				if(!ModelSession::precisionFromString(name, value)) {
+					printUsage();
+					return EXIT_FAILURE;
+				}
+			}
+		}
+		else if(arg == "--styles" && i + 1 < argc) {
+			sweep.styleFolder = ofFilePath::getAbsolutePath(argv[++i], false);
+		}
+		else if(arg == "--sizes" && i + 1 < argc) {
+			sweep.sizes.clear();
+			for(auto & text : ofSplitString(argv[++i], ",", true, true)) {
+				int w, h;
+				if(!parseSize(text, w, h)) {
+					printUsage();
+					return EXIT_FAILURE;
+				}
+				sweep.sizes.push_back({w, h});
+			}
+		}
+		else if(arg == "--modes" && i + 1 < argc) {
+			sweep.modes = ofSplitString(argv[++i], ",", true, true);
+			for(auto & name : sweep.modes) {
+				if(name != "sync" && name != "threaded" && name != "pipeline") {
+					printUsage();
+					return EXIT_FAILURE;
+				}
+			}
+		}
+		else if(arg == "--workers" && i + 1 < argc) {
+			sweep.workers = parseInts(argv[++i]);
+		}
+		else if(arg == "--intra-op" && i + 1 < argc) {
+			sweep.intraOp = parseInts(argv[++i]);
+		}
+		else if(arg == "--report" && i + 1 < argc) {
+			sweep.report = ofFilePath::getAbsolutePath(argv[++i], false);
+		}
+		else if(arg == "--threshold" && i + 1 < argc) {
+			threshold = std::max(ofToDouble(argv[++i]), 0.0);
+		}
+		else if(mode == "compare" && arg.compare(0, 2, "--") != 0) {
+			reports.push_back(ofFilePath::getAbsolutePath(arg, false));
+		}
+		else {
+			printUsage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if(mode == "preprocess") {
+		PreprocessBenchmark().run(iterations);
+	}
+	else if(mode == "workers") {
+		if(!WorkerBenchmark().run(modelPath, frames, width, height, maxWorkers)) {
+			return EXIT_FAILURE;
+		}
+	}
+	else if(mode == "batch") {
+		if(!BatchBenchmark().run(modelPath, inputs, streams, frames, width, height)) {
+			return EXIT_FAILURE;
+		}
+	}
+	else if(mode == "preview") {
+		if(batches.empty()) {
+			printUsage();
+			return EXIT_FAILURE;
+		}
+		if(!PreviewBenchmark().run(modelPath, batches, count, (framesSet ? frames : 5),
+		                           (sizeSet ? width : 160), (sizeSet ? height : 128))) {
+			return EXIT_FAILURE;
+		}
+	}
+	else if(mode == "precision" || mode == "calibrate") {
+		precision.modelPath = modelPath;
+		precision.input = sweep.input;
+		precision.styleFolder = sweep.styleFolder;
+		precision.frames = (framesSet ? frames : (mode == "precision" ? 50 : 100));
+		precision.width = width;
+		precision.height = height;
+		PrecisionBenchmark benchmark;
+		if(!(mode == "precision" ? benchmark.run(precision) : benchmark.calibrate(precision))) {
+			return EXIT_FAILURE;
+		}
+	}
+	else if(mode == "sweep") {
+		sweep.modelPath = modelPath;
+		sweep.frames = (framesSet ? frames : 100);
+		if(sweep.sizes.empty() || sweep.modes.empty() || sweep.workers.empty() || sweep.intraOp.empty()) {
+			printUsage();
+			return EXIT_FAILURE;
+		}
+		for(auto & workers : sweep.workers) {
+			workers = std::max(workers, 1);
+		}
+		if(!SweepBenchmark().run(sweep)) {
+			return EXIT_FAILURE;
+		}
+	}
+	else if(mode == "compare") {
+		if(reports.size() != 2) {
+			printUsage();
+			return EXIT_FAILURE;
+		}
+		if(!SweepBenchmark::compare(reports[0], reports[1], threshold)) {
+			return EXIT_FAILURE;
+		}
+	}
+	else if(mode == "upsample") {
+		UpsampleBenchmark().run(width, height, iterations);
+	}
+	else if(mode == "kernels") {
+		if(!KernelBenchmark().run(iterations)) {
+			return EXIT_FAILURE;
+		}
+	}
+	else {
+		printUsage();
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
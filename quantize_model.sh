@@ -0,0 +1,80 @@
+#!/usr/bin/env bash
+# Post-training int8 quantization of a style transfer model, calibrated with
+# the frames & styles written by "bench calibrate".
+#
+# Usage: ./quantize_model.sh MODEL_DIR
+#
+# Reads MODEL_DIR.calibration/ and writes MODEL_DIR.int8/, which the app uses
+# with --precision int8. For split models only style_transform is quantized,
+# style_predict is copied. Needs Python TensorFlow 2.13 or later with the
+# TF quantizer; the app's TensorFlow C library must be at least as new to run
+# the quantized ops.
+
+set -e
+
+if [ $# -ne 1 ]; then
+    echo "Usage: $0 MODEL_DIR"
+    exit 1
+fi
+
+MODEL="${1%/}"
+CALIBRATION="$MODEL.calibration"
+OUTPUT="$MODEL.int8"
+
+if [ ! -f "$CALIBRATION/content.npy" ]; then
+    echo "No calibration set in $CALIBRATION, run first:"
+    echo "  ./bench/bin/bench calibrate --model $MODEL --input bag:show.bag --styles bin/data/style"
+    exit 1
+fi
+
+echo "=== Quantizing $MODEL to $OUTPUT ==="
+
+python3 - "$MODEL" "$CALIBRATION" "$OUTPUT" <<'EOF'
+import os
+import shutil
+import sys
+
+os.environ['TF_CPP_MIN_LOG_LEVEL'] = '2'
+
+import numpy as np
+import tensorflow as tf
+from tensorflow.compiler.mlir.quantization.tensorflow import quantization_options_pb2 as qopts
+from tensorflow.compiler.mlir.quantization.tensorflow.python import quantize_model
+
+model, calibration, output = sys.argv[1:4]
+print('TensorFlow version:', tf.__version__)
+
+# content image & style input per sample, keyed by serving_default input name
+content = np.load(os.path.join(calibration, 'content.npy'))
+style = np.load(os.path.join(calibration, 'style.npy'))
+with open(os.path.join(calibration, 'inputs.txt')) as f:
+    names = [line.strip() for line in f if line.strip()]
+print('Calibration set:', content.shape[0], 'samples, inputs:', ', '.join(names))
+
+def representative_dataset():
+    for i in range(content.shape[0]):
+        yield {names[0]: content[i:i + 1], names[1]: style[i:i + 1]}
+
+split = os.path.isdir(os.path.join(model, 'style_transform'))
+source = os.path.join(model, 'style_transform') if split else model
+target = os.path.join(output, 'style_transform') if split else output
+
+if os.path.exists(output):
+    shutil.rmtree(output)
+
+options = qopts.QuantizationOptions(
+    quantization_method=qopts.QuantizationMethod(
+        preset_method=qopts.QuantizationMethod.PresetMethod.METHOD_STATIC_RANGE_INT8),
+    op_set=qopts.OpSet.TF)
+options.tags.append('serve')
+options.signature_keys.append('serving_default')
+quantize_model.quantize(source, output_directory=target, quantization_options=options,
+                        representative_dataset=representative_dataset())
+
+if split:
+    shutil.copytree(os.path.join(model, 'style_predict'), os.path.join(output, 'style_predict'))
+print('Wrote', output)
+EOF
+
+echo ""
+echo "Compare with: ./bench/bin/bench precision --model $MODEL --input bag:show.bag"
@@ -0,0 +1,364 @@
+/*
+ * AI Dance Mirror
+ *
+ * Command line settings.
+ */
+#pragma once
+
+#include "ofMain.h"
+#include "FrameSource.h"
+#include "StylePipeline.h"
+#include "StreamBatcher.h"
+#include "InferenceDevice.h"
+#include "ChangeDetector.h"
+#include "TiledInference.h"
+#include "StyleTransition.h"
+#include "StylePreview.h"
+
+/// \struct AppSettings
+/// \brief runtime options parsed from the command line
+struct AppSettings {
+
+	/// input frame source spec, see createFrameSource()
+	std::string source = "realsense";
+
+	/// further input sources, stylized with source in batched model runs,
+	/// each with its own style, see StreamBatcher
+	std::vector<std::string> extraSources;
+
+	/// max ms a batch waits for the other sources' frames once the first
+	/// one arrived, a slow camera does not stall the rest for longer
+	int batchTimeout = 20;
+
+	/// input pacing mode
+	FrameSource::Pacing pacing = FrameSource::PACING_REALTIME;
+
+	int cameraWidth = 640; ///< requested live camera width
+	int cameraHeight = 480; ///< requested live camera height
+	float fps = 30; ///< camera rate, generated source rate & fixed step rate
+	bool loop = true; ///< loop recordings & image sequences?
+
+	int modelWidth = 640; ///< style transfer input size, max size if adaptive
+	int modelHeight = 480; ///< style transfer input size, max size if adaptive
+	bool modelSizeSet = false; ///< model size given on the command line?
+
+	/// reduced default model size when running on the CPU
+	static const int CPU_MODEL_WIDTH = 320;
+	static const int CPU_MODEL_HEIGHT = 240;
+
+	/// inference device, auto picks the GPU if available
+	InferenceDevice::Type device = InferenceDevice::DEVICE_AUTO;
+
+	/// CPU inference threads, 0 for cores - InferenceDevice::RESERVED_CORES
+	int threads = 0;
+
+	/// adapt the model input size to hold this output rate, 0 for a fixed size
+	float targetFps = 0;
+
+	/// max frames in flight in the style pipeline: 1 for lowest latency,
+	/// more for throughput, 0 runs the model on a single background thread
+	int pipelineDepth = 2;
+
+	/// inference worker sessions & their thread settings, see StylePipeline
+	StylePipeline::WorkerOptions workers;
+
+	/// reuse the last output for static frames, tiles also stylizes only
+	/// changed regions (pipeline only)
+	ChangeDetector::Mode reuse = ChangeDetector::MODE_OFF;
+
+	/// tile luma difference (0-255) counted as change
+	float reuseThreshold = 4;
+
+	/// stylize only the performer's depth bounding box, see DancerRegion
+	/// (pipeline & depth sources only)
+	bool roi = false;
+	float roiNear = 0.3f; ///< foreground depth range in m
+	float roiFar = 3.5f; ///< foreground depth range in m
+
+	/// run the model at inferenceScale of the camera size and upsample to the
+	/// camera size with the frame as guide, see GuidedUpsampler (pipeline only)
+	bool guidedUpsampling = false;
+	float inferenceScale = 0.5f; ///< model / camera size, unless --model-size is given
+
+	/// run large model inputs as overlapping tiles to bound inference memory,
+	/// see TiledInference (tileSize 0 disables tiling, pipeline only)
+	TiledInference::Options tiling;
+
+	/// style change morph length, in seconds or beats, 0 cuts
+	StyleTransition::Duration styleTransition = {1, false};
+
+	/// switch to the next style every period, 0 for manual changes only
+	StyleTransition::Duration styleCycle;
+
+	/// tempo for durations in beats, also set by tap tempo
+	float bpm = 120;
+
+	/// styles per model run of the style preview sheet, see StylePreview
+	int previewBatch = 8;
+
+	/// write a Chrome trace_event JSON of all presented frames on exit
+	std::string traceFile;
+
+	/// style image folder, watched for new, changed & deleted images
+	std::string styleDir = "style";
+
+	/// threads decoding & preparing style images, see StyleLibrary
+	int styleThreads = 2;
+
+	/// precompiled style pack, used instead of decoding style images if found
+	std::string stylePack = "style/styles.pack";
+
+	/// model folders, the first is loaded at startup, 'm' swaps to the next
+	/// one while running, see ModelSwap
+	std::vector<std::string> models = {"models/my_model"};
+
+	/// inference precision, int8 uses the quantized variant of each model
+	/// if there is one, see ModelSession::Precision
+	ModelSession::Precision precision = ModelSession::PRECISION_FP32;
+
+	/// folder of a model at the configured precision: the int8 variant if
+	/// it exists, otherwise the model itself
+	std::string getModelPath(std::size_t index) const {
+		std::string path = ModelSession::precisionPath(models[index], precision);
+		return (ofDirectory::doesDirectoryExist(path) ? path : models[index]);
+	}
+
+	/// parse command line arguments,
+	/// returns false if the app should not start (help or bad argument)
+	bool parse(int argc, char *argv[]) {
+		bool sourceSet = false;
+		bool modelSet = false;
+		for(int i = 1; i < argc; i++) {
+			std::string arg = argv[i];
+			bool hasValue = (i + 1 < argc);
+			if(arg == "--source" && hasValue) {
+				// given again: one more stream
+				if(sourceSet) {
+					if(extraSources.size() + 1 >= StreamBatcher::MAX_STREAMS) {
+						std::cout << "too many sources, at most " << StreamBatcher::MAX_STREAMS << std::endl;
+						return false;
+					}
+					extraSources.push_back(argv[++i]);
+				}
+				else {
+					source = argv[++i];
+					sourceSet = true;
+				}
+			}
+			else if(arg == "--model" && hasValue) {
+				// given again: one more model to swap to
+				if(!modelSet) {
+					models.clear();
+					modelSet = true;
+				}
+				models.push_back(argv[++i]);
+			}
+			else if(arg == "--precision" && hasValue) {
+				if(!ModelSession::precisionFromString(argv[++i], precision)) {
+					std::cout << "invalid precision, expected fp32, fp16, or int8" << std::endl;
+					return false;
+				}
+			}
+			else if(arg == "--batch-timeout" && hasValue) {
+				batchTimeout = std::max(ofToInt(argv[++i]), 0);
+			}
+			else if(arg == "--pacing" && hasValue) {
+				pacing = FrameSource::pacingFromString(argv[++i]);
+			}
+			else if(arg == "--fps" && hasValue) {
+				fps = ofToFloat(argv[++i]);
+			}
+			else if(arg == "--size" && hasValue) {
+				std::vector<std::string> size = ofSplitString(argv[++i], "x", true, true);
+				if(size.size() != 2) {
+					std::cout << "invalid size, expected <width>x<height>" << std::endl;
+					return false;
+				}
+				cameraWidth = ofToInt(size[0]);
+				cameraHeight = ofToInt(size[1]);
+			}
+			else if(arg == "--pipeline" && hasValue) {
+				pipelineDepth = std::max(ofToInt(argv[++i]), 0);
+			}
+			else if(arg == "--workers" && hasValue) {
+				workers.workers = std::max(ofToInt(argv[++i]), 1);
+			}
+			else if(arg == "--intra-op" && hasValue) {
+				workers.intraOpThreads = std::max(ofToInt(argv[++i]), 0);
+			}
+			else if(arg == "--inter-op" && hasValue) {
+				workers.interOpThreads = std::max(ofToInt(argv[++i]), 0);
+			}
+			else if(arg == "--no-pin") {
+				workers.pin = false;
+			}
+			else if(arg == "--model-size" && hasValue) {
+				std::vector<std::string> size = ofSplitString(argv[++i], "x", true, true);
+				if(size.size() != 2) {
+					std::cout << "invalid model size, expected <width>x<height>" << std::endl;
+					return false;
+				}
+				modelWidth = std::max(ofToInt(size[0]), 32);
+				modelHeight = std::max(ofToInt(size[1]), 32);
+				modelSizeSet = true;
+			}
+			else if(arg == "--device" && hasValue) {
+				std::string name = argv[++i];
+				if(name != "auto" && name != "gpu" && name != "cpu") {
+					std::cout << "invalid device, expected auto, gpu, or cpu" << std::endl;
+					return false;
+				}
+				device = InferenceDevice::typeFromString(name);
+			}
+			else if(arg == "--threads" && hasValue) {
+				threads = std::max(ofToInt(argv[++i]), 0);
+			}
+			else if(arg == "--target-fps" && hasValue) {
+				targetFps = std::max(ofToFloat(argv[++i]), 0.f);
+			}
+			else if(arg == "--reuse" && hasValue) {
+				std::string name = argv[++i];
+				if(name != "off" && name != "skip" && name != "tiles") {
+					std::cout << "invalid reuse mode, expected off, skip, or tiles" << std::endl;
+					return false;
+				}
+				reuse = ChangeDetector::modeFromString(name);
+			}
+			else if(arg == "--reuse-threshold" && hasValue) {
+				reuseThreshold = std::max(ofToFloat(argv[++i]), 0.f);
+			}
+			else if(arg == "--roi" && hasValue) {
+				std::string name = argv[++i];
+				if(name != "off" && name != "depth") {
+					std::cout << "invalid roi mode, expected off or depth" << std::endl;
+					return false;
+				}
+				roi = (name == "depth");
+			}
+			else if(arg == "--roi-range" && hasValue) {
+				std::vector<std::string> range = ofSplitString(argv[++i], "-");
+				if(range.size() != 2 || ofToFloat(range[0]) >= ofToFloat(range[1])) {
+					std::cout << "invalid roi range, expected NEAR-FAR in meters" << std::endl;
+					return false;
+				}
+				roiNear = ofToFloat(range[0]);
+				roiFar = ofToFloat(range[1]);
+			}
+			else if(arg == "--upsample" && hasValue) {
+				std::string name = argv[++i];
+				if(name != "bicubic" && name != "guided") {
+					std::cout << "invalid upsample mode, expected bicubic or guided" << std::endl;
+					return false;
+				}
+				guidedUpsampling = (name == "guided");
+			}
+			else if(arg == "--inference-scale" && hasValue) {
+				inferenceScale = ofClamp(ofToFloat(argv[++i]), 0.1f, 1.f);
+			}
+			else if(arg == "--tile" && hasValue) {
+				tiling.tileSize = std::max(ofToInt(argv[++i]), 0);
+			}
+			else if(arg == "--tile-overlap" && hasValue) {
+				tiling.overlap = std::max(ofToInt(argv[++i]), 0);
+			}
+			else if(arg == "--tile-batch" && hasValue) {
+				tiling.batch = std::max(ofToInt(argv[++i]), 1);
+			}
+			else if((arg == "--transition" || arg == "--style-cycle") && hasValue) {
+				StyleTransition::Duration & duration = (arg == "--transition" ? styleTransition : styleCycle);
+				if(!StyleTransition::Duration::fromString(argv[++i], duration)) {
+					std::cout << "invalid duration, expected seconds or beats, ie. 2.5 or 4b" << std::endl;
+					return false;
+				}
+			}
+			else if(arg == "--bpm" && hasValue) {
+				bpm = ofClamp(ofToFloat(argv[++i]), 20.f, 300.f);
+			}
+			else if(arg == "--preview-batch" && hasValue) {
+				previewBatch = ofClamp(ofToInt(argv[++i]), 1, StylePreview::MAX_BATCH);
+			}
+			else if(arg == "--trace" && hasValue) {
+				traceFile = argv[++i];
+			}
+			else if(arg == "--style-dir" && hasValue) {
+				styleDir = argv[++i];
+			}
+			else if(arg == "--style-threads" && hasValue) {
+				styleThreads = ofClamp(ofToInt(argv[++i]), 1, 16);
+			}
+			else if(arg == "--style-pack" && hasValue) {
+				stylePack = argv[++i];
+			}
+			else if(arg == "--no-loop") {
+				loop = false;
+			}
+			else {
+				if(arg != "--help" && arg != "-h") {
+					std::cout << "unknown or incomplete argument: " << arg << std::endl;
+				}
+				printUsage();
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/// print command line usage
+	static void printUsage() {
+		std::cout << "Usage: AI_danceMirror [options]" << std::endl
+		          << "  --source SPEC     input: realsense[:SERIAL], bag:FILE, images:FOLDER," << std::endl
+		          << "                    or synthetic[:WxH] (default realsense)" << std::endl
+		          << "                    repeat for several streams stylized in one batch," << std::endl
+		          << "                    up to 8, each with its own style" << std::endl
+		          << "  --batch-timeout MS  several sources: max wait for the other streams'" << std::endl
+		          << "                    frames before a batch runs without them (default 20)" << std::endl
+		          << "  --model DIR       model folder (default models/my_model), repeat for" << std::endl
+		          << "                    variants to swap to with 'm' while running" << std::endl
+		          << "  --pacing MODE     realtime, fast, or fixed (default realtime)" << std::endl
+		          << "  --fps N           camera / generated / fixed step frame rate (default 30)" << std::endl
+		          << "  --size WxH        requested camera size (default 640x480)" << std::endl
+		          << "  --no-loop         stop at the end of recordings & image sequences" << std::endl
+		          << "  --device NAME     inference device: auto, gpu, or cpu (default auto:" << std::endl
+		          << "                    GPU if available)" << std::endl
+		          << "  --threads N       CPU inference threads with --device cpu" << std::endl
+		          << "                    (default cores - 2)" << std::endl
+		          << "  --precision MODE  fp32, fp16 (bfloat16 on the CPU), or int8: the" << std::endl
+		          << "                    <model>.int8 variant written by quantize_model.sh" << std::endl
+		          << "                    (default fp32)" << std::endl
+		          << "  --model-size WxH  style transfer input size, the maximum size with" << std::endl
+		          << "                    --target-fps (default 640x480, 320x240 on the CPU)" << std::endl
+		          << "  --target-fps N    step the model size in multiples of 32 to hold this" << std::endl
+		          << "                    output rate (default 0: fixed size)" << std::endl
+		          << "  --pipeline N      frames in flight, 1 = lowest latency, 0 = single" << std::endl
+		          << "                    background model thread (default 2)" << std::endl
+		          << "  --workers N       inference sessions, for CPU-only machines (default 1)" << std::endl
+		          << "  --intra-op N      threads per op per worker (default cores / workers)" << std::endl
+		          << "  --inter-op N      parallel ops per worker (default 1)" << std::endl
+		          << "  --no-pin          do not pin workers to their own cores" << std::endl
+		          << "  --reuse MODE      static frames: off, skip (reuse the last output)," << std::endl
+		          << "                    or tiles (also stylize changed regions only)" << std::endl
+		          << "                    (default off)" << std::endl
+		          << "  --reuse-threshold N  tile luma difference counted as motion (default 4)" << std::endl
+		          << "  --roi MODE        off or depth: stylize only the dancer found in the" << std::endl
+		          << "                    depth stream, over the last full output (default off)" << std::endl
+		          << "  --roi-range N-F   dancer depth range in meters (default 0.3-3.5)" << std::endl
+		          << "  --upsample MODE   bicubic (model size output) or guided: camera size" << std::endl
+		          << "                    output, edge aware upsampled (default bicubic)" << std::endl
+		          << "  --inference-scale F  guided: model size as a fraction of the camera" << std::endl
+		          << "                    size, ie. 0.5 or 0.25 (default 0.5)" << std::endl
+		          << "  --tile N          run model inputs larger than NxN as overlapping NxN" << std::endl
+		          << "                    tiles, bounds GPU memory at high resolution (default" << std::endl
+		          << "                    0: off)" << std::endl
+		          << "  --tile-overlap N  tile overlap & seam feather width (default 64)" << std::endl
+		          << "  --tile-batch N    tiles per model run (default 1)" << std::endl
+		          << "  --transition T    style change morph length in seconds or beats, ie." << std::endl
+		          << "                    2.5 or 4b, 0 cuts (default 1)" << std::endl
+		          << "  --style-cycle T   next style every T seconds or beats (default 0: off)" << std::endl
+		          << "  --bpm N           tempo for beat durations, 'b' taps it (default 120)" << std::endl
+		          << "  --preview-batch N styles per model run of the 'v' style preview (default 8)" << std::endl
+		          << "  --trace FILE      write a Chrome trace of every frame's stages on exit" << std::endl
+		          << "  --style-dir DIR   style image folder, watched while running (default style)" << std::endl
+		          << "  --style-threads N style image decode threads (default 2)" << std::endl
+		          << "  --style-pack FILE precompiled styles (default style/styles.pack)" << std::endl;
+	}
+};
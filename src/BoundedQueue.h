@@ -0,0 +1,122 @@
+/*
+ * AI Dance Mirror
+ *
+ * Bounded blocking FIFO queue between pipeline stages.
+ */
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+/// \class BoundedQueue
+/// \brief thread-safe FIFO with a fixed capacity
+///
+/// push() blocks while the queue is full, pushLatest() never blocks and drops
+/// the oldest queued item instead, pop() blocks until an item is available;
+/// close() wakes all waiting threads, pop() then drains the remaining items
+/// and returns false once the queue is empty
+template<typename T>
+class BoundedQueue {
+	public:
+
+		BoundedQueue(std::size_t capacity=1) : capacity(std::max(capacity, (std::size_t)1)) {}
+
+		/// set capacity, items above a reduced capacity are kept until popped
+		void setCapacity(std::size_t capacity) {
+			std::lock_guard<std::mutex> lock(mutex);
+			this->capacity = std::max(capacity, (std::size_t)1);
+			notFull.notify_all();
+		}
+
+		/// append, blocks while full, returns false if closed
+		bool push(T item) {
+			std::unique_lock<std::mutex> lock(mutex);
+			notFull.wait(lock, [this] {return closed || items.size() < capacity;});
+			if(closed) {
+				return false;
+			}
+			items.push_back(std::move(item));
+			notEmpty.notify_one();
+			return true;
+		}
+
+		/// append without blocking, returns false if full or closed
+		bool tryPush(T item) {
+			std::lock_guard<std::mutex> lock(mutex);
+			if(closed || items.size() >= capacity) {
+				return false;
+			}
+			items.push_back(std::move(item));
+			notEmpty.notify_one();
+			return true;
+		}
+
+		/// append without blocking, drops the oldest items while full,
+		/// returns the number of dropped items
+		std::size_t pushLatest(T item) {
+			std::lock_guard<std::mutex> lock(mutex);
+			std::size_t dropped = 0;
+			while(items.size() >= capacity) {
+				items.pop_front();
+				dropped++;
+			}
+			items.push_back(std::move(item));
+			notEmpty.notify_one();
+			return dropped;
+		}
+
+		/// remove the oldest item, blocks while empty,
+		/// returns false if closed and empty
+		bool pop(T & item) {
+			std::unique_lock<std::mutex> lock(mutex);
+			notEmpty.wait(lock, [this] {return closed || !items.empty();});
+			if(items.empty()) {
+				return false;
+			}
+			item = std::move(items.front());
+			items.pop_front();
+			notFull.notify_one();
+			return true;
+		}
+
+		/// remove the oldest item without blocking, returns false if empty
+		bool tryPop(T & item) {
+			std::lock_guard<std::mutex> lock(mutex);
+			if(items.empty()) {
+				return false;
+			}
+			item = std::move(items.front());
+			items.pop_front();
+			notFull.notify_one();
+			return true;
+		}
+
+		/// wake all waiting threads, later pushes fail
+		void close() {
+			std::lock_guard<std::mutex> lock(mutex);
+			closed = true;
+			notEmpty.notify_all();
+			notFull.notify_all();
+		}
+
+		/// reopen after close() and remove all items
+		void reset() {
+			std::lock_guard<std::mutex> lock(mutex);
+			items.clear();
+			closed = false;
+		}
+
+		std::size_t size() const {
+			std::lock_guard<std::mutex> lock(mutex);
+			return items.size();
+		}
+
+	private:
+		mutable std::mutex mutex;
+		std::condition_variable notEmpty;
+		std::condition_variable notFull;
+		std::deque<T> items;
+		std::size_t capacity;
+		bool closed = false;
+};
@@ -0,0 +1,249 @@
+/*
+ * AI Dance Mirror
+ *
+ * Per tile luma change detection to skip or limit inference on static frames.
+ */
+#pragma once
+
+#include "PixelSpan.h"
+#include <array>
+
+/// \class ChangeDetector
+/// \brief decides per frame whether the model has to run and on which region
+///
+/// each frame is reduced to a small luma grid (GRID_W x GRID_H cells, a few
+/// samples per cell) and compared tile by tile against the grid of the last
+/// frame sent to the model, by mean absolute difference; comparing against
+/// the last processed frame instead of the previous one means slow drift
+/// adds up until it is noticed
+///
+///   * MODE_SKIP: unchanged frames are skipped, the last output is reused,
+///     any change runs the full frame
+///   * MODE_TILES: as MODE_SKIP, but if the changed tiles cover less than
+///     FULL_FRACTION of the frame only their bounding box (padded by a tile
+///     for context) is stylized and blended into the previous output
+///
+/// a full frame is forced after invalidate(), ie. on style or size change,
+/// and at least every maxReuseFrames frames
+class ChangeDetector {
+	public:
+
+		/// reuse mode
+		enum Mode {
+			MODE_OFF = 0, ///< every frame runs the model
+			MODE_SKIP, ///< skip unchanged frames
+			MODE_TILES ///< skip unchanged frames, run changed regions only
+		};
+
+		/// what to do with a frame
+		struct Decision {
+			bool skip = false; ///< reuse the last output
+			PixelRect region; ///< region to stylize, empty for the full frame
+			float difference = 0; ///< largest tile difference, luma 0-255
+			float changed = 0; ///< changed tile fraction
+		};
+
+		/// counters
+		struct Stats {
+			uint64_t frames = 0; ///< analyzed frames
+			uint64_t skipped = 0; ///< reused outputs
+			uint64_t regions = 0; ///< partial frames
+			uint64_t full = 0; ///< full frames
+			double pixels = 1; ///< smoothed fraction of pixels run through the model
+		};
+
+		/// parse mode name: "off", "skip", or "tiles", returns MODE_OFF for
+		/// unknown names
+		static Mode modeFromString(const std::string & name) {
+			if(name == "skip") {
+				return MODE_SKIP;
+			}
+			if(name == "tiles") {
+				return MODE_TILES;
+			}
+			return MODE_OFF;
+		}
+
+		void setMode(Mode mode) {
+			this->mode = mode;
+			invalidate();
+		}
+
+		Mode getMode() const {return mode;}
+
+		/// mean absolute luma difference (0-255) above which a tile counts as
+		/// changed, a few units above camera noise
+		void setThreshold(float threshold) {
+			this->threshold = std::max(threshold, 0.f);
+		}
+
+		float getThreshold() const {return threshold;}
+
+		/// force a full frame after this many reused or partial frames,
+		/// 0 for never
+		void setMaxReuseFrames(int frames) {
+			maxReuseFrames = std::max(frames, 0);
+		}
+
+		/// force the next frame to run in full
+		void invalidate() {
+			valid = false;
+		}
+
+		/// analyze a frame and update the reference for the parts which will
+		/// be processed, the caller must follow the decision
+		Decision analyze(const PixelSpan & frame) {
+			Decision decision;
+			stats.frames++;
+			if(mode == MODE_OFF || !frame.isValid()) {
+				addFull(decision);
+				return decision;
+			}
+			sample(frame, current);
+			if(!valid || frame.width != width || frame.height != height ||
+			   (maxReuseFrames > 0 && sinceFull >= maxReuseFrames)) {
+				width = frame.width;
+				height = frame.height;
+				reference = current;
+				valid = true;
+				addFull(decision);
+				return decision;
+			}
+
+			// changed tiles & their bounding box in tiles
+			int changed = 0;
+			int x0 = TILES_X, y0 = TILES_Y, x1 = -1, y1 = -1;
+			for(int ty = 0; ty < TILES_Y; ty++) {
+				for(int tx = 0; tx < TILES_X; tx++) {
+					float difference = tileDifference(tx, ty);
+					decision.difference = std::max(decision.difference, difference);
+					if(difference > threshold) {
+						changed++;
+						x0 = std::min(x0, tx);
+						y0 = std::min(y0, ty);
+						x1 = std::max(x1, tx);
+						y1 = std::max(y1, ty);
+					}
+				}
+			}
+			decision.changed = (float)changed / (TILES_X * TILES_Y);
+
+			if(changed == 0) {
+				decision.skip = true;
+				stats.skipped++;
+				sinceFull++;
+				addPixels(0);
+				return decision;
+			}
+			if(mode == MODE_TILES) {
+				// pad by a tile so the model sees context around the change
+				x0 = std::max(x0 - 1, 0);
+				y0 = std::max(y0 - 1, 0);
+				x1 = std::min(x1 + 1, TILES_X - 1);
+				y1 = std::min(y1 + 1, TILES_Y - 1);
+				float area = (float)((x1 - x0 + 1) * (y1 - y0 + 1)) / (TILES_X * TILES_Y);
+				if(area < FULL_FRACTION) {
+					decision.region = tileRect(x0, y0, x1, y1);
+					copyTiles(x0, y0, x1, y1);
+					stats.regions++;
+					sinceFull++;
+					addPixels(area);
+					return decision;
+				}
+			}
+			reference = current;
+			addFull(decision);
+			return decision;
+		}
+
+		Stats getStats() const {return stats;}
+
+		// grid settings
+		static const int GRID_W = 80; ///< luma grid width in cells
+		static const int GRID_H = 60; ///< luma grid height in cells
+		static const int TILES_X = 8; ///< tiles across, 10x10 cells each
+		static const int TILES_Y = 6; ///< tiles down
+		static constexpr float FULL_FRACTION = 0.5f; ///< larger regions run the full frame
+
+	protected:
+
+		typedef std::array<uint8_t, GRID_W * GRID_H> Grid;
+
+		void addFull(Decision & decision) {
+			stats.full++;
+			sinceFull = 0;
+			addPixels(1);
+		}
+
+		void addPixels(double fraction) {
+			stats.pixels = stats.pixels * 0.95 + fraction * 0.05;
+		}
+
+		/// average 2x2 samples per cell, luma as (c0 + 2 * c1 + c2) / 4 which
+		/// weights green most for RGB & BGR alike
+		static void sample(const PixelSpan & frame, Grid & grid) {
+			const int channels = frame.getNumChannels();
+			for(int gy = 0; gy < GRID_H; gy++) {
+				int rows[2] = {
+					(gy * 4 + 1) * frame.height / (GRID_H * 4),
+					(gy * 4 + 3) * frame.height / (GRID_H * 4)
+				};
+				for(int gx = 0; gx < GRID_W; gx++) {
+					int cols[2] = {
+						(gx * 4 + 1) * frame.width / (GRID_W * 4),
+						(gx * 4 + 3) * frame.width / (GRID_W * 4)
+					};
+					int sum = 0;
+					for(int row : rows) {
+						const unsigned char * line = frame.row(row);
+						for(int col : cols) {
+							const unsigned char * p = line + col * channels;
+							sum += p[0] + 2 * p[1] + p[2];
+						}
+					}
+					grid[gy * GRID_W + gx] = (uint8_t)(sum / 16);
+				}
+			}
+		}
+
+		/// mean absolute difference of a tile
+		float tileDifference(int tx, int ty) const {
+			const int cellsX = GRID_W / TILES_X, cellsY = GRID_H / TILES_Y;
+			int sum = 0;
+			for(int y = ty * cellsY; y < (ty + 1) * cellsY; y++) {
+				for(int x = tx * cellsX; x < (tx + 1) * cellsX; x++) {
+					sum += std::abs(current[y * GRID_W + x] - reference[y * GRID_W + x]);
+				}
+			}
+			return (float)sum / (cellsX * cellsY);
+		}
+
+		/// take tiles x0-x1, y0-y1 of the current grid as reference
+		void copyTiles(int x0, int y0, int x1, int y1) {
+			const int cellsX = GRID_W / TILES_X, cellsY = GRID_H / TILES_Y;
+			for(int y = y0 * cellsY; y < (y1 + 1) * cellsY; y++) {
+				for(int x = x0 * cellsX; x < (x1 + 1) * cellsX; x++) {
+					reference[y * GRID_W + x] = current[y * GRID_W + x];
+				}
+			}
+		}
+
+		/// frame pixel rectangle of tiles x0-x1, y0-y1
+		PixelRect tileRect(int x0, int y0, int x1, int y1) const {
+			int left = x0 * width / TILES_X;
+			int top = y0 * height / TILES_Y;
+			int right = (x1 + 1) * width / TILES_X;
+			int bottom = (y1 + 1) * height / TILES_Y;
+			return PixelRect(left, top, right - left, bottom - top);
+		}
+
+		Mode mode = MODE_OFF;
+		float threshold = 4;
+		int maxReuseFrames = 150;
+		bool valid = false; ///< is the reference usable?
+		int width = 0, height = 0; ///< reference frame size
+		int sinceFull = 0; ///< frames since the last full frame
+		Grid current;
+		Grid reference; ///< luma as last sent to the model
+		Stats stats;
+};
@@ -0,0 +1,205 @@
+/*
+ * AI Dance Mirror
+ *
+ * Depth based performer bounding box to limit inference to the dancer.
+ */
+#pragma once
+
+#include "PixelSpan.h"
+#include <array>
+
+/// \class DancerRegion
+/// \brief finds the performer in an aligned depth frame and returns the
+///        frame region to stylize
+///
+/// the depth frame is sampled on a GRID_W x GRID_H grid, samples within the
+/// near - far range count as foreground; grid rows & columns with fewer than
+/// MIN_SAMPLES foreground samples are ignored, which removes speckle & thin
+/// edges of furniture at the same distance
+///
+/// the box is padded for context and smoothed over time: it grows at once
+/// so fast moves are never cut off, but shrinks slowly to avoid jitter
+///
+/// everything outside the box is left as it was in the previous output, so a
+/// full frame is requested after invalidate(), every backgroundFrames frames
+/// to refresh the background, when no one is in range, or when the box
+/// covers most of the frame anyway
+class DancerRegion {
+	public:
+
+		/// counters
+		struct Stats {
+			uint64_t frames = 0; ///< updated frames
+			uint64_t regions = 0; ///< frames limited to the dancer
+			uint64_t full = 0; ///< full frames
+			double pixels = 1; ///< smoothed fraction of pixels run through the model
+		};
+
+		void setEnabled(bool enabled) {
+			this->enabled = enabled;
+			invalidate();
+		}
+
+		bool isEnabled() const {return enabled;}
+
+		/// foreground depth range in meters
+		void setRange(float nearDepth, float farDepth) {
+			this->nearDepth = std::max(nearDepth, 0.f);
+			this->farDepth = std::max(farDepth, this->nearDepth);
+		}
+
+		float getNear() const {return nearDepth;}
+		float getFar() const {return farDepth;}
+
+		/// padding around the box as a fraction of its size, default 0.15
+		void setPadding(float padding) {
+			this->padding = std::max(padding, 0.f);
+		}
+
+		/// refresh the background with a full frame after this many frames,
+		/// 0 for never
+		void setBackgroundFrames(int frames) {
+			backgroundFrames = std::max(frames, 0);
+		}
+
+		/// force the next frame to run in full
+		void invalidate() {
+			valid = false;
+			box = PixelRect();
+		}
+
+		/// region of a width x height frame to stylize, empty for the full
+		/// frame; depth must be aligned to the frame, invalid depth runs the
+		/// full frame
+		PixelRect update(const DepthSpan & depth, int width, int height) {
+			stats.frames++;
+			if(!enabled || !depth.isValid() || !valid || width != frameWidth || height != frameHeight ||
+			   (backgroundFrames > 0 && sinceFull >= backgroundFrames)) {
+				frameWidth = width;
+				frameHeight = height;
+				valid = true;
+				box = find(depth, width, height);
+				return addFull();
+			}
+			PixelRect found = find(depth, width, height);
+			if(found.isEmpty()) {
+				box = found;
+				return addFull();
+			}
+			box = smooth(found);
+			float area = (float)box.getArea() / (width * height);
+			if(area >= FULL_FRACTION) {
+				return addFull();
+			}
+			stats.regions++;
+			sinceFull++;
+			addPixels(area);
+			return box;
+		}
+
+		/// last dancer box in frame pixels, empty if no one was found
+		const PixelRect & getBox() const {return box;}
+
+		Stats getStats() const {return stats;}
+
+		// grid settings
+		static const int GRID_W = 80; ///< depth samples across
+		static const int GRID_H = 60; ///< depth samples down
+		static const int MIN_SAMPLES = 2; ///< foreground samples for a row or column to count
+		static constexpr float MIN_FOREGROUND = 0.005f; ///< fewer foreground samples: no one in range
+		static constexpr float FULL_FRACTION = 0.6f; ///< larger boxes run the full frame
+		static constexpr float SHRINK = 0.2f; ///< per frame fraction a box edge moves inwards
+
+	protected:
+
+		PixelRect addFull() {
+			stats.full++;
+			sinceFull = 0;
+			addPixels(1);
+			return PixelRect();
+		}
+
+		void addPixels(double fraction) {
+			stats.pixels = stats.pixels * 0.95 + fraction * 0.05;
+		}
+
+		/// padded foreground bounding box in frame pixels, empty if none
+		PixelRect find(const DepthSpan & depth, int width, int height) const {
+			if(!depth.isValid()) {
+				return PixelRect();
+			}
+			const uint16_t nearUnits = (uint16_t)std::min(nearDepth / depth.scale, 65535.f);
+			const uint16_t farUnits = (uint16_t)std::min(farDepth / depth.scale, 65535.f);
+			std::array<int, GRID_W> columns{};
+			std::array<int, GRID_H> rows{};
+			int total = 0;
+			for(int gy = 0; gy < GRID_H; gy++) {
+				const uint16_t * line = depth.row((gy * 2 + 1) * depth.height / (GRID_H * 2));
+				for(int gx = 0; gx < GRID_W; gx++) {
+					uint16_t value = line[(gx * 2 + 1) * depth.width / (GRID_W * 2)];
+					// 0 is no depth, ie. shadows & out of range
+					if(value != 0 && value >= nearUnits && value <= farUnits) {
+						columns[gx]++;
+						rows[gy]++;
+						total++;
+					}
+				}
+			}
+			if(total < MIN_FOREGROUND * GRID_W * GRID_H) {
+				return PixelRect();
+			}
+			int x0 = GRID_W, x1 = -1, y0 = GRID_H, y1 = -1;
+			for(int gx = 0; gx < GRID_W; gx++) {
+				if(columns[gx] >= MIN_SAMPLES) {
+					x0 = std::min(x0, gx);
+					x1 = gx;
+				}
+			}
+			for(int gy = 0; gy < GRID_H; gy++) {
+				if(rows[gy] >= MIN_SAMPLES) {
+					y0 = std::min(y0, gy);
+					y1 = gy;
+				}
+			}
+			if(x1 < x0 || y1 < y0) {
+				return PixelRect();
+			}
+
+			// grid cells to frame pixels, padded by a cell plus a fraction
+			float padX = (x1 - x0 + 1) * padding + 1;
+			float padY = (y1 - y0 + 1) * padding + 1;
+			int left = (int)std::max((x0 - padX) * width / GRID_W, 0.f);
+			int top = (int)std::max((y0 - padY) * height / GRID_H, 0.f);
+			int right = (int)std::min((x1 + 1 + padX) * width / GRID_W, (float)width);
+			int bottom = (int)std::min((y1 + 1 + padY) * height / GRID_H, (float)height);
+			return PixelRect(left, top, right - left, bottom - top);
+		}
+
+		/// grow to the new box at once, shrink towards it by SHRINK per frame
+		PixelRect smooth(const PixelRect & found) const {
+			if(box.isEmpty()) {
+				return found;
+			}
+			auto edge = [](int current, int target, bool grows) {
+				return grows ? target : current + (int)std::round((target - current) * SHRINK);
+			};
+			int left = edge(box.x, found.x, found.x < box.x);
+			int top = edge(box.y, found.y, found.y < box.y);
+			int right = edge(box.x + box.width, found.x + found.width,
+			                 found.x + found.width > box.x + box.width);
+			int bottom = edge(box.y + box.height, found.y + found.height,
+			                  found.y + found.height > box.y + box.height);
+			return PixelRect(left, top, right - left, bottom - top);
+		}
+
+		bool enabled = false;
+		float nearDepth = 0.3f; ///< m
+		float farDepth = 3.5f; ///< m
+		float padding = 0.15f;
+		int backgroundFrames = 90;
+		bool valid = false; ///< has the background been refreshed?
+		int frameWidth = 0, frameHeight = 0; ///< size of the last full frame
+		int sinceFull = 0; ///< frames since the last full frame
+		PixelRect box; ///< smoothed dancer box
+		Stats stats;
+};
@@ -0,0 +1,221 @@
+/*
+ * AI Dance Mirror
+ *
+ * Background frame capture with a lock-free "latest frame wins" handoff.
+ */
+#pragma once
+
+#include "ofMain.h"
+#include "PixelSpan.h"
+#include <atomic>
+#include <array>
+#include <functional>
+
+/// \struct Frame
+/// \brief a single captured input frame
+///
+/// sources either fill pixels or reference their own buffer via setExternal(),
+/// ie. a camera frame which is then read in place, use getSpan() to read
+struct Frame {
+	ofPixels pixels; ///< RGB pixels
+	uint64_t index = 0; ///< capture sequence number, starts at 0
+	uint64_t captureTime = 0; ///< capture time in us, see ofGetElapsedTimeMicros()
+	uint64_t sourceTime = 0; ///< media time in us as reported by the source
+
+	PixelSpan external; ///< external buffer, used instead of pixels if valid
+	DepthSpan depth; ///< depth aligned to the pixels, if the source has depth
+	std::shared_ptr<void> externalOwner; ///< keeps the external buffers alive
+
+	/// pixels to read: the external buffer if set, otherwise pixels
+	PixelSpan getSpan() const {
+		return external.isValid() ? external : PixelSpan(pixels);
+	}
+
+	/// reference an external buffer, owner is held until the frame is reused,
+	/// depth is cleared
+	void setExternal(const PixelSpan & span, std::shared_ptr<void> owner) {
+		external = span;
+		depth = DepthSpan();
+		externalOwner = owner;
+	}
+
+	/// pixels which stay valid after the frame is reused: set span and return
+	/// its owner, external buffers are shared without copying, frame pixels
+	/// are copied since the grabber overwrites them
+	std::shared_ptr<void> retain(PixelSpan & span) const {
+		if(external.isValid()) {
+			span = external;
+			return externalOwner;
+		}
+		auto copy = std::make_shared<ofPixels>(pixels);
+		span = PixelSpan(*copy);
+		return copy;
+	}
+
+	/// drop the external buffer reference
+	void releaseExternal() {
+		external = PixelSpan();
+		depth = DepthSpan();
+		externalOwner.reset();
+	}
+};
+
+/// \class LatestFrameSlot
+/// \brief single-producer/single-consumer triple buffer, newest value wins
+///
+/// the producer fills back() and calls publish(), the consumer calls poll()
+/// and reads front(), neither side ever blocks or allocates: the three
+/// buffers are rotated through a single atomic index
+///
+/// if the producer publishes twice before the consumer polls, the older value
+/// is overwritten (dropped) and the consumer only sees the newest one
+template<typename T>
+class LatestFrameSlot {
+	public:
+
+		/// producer: buffer to fill before calling publish()
+		T & back() {return buffers[backIndex];}
+
+		/// producer: make back() visible to the consumer,
+		/// returns true if an unread value was overwritten
+		bool publish() {
+			int prev = middle.exchange(backIndex | FRESH, std::memory_order_acq_rel);
+			backIndex = prev & INDEX_MASK;
+			return (prev & FRESH) != 0;
+		}
+
+		/// consumer: swap in the newest published value,
+		/// returns true if front() changed since the last poll
+		bool poll() {
+			if(!(middle.load(std::memory_order_acquire) & FRESH)) {
+				return false;
+			}
+			int prev = middle.exchange(frontIndex, std::memory_order_acq_rel);
+			frontIndex = prev & INDEX_MASK;
+			return true;
+		}
+
+		/// consumer: most recently polled value
+		T & front() {return buffers[frontIndex];}
+
+	private:
+		static const int INDEX_MASK = 0x3; ///< buffer index bits
+		static const int FRESH = 0x4; ///< middle holds an unread value
+
+		std::array<T, 3> buffers;
+		std::atomic<int> middle{1}; ///< shared buffer index + FRESH flag
+		int backIndex = 0; ///< owned by the producer
+		int frontIndex = 2; ///< owned by the consumer
+};
+
+/// \class FrameGrabber
+/// \brief runs a blocking capture function on its own thread
+///
+/// the render thread calls poll() once per update and never waits on the
+/// camera, so render pacing is independent of the capture rate
+///
+/// the capture function blocks until a frame is available (or a timeout) and
+/// fills the given frame, returning false if there was no frame; any source
+/// can be plugged in, ie. a synthetic generator on a machine with no camera:
+///
+///     grabber.start([](Frame & frame) {
+///         frame.pixels.allocate(640, 480, OF_PIXELS_RGB);
+///         frame.pixels.set(frame.index % 256);
+///         ofSleepMillis(33);
+///         return true;
+///     });
+///
+class FrameGrabber : public ofThread {
+	public:
+
+		/// capture function: fill frame and return true or false if no frame
+		typedef std::function<bool(Frame & frame)> GrabFunction;
+
+		/// capture counters
+		struct Stats {
+			uint64_t captured = 0; ///< frames delivered by the capture function
+			uint64_t consumed = 0; ///< frames picked up by poll()
+			uint64_t dropped = 0; ///< frames overwritten before they were polled
+			uint64_t stale = 0; ///< polls which found no new frame
+			uint64_t timeouts = 0; ///< capture calls which returned no frame
+		};
+
+		~FrameGrabber() {
+			stop();
+		}
+
+		/// start capturing on the background thread
+		void start(GrabFunction function) {
+			stop();
+			grab = function;
+			startThread();
+		}
+
+		/// stop capturing, blocks until the capture thread has exited
+		void stop() {
+			if(isThreadRunning()) {
+				waitForThread(true);
+			}
+		}
+
+		/// consumer: returns true if a new frame is available via getFrame(),
+		/// never blocks
+		bool poll() {
+			if(slot.poll()) {
+				consumed++;
+				return true;
+			}
+			stale++;
+			return false;
+		}
+
+		/// consumer: most recently polled frame, valid until the next poll()
+		Frame & getFrame() {return slot.front();}
+
+		/// age of the most recently polled frame in us
+		uint64_t getFrameAge() {
+			return ofGetElapsedTimeMicros() - slot.front().captureTime;
+		}
+
+		/// snapshot of the capture counters
+		Stats getStats() const {
+			Stats stats;
+			stats.captured = captured.load();
+			stats.consumed = consumed.load();
+			stats.dropped = dropped.load();
+			stats.stale = stale.load();
+			stats.timeouts = timeouts.load();
+			return stats;
+		}
+
+	protected:
+
+		void threadedFunction() {
+			uint64_t index = 0;
+			while(isThreadRunning()) {
+				Frame & frame = slot.back();
+				frame.releaseExternal(); // hand the old camera buffer back
+				frame.index = index;
+				if(!grab(frame)) {
+					timeouts++;
+					continue;
+				}
+				frame.captureTime = ofGetElapsedTimeMicros();
+				index++;
+				captured++;
+				if(slot.publish()) {
+					dropped++;
+				}
+			}
+		}
+
+	private:
+		GrabFunction grab;
+		LatestFrameSlot<Frame> slot;
+
+		std::atomic<uint64_t> captured{0};
+		std::atomic<uint64_t> consumed{0};
+		std::atomic<uint64_t> dropped{0};
+		std::atomic<uint64_t> stale{0};
+		std::atomic<uint64_t> timeouts{0};
+};
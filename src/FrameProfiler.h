@@ -0,0 +1,273 @@
+/*
+ * AI Dance Mirror
+ *
+ * Per frame stage timestamps, latency histograms, and Chrome trace export.
+ */
+#pragma once
+
+#include "ofMain.h"
+#include <array>
+#include <cmath>
+
+/// \struct FrameTimes
+/// \brief timestamps of one frame moving from the camera to the screen
+///
+/// all times are ofGetElapsedTimeMicros(), 0 if a stage was not recorded
+struct FrameTimes {
+	uint64_t index = 0; ///< capture sequence number
+	int worker = 0; ///< inference worker
+	uint64_t capture = 0; ///< frame received from the source
+	uint64_t submit = 0; ///< handed to the style pipeline
+	uint64_t preprocessStart = 0;
+	uint64_t preprocessEnd = 0;
+	uint64_t inferenceStart = 0;
+	uint64_t inferenceEnd = 0;
+	uint64_t postprocessStart = 0;
+	uint64_t postprocessEnd = 0;
+	uint64_t uploadStart = 0; ///< output texture upload
+	uint64_t uploadEnd = 0;
+	uint64_t present = 0; ///< end of the first draw() showing the frame
+};
+
+/// \class LatencyHistogram
+/// \brief log scale histogram of durations for percentile queries
+///
+/// buckets grow by 2% from 10 us to 10 s, so percentiles are accurate to
+/// about 1% with a fixed amount of memory however long the run
+class LatencyHistogram {
+	public:
+
+		LatencyHistogram() {
+			reset();
+		}
+
+		/// add a duration in ms
+		void add(double ms) {
+			buckets[bucket(ms)]++;
+			count++;
+			sum += ms;
+			max = std::max(max, ms);
+		}
+
+		/// duration in ms at percentile p (0-100), 0 if empty
+		double percentile(double p) const {
+			if(count == 0) {
+				return 0;
+			}
+			uint64_t rank = std::max((uint64_t)std::ceil(p / 100.0 * count), (uint64_t)1);
+			uint64_t seen = 0;
+			for(std::size_t i = 0; i < buckets.size(); i++) {
+				seen += buckets[i];
+				if(seen >= rank) {
+					// bucket center, clamped to the largest value seen
+					return std::min(MIN_MS * std::pow(GROWTH, i + 0.5), max);
+				}
+			}
+			return max;
+		}
+
+		uint64_t getCount() const {return count;}
+		double getMean() const {return count ? sum / count : 0;}
+		double getMax() const {return max;}
+
+		void reset() {
+			buckets.fill(0);
+			count = 0;
+			sum = 0;
+			max = 0;
+		}
+
+		static constexpr double MIN_MS = 0.01; ///< first bucket
+		static constexpr double GROWTH = 1.02; ///< bucket size ratio
+		static const int BUCKETS = 700; ///< up to ~10 s
+
+	protected:
+
+		static std::size_t bucket(double ms) {
+			if(ms <= MIN_MS) {
+				return 0;
+			}
+			int i = (int)(std::log(ms / MIN_MS) / std::log(GROWTH));
+			return std::min(std::max(i, 0), BUCKETS - 1);
+		}
+
+		std::array<uint64_t, BUCKETS> buckets;
+		uint64_t count = 0;
+		double sum = 0;
+		double max = 0;
+};
+
+/// \class FrameProfiler
+/// \brief per stage & glass-to-glass latency histograms from FrameTimes,
+///        optionally recorded as a Chrome trace
+///
+/// add() each frame once it has been presented, stages which were not
+/// recorded are skipped; with a trace file set, every frame's stages are
+/// also kept as trace events and written by writeTrace(), open the file in
+/// chrome://tracing or https://ui.perfetto.dev
+class FrameProfiler {
+	public:
+
+		/// measured intervals
+		enum Stage {
+			STAGE_CAPTURE = 0, ///< capture until submitted by the render thread
+			STAGE_QUEUE, ///< submitted until preprocessing starts
+			STAGE_PREPROCESS,
+			STAGE_INFERENCE,
+			STAGE_POSTPROCESS,
+			STAGE_OUTPUT, ///< postprocessed until picked up by the render thread
+			STAGE_UPLOAD,
+			STAGE_PRESENT, ///< uploaded until drawn
+			STAGE_GLASS_TO_GLASS, ///< capture until drawn
+			NUM_STAGES
+		};
+
+		/// stage name
+		static const char * getName(Stage stage) {
+			static const char * names[NUM_STAGES] = {
+				"capture", "queue", "preprocess", "inference", "postprocess",
+				"output", "upload", "present", "glass-to-glass"
+			};
+			return names[stage];
+		}
+
+		/// record a presented frame
+		void add(const FrameTimes & times) {
+			addStage(STAGE_CAPTURE, times.capture, times.submit);
+			addStage(STAGE_QUEUE, times.submit, times.preprocessStart);
+			addStage(STAGE_PREPROCESS, times.preprocessStart, times.preprocessEnd);
+			addStage(STAGE_INFERENCE, times.inferenceStart, times.inferenceEnd);
+			addStage(STAGE_POSTPROCESS, times.postprocessStart, times.postprocessEnd);
+			addStage(STAGE_OUTPUT, times.postprocessEnd, times.uploadStart);
+			addStage(STAGE_UPLOAD, times.uploadStart, times.uploadEnd);
+			addStage(STAGE_PRESENT, times.uploadEnd, times.present);
+			addStage(STAGE_GLASS_TO_GLASS, times.capture, times.present);
+			if(tracing) {
+				addTrace(times);
+			}
+		}
+
+		/// histogram of a stage
+		const LatencyHistogram & getHistogram(Stage stage) const {return histograms[stage];}
+
+		/// clear all histograms, trace events are kept
+		void reset() {
+			for(auto & histogram : histograms) {
+				histogram.reset();
+			}
+		}
+
+		/// one line per stage with samples: name, p50, p95, p99, max in ms
+		std::string getSummary() const {
+			std::stringstream summary;
+			summary << std::left << std::setw(16) << "stage ms" << std::right
+			        << std::setw(8) << "p50" << std::setw(8) << "p95"
+			        << std::setw(8) << "p99" << std::setw(8) << "max" << std::endl;
+			for(int i = 0; i < NUM_STAGES; i++) {
+				const LatencyHistogram & histogram = histograms[i];
+				if(histogram.getCount() == 0) {
+					continue;
+				}
+				summary << std::left << std::setw(16) << getName((Stage)i) << std::right << std::fixed
+				        << std::setprecision(1)
+				        << std::setw(8) << histogram.percentile(50)
+				        << std::setw(8) << histogram.percentile(95)
+				        << std::setw(8) << histogram.percentile(99)
+				        << std::setw(8) << histogram.getMax() << std::endl;
+			}
+			return summary.str();
+		}
+
+		/// keep trace events for writeTrace()
+		void setTracing(bool tracing) {
+			this->tracing = tracing;
+		}
+
+		bool isTracing() const {return tracing;}
+
+		/// write recorded frames as Chrome trace_event JSON,
+		/// returns true on success
+		bool writeTrace(const std::string & path) const {
+			ofJson events = ofJson::array();
+			const char * threads[] = {"capture", "preprocess", "inference", "postprocess", "render"};
+			for(int i = 0; i < 5; i++) {
+				events.push_back({
+					{"name", "thread_name"}, {"ph", "M"}, {"pid", 1}, {"tid", i + 1},
+					{"args", {{"name", threads[i]}}}
+				});
+			}
+			int workers = 0;
+			for(auto & event : trace) {
+				workers = std::max(workers, event.thread - 5);
+			}
+			for(int i = 1; i <= workers; i++) {
+				events.push_back({
+					{"name", "thread_name"}, {"ph", "M"}, {"pid", 1}, {"tid", 5 + i},
+					{"args", {{"name", "inference " + ofToString(i)}}}
+				});
+			}
+			for(auto & event : trace) {
+				events.push_back({
+					{"name", getName(event.stage)}, {"cat", "frame"}, {"ph", "X"},
+					{"pid", 1}, {"tid", event.thread},
+					{"ts", event.start}, {"dur", event.duration},
+					{"args", {{"frame", event.frame}}}
+				});
+			}
+			ofJson json;
+			json["traceEvents"] = events;
+			json["displayTimeUnit"] = "ms";
+			if(!ofSaveJson(path, json)) {
+				ofLogError("FrameProfiler") << "failed to write trace " << path;
+				return false;
+			}
+			ofLogNotice("FrameProfiler") << "wrote " << trace.size() << " trace events to " << path;
+			return true;
+		}
+
+		static const std::size_t MAX_TRACE_EVENTS = 1000000; ///< ~ 1 hour at 30 fps
+
+	protected:
+
+		struct TraceEvent {
+			Stage stage;
+			int thread; ///< trace tid
+			uint64_t frame;
+			uint64_t start; ///< us
+			uint64_t duration; ///< us
+		};
+
+		void addStage(Stage stage, uint64_t start, uint64_t end) {
+			if(start > 0 && end >= start) {
+				histograms[stage].add((end - start) / 1000.0);
+			}
+		}
+
+		void addTrace(const FrameTimes & times) {
+			if(trace.size() >= MAX_TRACE_EVENTS) {
+				if(tracing) {
+					ofLogWarning("FrameProfiler") << "trace full, recording stopped";
+					tracing = false;
+				}
+				return;
+			}
+			// workers get their own inference rows after the fixed threads
+			addEvent(STAGE_CAPTURE, 1, times.index, times.capture, times.submit);
+			addEvent(STAGE_PREPROCESS, 2, times.index, times.preprocessStart, times.preprocessEnd);
+			addEvent(STAGE_INFERENCE, times.worker > 0 ? 5 + times.worker : 3, times.index,
+			         times.inferenceStart, times.inferenceEnd);
+			addEvent(STAGE_POSTPROCESS, 4, times.index, times.postprocessStart, times.postprocessEnd);
+			addEvent(STAGE_UPLOAD, 5, times.index, times.uploadStart, times.uploadEnd);
+			addEvent(STAGE_PRESENT, 5, times.index, times.uploadEnd, times.present);
+		}
+
+		void addEvent(Stage stage, int thread, uint64_t frame, uint64_t start, uint64_t end) {
+			if(start > 0 && end >= start) {
+				trace.push_back({stage, thread, frame, start, end - start});
+			}
+		}
+
+		std::array<LatencyHistogram, NUM_STAGES> histograms;
+		bool tracing = false;
+		std::vector<TraceEvent> trace;
+};
@@ -0,0 +1,177 @@
+/*
+ * AI Dance Mirror
+ *
+ * Input frame source interface.
+ */
+#pragma once
+
+#include "ofMain.h"
+#include "FrameGrabber.h"
+#include <chrono>
+#include <thread>
+
+/// \class FramePacer
+/// \brief sleeps until the next frame deadline of a fixed frame interval
+///
+/// if the caller falls behind by more than one interval, the schedule is
+/// restarted from now instead of trying to catch up with a burst of frames
+class FramePacer {
+	public:
+
+		/// set frame interval in seconds, <= 0 disables waiting
+		void setInterval(double seconds) {
+			interval = std::chrono::duration_cast<Clock::duration>(
+				std::chrono::duration<double>(std::max(seconds, 0.0)));
+			reset();
+		}
+
+		/// restart the schedule on the next wait()
+		void reset() {
+			started = false;
+		}
+
+		/// block until the next deadline
+		void wait() {
+			if(interval.count() <= 0) {
+				return;
+			}
+			Clock::time_point now = Clock::now();
+			if(!started || now > deadline + interval) {
+				deadline = now;
+				started = true;
+			}
+			else {
+				std::this_thread::sleep_until(deadline);
+			}
+			deadline += interval;
+		}
+
+	private:
+		typedef std::chrono::steady_clock Clock;
+		Clock::duration interval{0};
+		Clock::time_point deadline;
+		bool started = false;
+};
+
+/// \class FrameSource
+/// \brief interface for input frame backends
+///
+/// grab() is called from the FrameGrabber capture thread, blocks according to
+/// the pacing mode and fills an RGB frame
+///
+/// pacing modes:
+///   * PACING_REALTIME: follow the source clock, recordings play back at
+///     their recorded speed and may skip frames if the consumer is slow
+///   * PACING_FAST: deliver frames as fast as possible, never waits
+///   * PACING_FIXED: deliver every frame at a fixed rate (see setFrameRate()),
+///     media timestamps advance by exactly one step per frame which makes runs
+///     reproducible
+///
+/// a live camera can not go faster than its own frame rate, so PACING_FAST
+/// behaves like PACING_REALTIME for live sources
+class FrameSource {
+	public:
+
+		enum Pacing {
+			PACING_REALTIME, ///< source clock
+			PACING_FAST, ///< as fast as possible
+			PACING_FIXED ///< fixed step at the set frame rate
+		};
+
+		virtual ~FrameSource() {}
+
+		/// open the source, returns true on success
+		virtual bool open() = 0;
+
+		/// close the source
+		virtual void close() {}
+
+		/// block until the next frame is due and fill it,
+		/// returns false on timeout or if the source is finished
+		virtual bool grab(Frame & frame) = 0;
+
+		/// short human readable description
+		virtual std::string getName() const = 0;
+
+		/// frame width, valid after open()
+		int getWidth() const {return width;}
+
+		/// frame height, valid after open()
+		int getHeight() const {return height;}
+
+		/// returns true if a finite source has delivered its last frame
+		bool isFinished() const {return finished;}
+
+		/// set pacing mode, call before open()
+		void setPacing(Pacing pacing) {
+			this->pacing = pacing;
+		}
+
+		/// returns current pacing mode
+		Pacing getPacing() const {return pacing;}
+
+		/// set nominal frame rate used for generated sources and PACING_FIXED
+		void setFrameRate(float fps) {
+			frameRate = std::max(fps, 1.0f);
+		}
+
+		/// returns nominal frame rate
+		float getFrameRate() const {return frameRate;}
+
+		/// restart finite sources when they reach the end, default true
+		void setLoop(bool loop) {
+			this->loop = loop;
+		}
+
+		/// request depth aligned to the color frames (see Frame::depth), call
+		/// before open(), sources without depth ignore it
+		void setDepth(bool depth) {
+			depthRequested = depth;
+		}
+
+		/// returns true if frames carry depth, valid after open()
+		bool hasDepth() const {return depthAvailable;}
+
+		/// parse pacing mode name: "realtime", "fast", or "fixed",
+		/// returns PACING_REALTIME for unknown names
+		static Pacing pacingFromString(const std::string & name) {
+			if(name == "fast") {
+				return PACING_FAST;
+			}
+			else if(name == "fixed") {
+				return PACING_FIXED;
+			}
+			else if(name != "realtime") {
+				ofLogWarning("FrameSource") << "unknown pacing \"" << name << "\", using realtime";
+			}
+			return PACING_REALTIME;
+		}
+
+	protected:
+
+		/// set up the pacer for generated sources, call from open()
+		void startPacing() {
+			pacer.setInterval(pacing == PACING_FAST ? 0 : 1.0 / frameRate);
+		}
+
+		/// media time of a generated frame in us
+		uint64_t stepTime(uint64_t index) const {
+			return (uint64_t)(index * 1000000.0 / frameRate);
+		}
+
+		/// called by finished sources to avoid spinning the capture thread
+		bool idle() {
+			ofSleepMillis(10);
+			return false;
+		}
+
+		int width = 0;
+		int height = 0;
+		Pacing pacing = PACING_REALTIME;
+		float frameRate = 30;
+		bool loop = true;
+		bool finished = false;
+		bool depthRequested = false; ///< setDepth()
+		bool depthAvailable = false; ///< set by sources which deliver depth
+		FramePacer pacer;
+};
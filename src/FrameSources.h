@@ -0,0 +1,58 @@
+/*
+ * AI Dance Mirror
+ *
+ * Frame source backends and factory.
+ */
+#pragma once
+
+#include "FrameSource.h"
+#include "RealSenseFrameSource.h"
+#include "ImageSequenceFrameSource.h"
+#include "SyntheticFrameSource.h"
+
+/// create a frame source from a spec string, returns nullptr if unknown:
+///   * "realsense" or "realsense:<serial>": live camera
+///   * "bag:<path>": RealSense .bag recording
+///   * "images:<folder>": PNG/JPEG image sequence
+///   * "synthetic" or "synthetic:<width>x<height>": generated test pattern
+///
+/// width, height & fps are the requested live camera mode and the default
+/// synthetic frame size
+inline std::shared_ptr<FrameSource> createFrameSource(const std::string & spec,
+                                                      int width=640, int height=480, int fps=30) {
+	std::string type = spec;
+	std::string arg;
+	std::size_t colon = spec.find(':');
+	if(colon != std::string::npos) {
+		type = spec.substr(0, colon);
+		arg = spec.substr(colon + 1);
+	}
+	std::shared_ptr<FrameSource> source;
+	if(type == "realsense") {
+		auto realsense = std::make_shared<RealSenseFrameSource>(width, height, fps);
+		realsense->setSerial(arg);
+		source = realsense;
+	}
+	else if(type == "bag" && !arg.empty()) {
+		auto realsense = std::make_shared<RealSenseFrameSource>(width, height, fps);
+		realsense->setFile(arg);
+		source = realsense;
+	}
+	else if(type == "images" && !arg.empty()) {
+		source = std::make_shared<ImageSequenceFrameSource>(arg);
+	}
+	else if(type == "synthetic") {
+		std::vector<std::string> size = ofSplitString(arg, "x", true, true);
+		if(size.size() == 2) {
+			width = ofToInt(size[0]);
+			height = ofToInt(size[1]);
+		}
+		source = std::make_shared<SyntheticFrameSource>(width, height);
+	}
+	else {
+		ofLogError("FrameSource") << "unknown frame source \"" << spec << "\"";
+		return nullptr;
+	}
+	source->setFrameRate(fps);
+	return source;
+}
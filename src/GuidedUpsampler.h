@@ -0,0 +1,361 @@
+/*
+ * AI Dance Mirror
+ *
+ * Edge aware upsampling of low resolution model output, guided by the camera frame.
+ */
+#pragma once
+
+#include "PixelKernels.h"
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/// \class GuidedUpsampler
+/// \brief upsamples a low resolution stylized image to the size of a full
+///        resolution guide image with a fast guided filter
+///
+/// the guide, ie. the camera frame, is area averaged down to the model
+/// output size, where each output channel is fitted as a local linear
+/// function of the same guide channel over a (2 * radius + 1)^2 window:
+///
+///     q = a * I + b,  a = cov(I, p) / (var(I) + epsilon),  b = mean(p) - a * mean(I)
+///
+/// a and b are smoothed, upsampled bilinearly, and applied to the full
+/// resolution guide, so edges come from the camera frame while colors and
+/// texture come from the model; epsilon trades edge sharpness for
+/// smoothness, larger values approach plain bilinear upsampling
+///
+/// the low resolution passes and the full resolution pass are split into row
+/// bands on a small persistent thread pool, the per pixel work of the final
+/// pass is PixelKernels::toFloat() & affineToUnsignedChar()
+class GuidedUpsampler {
+	public:
+
+		GuidedUpsampler() {}
+		GuidedUpsampler(const GuidedUpsampler &) = delete;
+		GuidedUpsampler & operator=(const GuidedUpsampler &) = delete;
+
+		~GuidedUpsampler() {
+			stopThreads();
+		}
+
+		/// low resolution window radius in pixels, default 2
+		void setRadius(int radius) {
+			this->radius = std::min(std::max(radius, 1), MAX_RADIUS);
+		}
+
+		int getRadius() const {return radius;}
+
+		/// regularization, colors in 0-1, default 0.001
+		void setEpsilon(float epsilon) {
+			this->epsilon = std::max(epsilon, 1e-6f);
+		}
+
+		float getEpsilon() const {return epsilon;}
+
+		/// threads for the row bands including the caller,
+		/// 0 for min(cores, DEFAULT_THREADS), takes effect on the next process()
+		void setThreads(int threads) {
+			requestedThreads = std::max(threads, 0);
+		}
+
+		/// threads in use, valid after the first process()
+		int getThreads() const {return (int)pool.size() + 1;}
+
+		/// upsample low, lowWidth x lowHeight normalized RGB floats, to
+		/// pixels at the guide's size, returns false on invalid input
+		bool process(const float * low, int lowWidth, int lowHeight, const PixelSpan & guide, ofPixels & pixels) {
+			if(!low || lowWidth < 1 || lowHeight < 1 || !guide.isValid()) {
+				return false;
+			}
+			startThreads();
+			const int width = guide.width, height = guide.height;
+			if(pixels.getWidth() != width || pixels.getHeight() != height || pixels.getNumChannels() != 3) {
+				pixels.allocate(width, height, OF_PIXELS_RGB);
+			}
+			const std::size_t count = (std::size_t)lowWidth * lowHeight * 3;
+			for(auto * plane : {&guideLow, &meanI, &meanP, &meanIP, &meanII, &scratch}) {
+				plane->resize(count);
+			}
+
+			// guide at the model output size
+			parallel(lowHeight, [&](int begin, int end) {
+				downsample(guide, lowWidth, lowHeight, begin, end);
+			});
+
+			// local statistics, products first
+			parallel(lowHeight, [&](int begin, int end) {
+				for(std::size_t i = (std::size_t)begin * lowWidth * 3; i < (std::size_t)end * lowWidth * 3; i++) {
+					meanIP[i] = guideLow[i] * low[i];
+					meanII[i] = guideLow[i] * guideLow[i];
+				}
+			});
+			boxFilter(guideLow.data(), meanI.data(), lowWidth, lowHeight);
+			boxFilter(low, meanP.data(), lowWidth, lowHeight);
+			boxFilter(meanIP.data(), meanIP.data(), lowWidth, lowHeight);
+			boxFilter(meanII.data(), meanII.data(), lowWidth, lowHeight);
+
+			// linear coefficients: a in meanI, b in meanP
+			parallel(lowHeight, [&](int begin, int end) {
+				for(std::size_t i = (std::size_t)begin * lowWidth * 3; i < (std::size_t)end * lowWidth * 3; i++) {
+					float variance = meanII[i] - meanI[i] * meanI[i];
+					float covariance = meanIP[i] - meanI[i] * meanP[i];
+					float a = covariance / (variance + epsilon);
+					meanP[i] = meanP[i] - a * meanI[i];
+					meanI[i] = a;
+				}
+			});
+			boxFilter(meanI.data(), meanI.data(), lowWidth, lowHeight);
+			boxFilter(meanP.data(), meanP.data(), lowWidth, lowHeight);
+
+			// bilinear sample positions, pixel centers aligned
+			columns.resize(width);
+			for(int x = 0; x < width; x++) {
+				columns[x] = samplePosition(x, width, lowWidth);
+			}
+
+			// q = a * I + b at full resolution
+			parallel(height, [&](int begin, int end) {
+				std::vector<float> rowA(lowWidth * 3), rowB(lowWidth * 3);
+				std::vector<float> a(width * 3), b(width * 3), guideRow(width * 3);
+				for(int y = begin; y < end; y++) {
+					Sample row = samplePosition(y, height, lowHeight);
+					lerpRows(meanI.data(), row, lowWidth, rowA.data());
+					lerpRows(meanP.data(), row, lowWidth, rowB.data());
+					for(int x = 0; x < width; x++) {
+						const Sample & column = columns[x];
+						for(int c = 0; c < 3; c++) {
+							float a0 = rowA[column.index0 * 3 + c], a1 = rowA[column.index1 * 3 + c];
+							float b0 = rowB[column.index0 * 3 + c], b1 = rowB[column.index1 * 3 + c];
+							a[x * 3 + c] = a0 + (a1 - a0) * column.weight;
+							b[x * 3 + c] = b0 + (b1 - b0) * column.weight;
+						}
+					}
+					PixelKernels::toFloat(guide.row(y), guideRow.data(), width, guide.layout);
+					PixelKernels::affineToUnsignedChar(a.data(), guideRow.data(), b.data(),
+					                                   pixels.getData() + (std::size_t)y * width * 3, width * 3);
+				}
+			});
+			return true;
+		}
+
+		static constexpr int MAX_RADIUS = 8; ///< window radius limit
+		static const int DEFAULT_THREADS = 4; ///< leaves cores for inference
+
+	protected:
+
+		/// bilinear source indices & weight for one destination coordinate
+		struct Sample {
+			int index0 = 0;
+			int index1 = 0;
+			float weight = 0; ///< of index1
+		};
+
+		static Sample samplePosition(int i, int size, int lowSize) {
+			Sample sample;
+			float position = std::max((i + 0.5f) * lowSize / size - 0.5f, 0.f);
+			sample.index0 = std::min((int)position, lowSize - 1);
+			sample.index1 = std::min(sample.index0 + 1, lowSize - 1);
+			sample.weight = position - sample.index0;
+			return sample;
+		}
+
+		/// vertical interpolation of two low resolution rows
+		static void lerpRows(const float * plane, const Sample & row, int lowWidth, float * dst) {
+			const float * row0 = plane + (std::size_t)row.index0 * lowWidth * 3;
+			const float * row1 = plane + (std::size_t)row.index1 * lowWidth * 3;
+			for(int i = 0; i < lowWidth * 3; i++) {
+				dst[i] = row0[i] + (row1[i] - row0[i]) * row.weight;
+			}
+		}
+
+		/// area average guide rows into guideLow rows begin - end
+		void downsample(const PixelSpan & guide, int lowWidth, int lowHeight, int begin, int end) {
+			std::vector<float> line(guide.width * 3);
+			std::vector<float> sums(lowWidth * 3);
+			for(int ly = begin; ly < end; ly++) {
+				int y0 = ly * guide.height / lowHeight;
+				int y1 = std::max((ly + 1) * guide.height / lowHeight, y0 + 1);
+				std::fill(sums.begin(), sums.end(), 0.f);
+				for(int y = y0; y < y1; y++) {
+					PixelKernels::toFloat(guide.row(y), line.data(), guide.width, guide.layout);
+					for(int lx = 0; lx < lowWidth; lx++) {
+						int x0 = lx * guide.width / lowWidth;
+						int x1 = std::max((lx + 1) * guide.width / lowWidth, x0 + 1);
+						for(int x = x0; x < x1; x++) {
+							sums[lx * 3 + 0] += line[x * 3 + 0];
+							sums[lx * 3 + 1] += line[x * 3 + 1];
+							sums[lx * 3 + 2] += line[x * 3 + 2];
+						}
+					}
+				}
+				float * dst = guideLow.data() + (std::size_t)ly * lowWidth * 3;
+				for(int lx = 0; lx < lowWidth; lx++) {
+					int x0 = lx * guide.width / lowWidth;
+					int x1 = std::max((lx + 1) * guide.width / lowWidth, x0 + 1);
+					float scale = 1.f / ((x1 - x0) * (y1 - y0));
+					dst[lx * 3 + 0] = sums[lx * 3 + 0] * scale;
+					dst[lx * 3 + 1] = sums[lx * 3 + 1] * scale;
+					dst[lx * 3 + 2] = sums[lx * 3 + 2] * scale;
+				}
+			}
+		}
+
+		/// mean over the window, windows are cut at the borders, src may be dst
+		void boxFilter(const float * src, float * dst, int lowWidth, int lowHeight) {
+			const int stride = lowWidth * 3;
+			// vertical sums into scratch
+			parallel(lowHeight, [&](int begin, int end) {
+				for(int y = begin; y < end; y++) {
+					int y0 = std::max(y - radius, 0), y1 = std::min(y + radius, lowHeight - 1);
+					float * out = scratch.data() + (std::size_t)y * stride;
+					std::copy(src + (std::size_t)y0 * stride, src + (std::size_t)(y0 + 1) * stride, out);
+					for(int yy = y0 + 1; yy <= y1; yy++) {
+						const float * in = src + (std::size_t)yy * stride;
+						for(int i = 0; i < stride; i++) {
+							out[i] += in[i];
+						}
+					}
+				}
+			});
+			// horizontal running sums & normalization into dst
+			parallel(lowHeight, [&](int begin, int end) {
+				for(int y = begin; y < end; y++) {
+					int rows = std::min(y + radius, lowHeight - 1) - std::max(y - radius, 0) + 1;
+					const float * in = scratch.data() + (std::size_t)y * stride;
+					float * out = dst + (std::size_t)y * stride;
+					float sum[3] = {0, 0, 0};
+					for(int x = 0; x < std::min(radius, lowWidth); x++) {
+						for(int c = 0; c < 3; c++) {
+							sum[c] += in[x * 3 + c];
+						}
+					}
+					for(int x = 0; x < lowWidth; x++) {
+						if(x + radius < lowWidth) {
+							for(int c = 0; c < 3; c++) {
+								sum[c] += in[(x + radius) * 3 + c];
+							}
+						}
+						if(x - radius - 1 >= 0) {
+							for(int c = 0; c < 3; c++) {
+								sum[c] -= in[(x - radius - 1) * 3 + c];
+							}
+						}
+						int columns = std::min(x + radius, lowWidth - 1) - std::max(x - radius, 0) + 1;
+						float scale = 1.f / (rows * columns);
+						for(int c = 0; c < 3; c++) {
+							out[x * 3 + c] = sum[c] * scale;
+						}
+					}
+				}
+			});
+		}
+
+		// ----- row band thread pool -----
+
+		/// run function over rows 0 - count split into one band per thread,
+		/// the caller runs a band too and returns when all are done
+		void parallel(int count, const std::function<void(int begin, int end)> & function) {
+			int bands = std::min((int)pool.size() + 1, count);
+			if(bands <= 1) {
+				function(0, count);
+				return;
+			}
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				task = &function;
+				taskRows = count;
+				taskBands = bands;
+				nextBand = 0;
+				pending = bands;
+				generation++;
+			}
+			wake.notify_all();
+			runBands();
+			std::unique_lock<std::mutex> lock(mutex);
+			done.wait(lock, [this] {return pending == 0;});
+			task = nullptr;
+		}
+
+		/// claim & run bands of the current task until none are left, bands
+		/// are claimed under the lock so a late worker never sees a stale task
+		void runBands() {
+			std::unique_lock<std::mutex> lock(mutex);
+			while(task && nextBand < taskBands) {
+				const std::function<void(int, int)> & function = *task;
+				int begin = nextBand * taskRows / taskBands;
+				int end = (nextBand + 1) * taskRows / taskBands;
+				nextBand++;
+				lock.unlock();
+				function(begin, end);
+				lock.lock();
+				if(--pending == 0) {
+					done.notify_all();
+				}
+			}
+		}
+
+		void worker() {
+			uint64_t seen = 0;
+			std::unique_lock<std::mutex> lock(mutex);
+			while(true) {
+				wake.wait(lock, [&] {return stopping || generation != seen;});
+				if(stopping) {
+					return;
+				}
+				seen = generation;
+				lock.unlock();
+				runBands();
+				lock.lock();
+			}
+		}
+
+		/// (re)start the pool if the thread count changed
+		void startThreads() {
+			int cores = std::max((int)std::thread::hardware_concurrency(), 1);
+			int threads = (requestedThreads > 0 ? requestedThreads : std::min(cores, (int)DEFAULT_THREADS));
+			if(threads == getThreads()) {
+				return;
+			}
+			stopThreads();
+			stopping = false;
+			for(int i = 1; i < threads; i++) {
+				pool.emplace_back(&GuidedUpsampler::worker, this);
+			}
+		}
+
+		void stopThreads() {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			wake.notify_all();
+			for(auto & thread : pool) {
+				thread.join();
+			}
+			pool.clear();
+		}
+
+		int radius = 2;
+		float epsilon = 0.001f;
+		int requestedThreads = 0; ///< 0 for the default
+
+		// low resolution planes, interleaved RGB
+		std::vector<float> guideLow; ///< area averaged guide
+		std::vector<float> meanI, meanP, meanIP, meanII; ///< window means, then a & b
+		std::vector<float> scratch; ///< box filter vertical sums
+		std::vector<Sample> columns; ///< full resolution x -> low resolution x
+
+		std::vector<std::thread> pool;
+		std::mutex mutex;
+		std::condition_variable wake; ///< new task or stopping
+		std::condition_variable done; ///< all bands finished
+		const std::function<void(int, int)> * task = nullptr;
+		int taskRows = 0;
+		int taskBands = 0;
+		int nextBand = 0; ///< next band to claim
+		int pending = 0; ///< bands not finished yet
+		uint64_t generation = 0; ///< task counter
+		bool stopping = false;
+};
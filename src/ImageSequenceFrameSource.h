@@ -0,0 +1,113 @@
+/*
+ * AI Dance Mirror
+ *
+ * Image sequence frame source.
+ */
+#pragma once
+
+#include "FrameSource.h"
+
+/// \class ImageSequenceFrameSource
+/// \brief plays back a folder of PNG/JPEG frames in file name order
+///
+/// frames are decoded on demand unless preloading is enabled, which moves the
+/// decode cost out of the capture loop for throughput measurements
+class ImageSequenceFrameSource : public FrameSource {
+	public:
+
+		ImageSequenceFrameSource(const std::string & path, bool preload=false) :
+			path(path), preload(preload) {}
+
+		bool open() {
+			ofDirectory dir(path);
+			dir.allowExt("png");
+			dir.allowExt("jpg");
+			dir.allowExt("jpeg");
+			if(!dir.exists() || dir.listDir() == 0) {
+				ofLogError("ImageSequenceFrameSource") << "no png or jpeg frames found in: " << path;
+				return false;
+			}
+			dir.sort();
+			files.clear();
+			for(std::size_t i = 0; i < dir.size(); i++) {
+				files.push_back(dir.getPath(i));
+			}
+
+			// frame size is taken from the first image
+			ofPixels first;
+			if(!load(files[0], first)) {
+				return false;
+			}
+			width = first.getWidth();
+			height = first.getHeight();
+
+			frames.clear();
+			if(preload) {
+				frames.resize(files.size());
+				for(std::size_t i = 0; i < files.size(); i++) {
+					if(!load(files[i], frames[i])) {
+						return false;
+					}
+				}
+			}
+
+			index = 0;
+			finished = false;
+			startPacing();
+			ofLogNotice("ImageSequenceFrameSource") << "opened " << files.size() << " frames "
+				<< width << "x" << height << " from " << path;
+			return true;
+		}
+
+		void close() {
+			files.clear();
+			frames.clear();
+		}
+
+		bool grab(Frame & frame) {
+			if(finished) {
+				return idle();
+			}
+			pacer.wait();
+			std::size_t i = index % files.size();
+			if(preload) {
+				frame.pixels = frames[i];
+			}
+			else if(!load(files[i], frame.pixels)) {
+				return false;
+			}
+			frame.sourceTime = stepTime(index);
+			index++;
+			if(!loop && index >= files.size()) {
+				finished = true;
+			}
+			return true;
+		}
+
+		std::string getName() const {
+			return "images " + path;
+		}
+
+	private:
+
+		/// decode an image as RGB, must match the size of the first frame
+		bool load(const std::string & file, ofPixels & pixels) {
+			if(!ofLoadImage(pixels, file)) {
+				ofLogError("ImageSequenceFrameSource") << "failed to load frame: " << file;
+				return false;
+			}
+			if(pixels.getNumChannels() != 3) {
+				pixels.setImageType(OF_IMAGE_COLOR);
+			}
+			if(width > 0 && (pixels.getWidth() != width || pixels.getHeight() != height)) {
+				pixels.resize(width, height);
+			}
+			return true;
+		}
+
+		std::string path; ///< frame folder
+		bool preload; ///< decode all frames in open()?
+		std::vector<std::string> files; ///< sorted frame paths
+		std::vector<ofPixels> frames; ///< decoded frames when preloading
+		uint64_t index = 0; ///< next frame index
+};
@@ -0,0 +1,265 @@
+/*
+ * AI Dance Mirror
+ *
+ * TensorFlow device selection: GPU if available, CPU fallback.
+ */
+#pragma once
+
+#include "ofxTensorFlow2.h"
+#include "ModelSession.h"
+#include <mutex>
+
+/// \class InferenceDevice
+/// \brief picks the TensorFlow device once per process and configures the
+///        global TF context for it
+///
+/// call configure() before any model is loaded, later calls keep the first
+/// selection; with DEVICE_AUTO the GPU is used if TensorFlow lists one and
+/// its memory options can be set, otherwise inference runs on the CPU
+///
+/// CPU mode hides all GPUs and sizes TensorFlow's process wide thread pools,
+/// which are created with the first context, for the host core count minus
+/// cores left for capture & rendering; with DEVICE_AUTO the GPU probe is that
+/// first context and carries the GPU memory options instead, so a CPU
+/// fallback keeps TF's default pools: use DEVICE_CPU to size them
+///
+/// fp16 enables the mixed precision graph rewrite for the selected device,
+/// ofxTF2 models load with default session options, so fp16 models run in a
+/// ModelSession with getSessionOptions(); int8 selects the quantized model
+/// variant, see ModelSession::Precision
+class InferenceDevice {
+	public:
+
+		/// device choice
+		enum Type {
+			DEVICE_AUTO, ///< GPU if available, otherwise CPU
+			DEVICE_GPU, ///< GPU, falls back to CPU if there is none
+			DEVICE_CPU ///< CPU only
+		};
+
+		/// parse device name: "auto", "gpu", or "cpu",
+		/// returns DEVICE_AUTO for unknown names
+		static Type typeFromString(const std::string & name) {
+			if(name == "gpu") {
+				return DEVICE_GPU;
+			}
+			if(name == "cpu") {
+				return DEVICE_CPU;
+			}
+			return DEVICE_AUTO;
+		}
+
+		/// device type name
+		static const char * getName(Type type) {
+			switch(type) {
+				case DEVICE_GPU: return "GPU";
+				case DEVICE_CPU: return "CPU";
+				default: return "auto";
+			}
+		}
+
+		/// select & configure the device, threads sets the CPU thread pool
+		/// size (0: cores - RESERVED_CORES), returns the selected device:
+		/// DEVICE_GPU or DEVICE_CPU
+		static Type configure(Type requested=DEVICE_AUTO, int threads=0,
+		                      ModelSession::Precision precision=ModelSession::PRECISION_FP32) {
+			State & s = state();
+			std::lock_guard<std::mutex> lock(s.mutex);
+			if(s.configured) {
+				return s.type;
+			}
+			s.configured = true;
+			s.precision = precision;
+
+			if(requested != DEVICE_CPU) {
+				// the probe context is the first one & creates the GPU
+				// allocator, so it has the memory options of the GPU path
+				std::vector<std::string> gpus = listGPUs();
+				if(gpus.empty()) {
+					ofLogWarning("InferenceDevice") << "no GPU found, falling back to CPU inference";
+				}
+				else if(!ofxTF2::setGPUMaxMemory(ofxTF2::GPU_PERCENT_90, true)) {
+					ofLogWarning("InferenceDevice") << "failed to set GPU memory options, "
+					                                << "falling back to CPU inference";
+				}
+				else {
+					s.type = DEVICE_GPU;
+					s.name = gpus.front().substr(std::min(gpus.front().find("GPU"), gpus.front().size()));
+					if(precision == ModelSession::PRECISION_FP16) {
+						// same memory options as above plus the rewrite
+						if(!setContextConfig(getSessionOptions(s, precision).toConfigProto())) {
+							ofLogWarning("InferenceDevice") << "failed to enable mixed precision, using fp32";
+							s.precision = ModelSession::PRECISION_FP32;
+						}
+					}
+					ofLogNotice("InferenceDevice") << "using " << getDescription(s)
+					                               << " of " << gpus.size() << " GPU(s)";
+					return s.type;
+				}
+			}
+			else {
+				// hide GPUs before TensorFlow initializes CUDA
+				setenv("CUDA_VISIBLE_DEVICES", "", 1);
+			}
+
+			s.type = DEVICE_CPU;
+			if(requested != DEVICE_CPU) {
+				// the probe already created the thread pools
+				ofLogNotice("InferenceDevice") << "CPU fallback with TF default threads, "
+				                               << "select the CPU device to size them";
+				setContextConfig(getSessionOptions(s, precision).toConfigProto());
+				ofLogNotice("InferenceDevice") << "using " << getDescription(s);
+				return s.type;
+			}
+			int cores = std::max((int)std::thread::hardware_concurrency(), 1);
+			s.threads = (threads > 0 ? threads : std::max(cores - RESERVED_CORES, 1));
+			if(!setContextConfig(getSessionOptions(s, precision).toConfigProto())) {
+				ofLogWarning("InferenceDevice") << "failed to set CPU thread options, using TF defaults";
+				s.threads = 0;
+			}
+			ofLogNotice("InferenceDevice") << "using " << getDescription(s);
+			return s.type;
+		}
+
+		/// has configure() been called?
+		static bool isConfigured() {
+			State & s = state();
+			std::lock_guard<std::mutex> lock(s.mutex);
+			return s.configured;
+		}
+
+		/// selected device, DEVICE_AUTO before configure()
+		static Type getType() {
+			State & s = state();
+			std::lock_guard<std::mutex> lock(s.mutex);
+			return s.configured ? s.type : DEVICE_AUTO;
+		}
+
+		/// precision set by configure()
+		static ModelSession::Precision getPrecision() {
+			State & s = state();
+			std::lock_guard<std::mutex> lock(s.mutex);
+			return s.precision;
+		}
+
+		/// options for sessions running the live model at a precision: the
+		/// selected device, its memory options or the shared CPU thread pools
+		static ModelSession::Options getSessionOptions(ModelSession::Precision precision) {
+			State & s = state();
+			std::lock_guard<std::mutex> lock(s.mutex);
+			return getSessionOptions(s, precision);
+		}
+
+		/// CPU intra-op threads, 0 for the GPU or TF defaults
+		static int getThreads() {
+			State & s = state();
+			std::lock_guard<std::mutex> lock(s.mutex);
+			return s.threads;
+		}
+
+		/// short description, ie. "GPU:0" or "CPU, 6 threads"
+		static std::string getDescription() {
+			State & s = state();
+			std::lock_guard<std::mutex> lock(s.mutex);
+			return getDescription(s);
+		}
+
+		/// TF device names of all GPUs visible to TensorFlow, probes with the
+		/// GPU memory options used by configure(), memory growth enabled so no
+		/// GPU memory is reserved; thread pools keep the TF defaults
+		static std::vector<std::string> listGPUs() {
+			std::vector<std::string> gpus;
+			TF_Status * status = TF_NewStatus();
+			TFE_ContextOptions * options = TFE_NewContextOptions();
+			ModelSession::Options probe;
+			probe.perSessionThreads = false;
+			probe.gpuMemoryFraction = GPU_MEMORY_FRACTION;
+			probe.gpuMemoryGrowth = true;
+			std::vector<uint8_t> config = probe.toConfigProto();
+			TFE_ContextOptionsSetConfig(options, config.data(), config.size(), status);
+			TFE_Context * context = nullptr;
+			if(TF_GetCode(status) == TF_OK) {
+				context = TFE_NewContext(options, status);
+			}
+			TFE_DeleteContextOptions(options);
+			if(context && TF_GetCode(status) == TF_OK) {
+				TF_DeviceList * devices = TFE_ContextListDevices(context, status);
+				if(TF_GetCode(status) == TF_OK) {
+					for(int i = 0; i < TF_DeviceListCount(devices); i++) {
+						if(std::string(TF_DeviceListType(devices, i, status)) == "GPU") {
+							gpus.push_back(TF_DeviceListName(devices, i, status));
+						}
+					}
+					TF_DeleteDeviceList(devices);
+				}
+			}
+			if(context) {
+				TFE_DeleteContext(context);
+			}
+			TF_DeleteStatus(status);
+			return gpus;
+		}
+
+		static const int RESERVED_CORES = 2; ///< left for capture & rendering
+		static const int INTER_OP_THREADS = 2; ///< the style networks are mostly sequential
+		static constexpr double GPU_MEMORY_FRACTION = 0.9; ///< like ofxTF2::GPU_PERCENT_90
+
+	protected:
+
+		struct State {
+			std::mutex mutex;
+			bool configured = false;
+			Type type = DEVICE_CPU;
+			int threads = 0;
+			ModelSession::Precision precision = ModelSession::PRECISION_FP32;
+			std::string name; ///< GPU device name
+		};
+
+		static State & state() {
+			static State s;
+			return s;
+		}
+
+		static ModelSession::Options getSessionOptions(const State & s, ModelSession::Precision precision) {
+			ModelSession::Options options;
+			options.perSessionThreads = false;
+			options.precision = precision;
+			if(s.type == DEVICE_GPU) {
+				options.gpuMemoryFraction = GPU_MEMORY_FRACTION;
+				options.gpuMemoryGrowth = true;
+			}
+			else {
+				options.allowGPU = false;
+				options.intraOpThreads = s.threads;
+				options.interOpThreads = (s.threads > 0 ? INTER_OP_THREADS : 0);
+			}
+			return options;
+		}
+
+		static std::string getDescription(const State & s) {
+			if(!s.configured) {
+				return "not configured";
+			}
+			std::string precision = (s.precision != ModelSession::PRECISION_FP32 ?
+			                         std::string(", ") + ModelSession::getName(s.precision) : "");
+			if(s.type == DEVICE_GPU) {
+				return s.name + precision;
+			}
+			return "CPU" + (s.threads > 0 ? ", " + ofToString(s.threads) + " threads" : std::string()) + precision;
+		}
+
+		/// replace the global cppflow context with one using a serialized
+		/// tensorflow.ConfigProto, like ofxTF2::setGPUMaxMemory()
+		static bool setContextConfig(const std::vector<uint8_t> & config) {
+			TF_Status * status = TF_NewStatus();
+			TFE_ContextOptions * options = TFE_NewContextOptions();
+			TFE_ContextOptionsSetConfig(options, config.data(), config.size(), status);
+			bool ok = (TF_GetCode(status) == TF_OK);
+			if(ok) {
+				cppflow::get_global_context() = cppflow::context(options);
+			}
+			TFE_DeleteContextOptions(options);
+			TF_DeleteStatus(status);
+			return ok;
+		}
+};
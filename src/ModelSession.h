@@ -0,0 +1,292 @@
+/*
+ * AI Dance Mirror
+ *
+ * SavedModel session with its own thread pool configuration.
+ */
+#pragma once
+
+#include "ofxTensorFlow2.h"
+#include <cstring>
+#ifdef __linux__
+	#include <pthread.h>
+	#include <sched.h>
+#endif
+
+/// \class ModelSession
+/// \brief a SavedModel loaded into its own TF session via the TF C API
+///
+/// ofxTF2::Model sessions share TensorFlow's process wide thread pools, a
+/// ModelSession has its own intra-op & inter-op pools sized by Options, so
+/// several sessions can run side by side without oversubscribing the CPU
+///
+/// TF creates the session thread pools when the model is loaded and new
+/// threads inherit the creating thread's CPU affinity, so load() from a
+/// thread pinned with pinThread() keeps the whole session on those cores
+class ModelSession {
+	public:
+
+		/// numeric precision inside the model, inputs & outputs stay float32
+		enum Precision {
+			PRECISION_FP32, ///< as saved
+			PRECISION_FP16, ///< mixed precision rewrite: float16 on the GPU,
+			                ///< bfloat16 through oneDNN on the CPU
+			PRECISION_INT8  ///< quantized variant of the model, see precisionPath()
+		};
+
+		/// parse precision name: "fp32", "fp16", or "int8",
+		/// returns false for unknown names
+		static bool precisionFromString(const std::string & name, Precision & precision) {
+			if(name == "fp32") {
+				precision = PRECISION_FP32;
+			}
+			else if(name == "fp16") {
+				precision = PRECISION_FP16;
+			}
+			else if(name == "int8") {
+				precision = PRECISION_INT8;
+			}
+			else {
+				return false;
+			}
+			return true;
+		}
+
+		/// precision name
+		static const char * getName(Precision precision) {
+			switch(precision) {
+				case PRECISION_FP16: return "fp16";
+				case PRECISION_INT8: return "int8";
+				default: return "fp32";
+			}
+		}
+
+		/// model folder for a precision: the quantized variant written by
+		/// quantize_model.sh next to the model, ie. "models/my_model.int8",
+		/// for int8, otherwise the model folder itself
+		static std::string precisionPath(const std::string & modelPath, Precision precision) {
+			if(precision != PRECISION_INT8) {
+				return modelPath;
+			}
+			std::string path = modelPath;
+			while(!path.empty() && (path.back() == '/' || path.back() == '\\')) {
+				path.pop_back();
+			}
+			return path + ".int8";
+		}
+
+		/// session thread settings, 0 leaves the TF default
+		struct Options {
+			int intraOpThreads = 0; ///< threads used within a single op
+			int interOpThreads = 0; ///< ops run in parallel
+			bool perSessionThreads = true; ///< own pools instead of the global ones
+			bool allowGPU = true; ///< false hides GPUs from the session
+			Precision precision = PRECISION_FP32; ///< fp16 enables the mixed precision rewrite
+			double gpuMemoryFraction = 0; ///< GPU memory reserved up front, 0 for the TF default
+			bool gpuMemoryGrowth = false; ///< allocate GPU memory as needed
+
+			/// serialized tensorflow.ConfigProto for TF_SetConfig
+			std::vector<uint8_t> toConfigProto() const {
+				std::vector<uint8_t> proto;
+				if(!allowGPU) {
+					// device_count {key: "GPU" value: 0}
+					proto.insert(proto.end(), {0x0A, 0x07, 0x0A, 0x03, 'G', 'P', 'U', 0x10, 0x00});
+				}
+				if(intraOpThreads > 0) {
+					proto.push_back(0x10); // intra_op_parallelism_threads
+					appendVarint(proto, intraOpThreads);
+				}
+				if(interOpThreads > 0) {
+					proto.push_back(0x28); // inter_op_parallelism_threads
+					appendVarint(proto, interOpThreads);
+				}
+				proto.push_back(0x38); // allow_soft_placement
+				proto.push_back(0x01);
+				if(perSessionThreads) {
+					proto.push_back(0x48); // use_per_session_threads
+					proto.push_back(0x01);
+				}
+				if(gpuMemoryFraction > 0 || gpuMemoryGrowth) {
+					// gpu_options {per_process_gpu_memory_fraction, allow_growth}
+					std::vector<uint8_t> gpu;
+					if(gpuMemoryFraction > 0) {
+						gpu.push_back(0x09);
+						uint64_t bits;
+						std::memcpy(&bits, &gpuMemoryFraction, sizeof(bits));
+						for(int i = 0; i < 8; i++) {
+							gpu.push_back((uint8_t)(bits >> (i * 8)));
+						}
+					}
+					if(gpuMemoryGrowth) {
+						gpu.insert(gpu.end(), {0x20, 0x01});
+					}
+					proto.push_back(0x32);
+					appendVarint(proto, gpu.size());
+					proto.insert(proto.end(), gpu.begin(), gpu.end());
+				}
+				if(precision == PRECISION_FP16) {
+					// graph_options {rewrite_options {auto_mixed_precision: ON}}
+					// (field 23) on the GPU, auto_mixed_precision_onednn_bfloat16
+					// (field 31) on the CPU: the CPU's 16 bit float, native with
+					// AVX512-BF16 or AMX, emulated & slower elsewhere
+					proto.insert(proto.end(), {0x52, 0x05, 0x52, 0x03,
+					                           (uint8_t)(allowGPU ? 0xB8 : 0xF8), 0x01, 0x01});
+				}
+				return proto;
+			}
+		};
+
+		ModelSession() {}
+		ModelSession(const ModelSession &) = delete;
+		ModelSession & operator=(const ModelSession &) = delete;
+
+		~ModelSession() {
+			clear();
+		}
+
+		/// load SavedModel with default options
+		bool load(const std::string & path, const std::vector<std::string> & inputNames,
+		          const std::string & outputName) {
+			return load(path, inputNames, outputName, Options());
+		}
+
+		/// load SavedModel and look up input & output tensors by name, names
+		/// are "operation" or "operation:index" as given to ofxTF2::Model::setup(),
+		/// returns true on success
+		bool load(const std::string & path, const std::vector<std::string> & inputNames,
+		          const std::string & outputName, const Options & options) {
+			clear();
+			TF_Status * status = TF_NewStatus();
+			TF_SessionOptions * sessionOptions = TF_NewSessionOptions();
+			std::vector<uint8_t> config = options.toConfigProto();
+			TF_SetConfig(sessionOptions, config.data(), config.size(), status);
+			if(TF_GetCode(status) != TF_OK) {
+				ofLogError("ModelSession") << "invalid session options: " << TF_Message(status);
+				TF_DeleteSessionOptions(sessionOptions);
+				TF_DeleteStatus(status);
+				return false;
+			}
+			const char * tags[] = {"serve"};
+			graph = TF_NewGraph();
+			session = TF_LoadSessionFromSavedModel(sessionOptions, nullptr,
+			                                       ofToDataPath(path, true).c_str(),
+			                                       tags, 1, graph, nullptr, status);
+			TF_DeleteSessionOptions(sessionOptions);
+			bool loaded = (TF_GetCode(status) == TF_OK);
+			if(!loaded) {
+				ofLogError("ModelSession") << "failed to load " << path << ": " << TF_Message(status);
+				session = nullptr;
+			}
+			TF_DeleteStatus(status);
+			if(!loaded) {
+				clear();
+				return false;
+			}
+
+			inputs.clear();
+			for(auto & name : inputNames) {
+				TF_Output input;
+				if(!findOutput(name, input)) {
+					clear();
+					return false;
+				}
+				inputs.push_back(input);
+			}
+			if(!findOutput(outputName, output)) {
+				clear();
+				return false;
+			}
+			return true;
+		}
+
+		/// close session
+		void clear() {
+			if(session) {
+				TF_Status * status = TF_NewStatus();
+				TF_CloseSession(session, status);
+				TF_DeleteSession(session, status);
+				TF_DeleteStatus(status);
+				session = nullptr;
+			}
+			if(graph) {
+				TF_DeleteGraph(graph);
+				graph = nullptr;
+			}
+			inputs.clear();
+		}
+
+		bool isLoaded() const {return session != nullptr;}
+
+		/// run the model, blocks until finished, throws std::runtime_error
+		/// on failure like cppflow
+		cppflow::tensor run(const std::vector<cppflow::tensor> & values) {
+			if(!session || values.size() != inputs.size()) {
+				throw std::runtime_error("ModelSession not loaded or wrong number of inputs");
+			}
+			std::vector<std::shared_ptr<TF_Tensor>> held; // resolved input buffers
+			std::vector<TF_Tensor *> tensors;
+			for(auto & value : values) {
+				held.push_back(value.get_tensor());
+				tensors.push_back(held.back().get());
+			}
+			TF_Tensor * result = nullptr;
+			TF_Status * status = TF_NewStatus();
+			TF_SessionRun(session, nullptr,
+			              inputs.data(), tensors.data(), (int)inputs.size(),
+			              &output, &result, 1,
+			              nullptr, 0, nullptr, status);
+			if(TF_GetCode(status) != TF_OK) {
+				std::string message = TF_Message(status);
+				TF_DeleteStatus(status);
+				throw std::runtime_error(message);
+			}
+			TF_DeleteStatus(status);
+			return cppflow::tensor(result);
+		}
+
+		/// restrict the calling thread to the given CPU cores,
+		/// returns false if not supported or failed
+		static bool pinThread(const std::vector<int> & cores) {
+		#ifdef __linux__
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			for(int core : cores) {
+				CPU_SET(core, &set);
+			}
+			return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+		#else
+			return false;
+		#endif
+		}
+
+	protected:
+
+		/// look up "operation" or "operation:index" in the graph
+		bool findOutput(const std::string & name, TF_Output & out) {
+			std::string op = name;
+			out.index = 0;
+			std::size_t colon = name.rfind(':');
+			if(colon != std::string::npos) {
+				op = name.substr(0, colon);
+				out.index = ofToInt(name.substr(colon + 1));
+			}
+			out.oper = TF_GraphOperationByName(graph, op.c_str());
+			if(!out.oper) {
+				ofLogError("ModelSession") << "no operation named " << op;
+				return false;
+			}
+			return true;
+		}
+
+		static void appendVarint(std::vector<uint8_t> & proto, uint64_t value) {
+			while(value >= 0x80) {
+				proto.push_back((uint8_t)(value | 0x80));
+				value >>= 7;
+			}
+			proto.push_back((uint8_t)value);
+		}
+
+		TF_Graph * graph = nullptr;
+		TF_Session * session = nullptr;
+		std::vector<TF_Output> inputs;
+		TF_Output output;
+};
@@ -0,0 +1,394 @@
+/*
+ * AI Dance Mirror
+ *
+ * SavedModel signature introspection & cached model bindings.
+ */
+#pragma once
+
+#include "ofMain.h"
+#include <fstream>
+
+/// \class ModelSignature
+/// \brief reads a SavedModel's signature straight from saved_model.pb
+///
+/// the SavedModel protobuf is parsed with a minimal wire format reader, no
+/// TF session or graph is created: only the meta graph tags and the signature
+/// map are decoded, the graph itself is skipped
+///
+/// tensor names are as given by the signature, ie.
+/// "serving_default_placeholder:0"
+class ModelSignature {
+	public:
+
+		/// signature input or output
+		struct Tensor {
+			std::string key; ///< signature key, ie. "placeholder"
+			std::string name; ///< graph tensor name, ie. "serving_default_placeholder:0"
+			int dtype = 0; ///< TF_DataType
+			std::vector<int64_t> shape; ///< -1 for unknown dimensions
+		};
+
+		/// read a signature of the meta graph tagged "serve" from a SavedModel
+		/// folder, returns true on success
+		bool read(const std::string & modelPath, const std::string & signature="serving_default") {
+			inputs.clear();
+			outputs.clear();
+			modelFingerprint.clear();
+			std::string data;
+			if(!readFile(ofFilePath::join(ofToDataPath(modelPath, true), "saved_model.pb"), data)) {
+				ofLogError("ModelSignature") << "no saved_model.pb in " << modelPath;
+				return false;
+			}
+			modelFingerprint = fingerprint(modelPath, data);
+
+			// SavedModel: meta_graphs = 2
+			ProtoReader saved(data);
+			uint32_t field, wire;
+			while(saved.next(field, wire)) {
+				if(field == 2 && wire == WIRE_BYTES) {
+					ProtoReader metaGraph;
+					if(!saved.message(metaGraph)) {
+						break;
+					}
+					if(readMetaGraph(metaGraph, signature)) {
+						return true;
+					}
+				}
+				else if(!saved.skip(wire)) {
+					break;
+				}
+			}
+			ofLogError("ModelSignature") << "no \"" << signature << "\" signature in " << modelPath;
+			return false;
+		}
+
+		const std::vector<Tensor> & getInputs() const {return inputs;}
+		const std::vector<Tensor> & getOutputs() const {return outputs;}
+
+		/// fingerprint of the model read()
+		const std::string & getFingerprint() const {return modelFingerprint;}
+
+		/// content fingerprint of a SavedModel: FNV-1a 64 of saved_model.pb
+		/// and the variables index, empty if there is no saved_model.pb
+		static std::string fingerprint(const std::string & modelPath) {
+			std::string data;
+			if(!readFile(ofFilePath::join(ofToDataPath(modelPath, true), "saved_model.pb"), data)) {
+				return "";
+			}
+			return fingerprint(modelPath, data);
+		}
+
+		/// graph tensor name as used by ofxTF2::Model::setup(): the operation
+		/// name, with ":index" only if the index is not 0
+		static std::string operationName(const std::string & tensorName) {
+			std::size_t colon = tensorName.rfind(':');
+			if(colon != std::string::npos && tensorName.substr(colon + 1) == "0") {
+				return tensorName.substr(0, colon);
+			}
+			return tensorName;
+		}
+
+	protected:
+
+		static const uint32_t WIRE_VARINT = 0;
+		static const uint32_t WIRE_BYTES = 2;
+
+		/// minimal protobuf wire format reader over a byte range
+		struct ProtoReader {
+			const uint8_t * pos = nullptr;
+			const uint8_t * end = nullptr;
+
+			ProtoReader() {}
+			ProtoReader(const std::string & data) :
+				pos((const uint8_t *)data.data()), end((const uint8_t *)data.data() + data.size()) {}
+
+			/// next field key, returns false at the end
+			bool next(uint32_t & field, uint32_t & wire) {
+				uint64_t key;
+				if(pos >= end || !varint(key)) {
+					return false;
+				}
+				field = (uint32_t)(key >> 3);
+				wire = (uint32_t)(key & 7);
+				return true;
+			}
+
+			bool varint(uint64_t & value) {
+				value = 0;
+				for(int shift = 0; shift < 64 && pos < end; shift += 7) {
+					uint8_t byte = *pos++;
+					value |= (uint64_t)(byte & 0x7F) << shift;
+					if(!(byte & 0x80)) {
+						return true;
+					}
+				}
+				return false;
+			}
+
+			/// length delimited field as a nested reader
+			bool message(ProtoReader & nested) {
+				uint64_t length;
+				if(!varint(length) || length > (uint64_t)(end - pos)) {
+					return false;
+				}
+				nested.pos = pos;
+				nested.end = pos + length;
+				pos += length;
+				return true;
+			}
+
+			bool text(std::string & value) {
+				ProtoReader nested;
+				if(!message(nested)) {
+					return false;
+				}
+				value.assign((const char *)nested.pos, nested.end - nested.pos);
+				return true;
+			}
+
+			/// skip a field's value
+			bool skip(uint32_t wire) {
+				uint64_t value;
+				ProtoReader nested;
+				switch(wire) {
+					case 0: return varint(value);
+					case 1: return advance(8);
+					case 2: return message(nested);
+					case 5: return advance(4);
+					default: return false; // groups are not used by SavedModel
+				}
+			}
+
+			bool advance(std::size_t n) {
+				if(n > (std::size_t)(end - pos)) {
+					return false;
+				}
+				pos += n;
+				return true;
+			}
+		};
+
+		/// MetaGraphDef: meta_info_def = 1 (tags = 4), signature_def = 5
+		bool readMetaGraph(ProtoReader reader, const std::string & signature) {
+			bool serve = false;
+			ProtoReader signatureDef;
+			bool found = false;
+			uint32_t field, wire;
+			while(reader.next(field, wire)) {
+				if(field == 1 && wire == WIRE_BYTES) {
+					ProtoReader info;
+					if(!reader.message(info)) {
+						return false;
+					}
+					while(info.next(field, wire)) {
+						std::string tag;
+						if(field == 4 && wire == WIRE_BYTES) {
+							if(!info.text(tag)) {
+								return false;
+							}
+							serve |= (tag == "serve");
+						}
+						else if(!info.skip(wire)) {
+							return false;
+						}
+					}
+				}
+				else if(field == 5 && wire == WIRE_BYTES) {
+					ProtoReader entry;
+					std::string key;
+					ProtoReader value;
+					if(!reader.message(entry) || !readMapEntry(entry, key, value)) {
+						return false;
+					}
+					if(key == signature) {
+						signatureDef = value;
+						found = true;
+					}
+				}
+				else if(!reader.skip(wire)) {
+					return false;
+				}
+			}
+			if(!serve || !found) {
+				return false;
+			}
+
+			// SignatureDef: inputs = 1, outputs = 2
+			inputs.clear();
+			outputs.clear();
+			while(signatureDef.next(field, wire)) {
+				if((field == 1 || field == 2) && wire == WIRE_BYTES) {
+					ProtoReader entry;
+					ProtoReader value;
+					Tensor tensor;
+					if(!signatureDef.message(entry) || !readMapEntry(entry, tensor.key, value) ||
+					   !readTensorInfo(value, tensor)) {
+						return false;
+					}
+					(field == 1 ? inputs : outputs).push_back(tensor);
+				}
+				else if(!signatureDef.skip(wire)) {
+					return false;
+				}
+			}
+			// map order is not defined, sort by key for stable bindings
+			auto byKey = [](const Tensor & a, const Tensor & b) {return a.key < b.key;};
+			std::sort(inputs.begin(), inputs.end(), byKey);
+			std::sort(outputs.begin(), outputs.end(), byKey);
+			return !inputs.empty() && !outputs.empty();
+		}
+
+		/// map<string, message> entry: key = 1, value = 2
+		static bool readMapEntry(ProtoReader entry, std::string & key, ProtoReader & value) {
+			uint32_t field, wire;
+			while(entry.next(field, wire)) {
+				if(field == 1 && wire == WIRE_BYTES) {
+					if(!entry.text(key)) {
+						return false;
+					}
+				}
+				else if(field == 2 && wire == WIRE_BYTES) {
+					if(!entry.message(value)) {
+						return false;
+					}
+				}
+				else if(!entry.skip(wire)) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		/// TensorInfo: name = 1, dtype = 2, tensor_shape = 3 (dim = 2 (size = 1))
+		static bool readTensorInfo(ProtoReader info, Tensor & tensor) {
+			uint32_t field, wire;
+			while(info.next(field, wire)) {
+				uint64_t value;
+				if(field == 1 && wire == WIRE_BYTES) {
+					if(!info.text(tensor.name)) {
+						return false;
+					}
+				}
+				else if(field == 2 && wire == WIRE_VARINT) {
+					if(!info.varint(value)) {
+						return false;
+					}
+					tensor.dtype = (int)value;
+				}
+				else if(field == 3 && wire == WIRE_BYTES) {
+					ProtoReader shape;
+					if(!info.message(shape)) {
+						return false;
+					}
+					while(shape.next(field, wire)) {
+						ProtoReader dim;
+						if(field == 2 && wire == WIRE_BYTES) {
+							if(!shape.message(dim)) {
+								return false;
+							}
+							int64_t size = -1;
+							while(dim.next(field, wire)) {
+								if(field == 1 && wire == WIRE_VARINT) {
+									if(!dim.varint(value)) {
+										return false;
+									}
+									size = (int64_t)value;
+								}
+								else if(!dim.skip(wire)) {
+									return false;
+								}
+							}
+							tensor.shape.push_back(size);
+						}
+						else if(!shape.skip(wire)) {
+							return false;
+						}
+					}
+				}
+				else if(!info.skip(wire)) {
+					return false;
+				}
+			}
+			return !tensor.name.empty();
+		}
+
+		static std::string fingerprint(const std::string & modelPath, const std::string & savedModel) {
+			uint64_t hash = 0xcbf29ce484222325ULL;
+			auto add = [&hash](const std::string & data) {
+				for(unsigned char c : data) {
+					hash = (hash ^ c) * 0x100000001b3ULL;
+				}
+			};
+			add(savedModel);
+			std::string index;
+			if(readFile(ofFilePath::join(ofToDataPath(modelPath, true), "variables/variables.index"), index)) {
+				add(index);
+			}
+			std::stringstream hex;
+			hex << std::hex << std::setw(16) << std::setfill('0') << hash;
+			return hex.str();
+		}
+
+		static bool readFile(const std::string & path, std::string & data) {
+			std::ifstream file(path, std::ios::binary);
+			if(!file) {
+				return false;
+			}
+			data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+			return true;
+		}
+
+		std::vector<Tensor> inputs;
+		std::vector<Tensor> outputs;
+		std::string modelFingerprint;
+};
+
+/// \struct ModelBinding
+/// \brief resolved model input & output names, cached as JSON next to the
+///        model folder, ie. "models/my_model.binding.json"
+///
+/// the cache is only used while the model fingerprint matches, so a replaced
+/// model is introspected again
+struct ModelBinding {
+	std::vector<std::string> inputNames; ///< in model input order
+	std::string outputName;
+	std::string fingerprint; ///< ModelSignature::fingerprint() of the model
+
+	/// cache file path for a model folder
+	static std::string getCachePath(const std::string & modelPath) {
+		return ofFilePath::removeTrailingSlash(modelPath) + ".binding.json";
+	}
+
+	/// load a cached binding, returns false if missing or if the fingerprint
+	/// does not match
+	bool load(const std::string & modelPath, const std::string & fingerprint) {
+		std::string path = getCachePath(modelPath);
+		if(fingerprint.empty() || !ofFile::doesFileExist(path)) {
+			return false;
+		}
+		ofJson json = ofLoadJson(path);
+		if(json.value("version", 0) != VERSION || json.value("fingerprint", std::string()) != fingerprint ||
+		   !json.contains("inputs") || !json["inputs"].is_array()) {
+			return false;
+		}
+		inputNames.clear();
+		for(auto & name : json["inputs"]) {
+			inputNames.push_back(name.get<std::string>());
+		}
+		outputName = json.value("output", std::string());
+		this->fingerprint = fingerprint;
+		return !inputNames.empty() && !outputName.empty();
+	}
+
+	/// write the cache file, returns false if the folder is not writable
+	bool save(const std::string & modelPath) const {
+		ofJson json;
+		json["version"] = VERSION;
+		json["fingerprint"] = fingerprint;
+		json["inputs"] = inputNames;
+		json["output"] = outputName;
+		return ofSavePrettyJson(getCachePath(modelPath), json);
+	}
+
+	static const int VERSION = 1;
+};
@@ -0,0 +1,183 @@
+/*
+ * AI Dance Mirror
+ *
+ * Background model load & warm-up for swapping models while running.
+ */
+#pragma once
+
+#include "ofxStyleTransfer.h"
+#include "Preprocess.h"
+#include <atomic>
+#include <thread>
+
+/// \class ModelSwap
+/// \brief replaces the style transfer model without stopping the output
+///
+/// load() reads the new SavedModel on a background thread and warms it up
+/// with one run on a copy of the current frame & style, so graph setup and
+/// kernel selection are done before the first live frame reaches it; the
+/// live path keeps running on the old model meanwhile
+///
+/// once isReady(), apply() switches over between two frames, see
+/// ofxStyleTransfer::swapNetwork(): frames submitted from then on run on
+/// the new model while the ones in flight finish on the old one, which is
+/// released on the background thread after its last run, so neither the
+/// load nor the release stalls the main thread
+///
+/// all functions are called from the main thread
+class ModelSwap {
+	public:
+
+		enum State {
+			STATE_IDLE,    ///< nothing loading
+			STATE_LOADING, ///< loading & warming up in the background
+			STATE_READY,   ///< loaded, apply() switches to it
+			STATE_FAILED   ///< load, warm-up, or switch failed
+		};
+
+		~ModelSwap() {
+			if(thread.joinable()) {
+				thread.join();
+			}
+		}
+
+		/// start loading the model at path in the background, warmed up with
+		/// frame (may be invalid: blank input) at the model size, repeated
+		/// batch times for batched inference, and the style image of style;
+		/// returns false if a load or release is still running
+		bool load(ofxStyleTransfer & styleTransfer, const std::string & path, const PixelSpan & frame,
+		          const ofxStyleTransfer::Style & style, int batch=1) {
+			if(state == STATE_LOADING || (thread.joinable() && !finished)) {
+				return false;
+			}
+			if(thread.joinable()) {
+				thread.join();
+			}
+			this->path = path;
+			next.reset();
+			state = STATE_LOADING;
+			finished = false;
+			loadMs = 0;
+
+			// copy the frame here, the buffer is reused by the grabber
+			int width = styleTransfer.getModelWidth();
+			int height = styleTransfer.getModelHeight();
+			batch = std::max(batch, 1);
+			std::vector<float> input;
+			if(frame.isValid()) {
+				input.resize((std::size_t)width * height * 3);
+				preprocess(frame, input.data(), width, height);
+			}
+			cppflow::tensor image = style.image;
+			thread = std::thread([this, &styleTransfer, path, input, width, height, batch, image]() {
+				uint64_t start = ofGetElapsedTimeMicros();
+				std::shared_ptr<ofxStyleTransfer::Network> loaded = styleTransfer.loadNetwork(path);
+				bool warm = false;
+				if(loaded) {
+					cppflow::tensor content(0);
+					if(!input.empty()) {
+						content = cppflow::tensor(input, {1, height, width, 3});
+						if(batch > 1) {
+							content = cppflow::concat(cppflow::tensor(0),
+								std::vector<cppflow::tensor>(batch, content));
+						}
+					}
+					warm = styleTransfer.warmUp(*loaded, content, image);
+				}
+				loadMs = (ofGetElapsedTimeMicros() - start) / 1000.0;
+				if(!warm) {
+					ofLogError("ModelSwap") << "failed to load " << path;
+					state = STATE_FAILED;
+				}
+				else {
+					ofLogNotice("ModelSwap") << "loaded " << path << " in " << ofToString((double)loadMs, 0) << " ms";
+					next = loaded;
+					state = STATE_READY;
+				}
+				finished = true;
+			});
+			return true;
+		}
+
+		/// switch to the loaded model if it is ready, call at a frame
+		/// boundary, ie. at the start of update(); returns true if switched
+		bool apply(ofxStyleTransfer & styleTransfer) {
+			if(state != STATE_READY) {
+				return false;
+			}
+			thread.join(); // finished already
+			std::shared_ptr<ofxStyleTransfer::Network> previous;
+			bool switched = styleTransfer.swapNetwork(next, previous);
+			if(switched) {
+				current = path;
+				state = STATE_IDLE;
+				swaps++;
+			}
+			else {
+				previous = next; // incompatible: release the new one instead
+				state = STATE_FAILED;
+			}
+			next.reset();
+			release(previous);
+			return switched;
+		}
+
+		State getState() const {return state;}
+		bool isReady() const {return state == STATE_READY;}
+		bool isLoading() const {return state == STATE_LOADING;}
+
+		/// model path being loaded or last loaded
+		const std::string & getPath() const {return path;}
+
+		/// model path switched to last, empty before the first swap
+		const std::string & getCurrent() const {return current;}
+
+		/// load & warm-up time of the last load in ms
+		double getLoadMs() const {return loadMs;}
+
+		/// completed swaps
+		uint64_t getSwaps() const {return swaps;}
+
+		static std::string toString(State state) {
+			switch(state) {
+				case STATE_LOADING: return "loading";
+				case STATE_READY: return "ready";
+				case STATE_FAILED: return "failed";
+				default: return "idle";
+			}
+		}
+
+		static const int RELEASE_POLL_MS = 10; ///< wait between last use checks
+
+	protected:
+
+		/// free network on the background thread once no run holds it
+		/// anymore, destroying a session can take as long as a frame
+		void release(std::shared_ptr<ofxStyleTransfer::Network> network) {
+			if(!network) {
+				return;
+			}
+			finished = false;
+			thread = std::thread([this, network]() mutable {
+				// runs in flight hold their own reference
+				while(network.use_count() > 1) {
+					std::this_thread::sleep_for(std::chrono::milliseconds((int)RELEASE_POLL_MS));
+				}
+				uint64_t start = ofGetElapsedTimeMicros();
+				std::string released = network->modelPath;
+				network.reset();
+				ofLogVerbose("ModelSwap") << "released " << released << " in "
+					<< ofToString((ofGetElapsedTimeMicros() - start) / 1000.0, 1) << " ms";
+				finished = true;
+			});
+		}
+
+		std::thread thread; ///< load or release
+		std::atomic<State> state{STATE_IDLE};
+		std::atomic<bool> finished{true}; ///< has thread finished its work?
+		std::shared_ptr<ofxStyleTransfer::Network> next; ///< loaded, set before STATE_READY
+		std::string path; ///< model being loaded
+		std::string current; ///< model switched to last
+		std::atomic<double> loadMs{0};
+		uint64_t swaps = 0;
+};
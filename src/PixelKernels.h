@@ -0,0 +1,542 @@
+/*
+ * AI Dance Mirror
+ *
+ * Vectorized pixel conversion kernels with runtime CPU dispatch.
+ */
+#pragma once
+
+#include "PixelSpan.h"
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+	#define PIXELKERNELS_X86
+	#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+	#define PIXELKERNELS_NEON
+	#include <arm_neon.h>
+#endif
+
+/// pixel conversion kernels run on every frame:
+///   * toFloat(): 8 bit RGB/BGR/RGBA/BGRA -> normalized RGB float (0-1)
+///   * toUnsignedChar(): float (0-1) -> 8 bit, clamped & truncated
+///   * rgbaToRgb(): 8 bit RGBA -> RGB
+///   * affineToUnsignedChar(): a * x + b (0-1) -> 8 bit, as toUnsignedChar(),
+///     the final step of GuidedUpsampler
+///
+/// the best instruction set is picked once at runtime: AVX2 or SSE4.1 on x86,
+/// NEON on ARM, otherwise the scalar reference implementations
+///
+/// all variants are bit-exact with the scalar reference: u8 -> float is a
+/// single multiply by 1/255, float -> u8 multiplies by 255, clamps to 0-255
+/// (NaN becomes 0) and truncates like a TF_FLOAT to TF_UINT8 cast,
+/// see "bench kernels" for the verification & timings
+namespace PixelKernels {
+
+	/// instruction set
+	enum Isa {
+		ISA_SCALAR = 0,
+		ISA_SSE41,
+		ISA_AVX2,
+		ISA_NEON
+	};
+
+	static const float TO_FLOAT = 1.0f / 255.f;
+	static const float TO_UCHAR = 255.f;
+
+	/// source channel offsets of R, G, B for a layout
+	inline void channelOffsets(PixelSpan::Layout layout, int & r, int & g, int & b) {
+		bool bgr = (layout == PixelSpan::BGR || layout == PixelSpan::BGRA);
+		r = bgr ? 2 : 0;
+		g = 1;
+		b = bgr ? 0 : 2;
+	}
+
+	// ----- scalar reference -----
+
+	namespace scalar {
+
+		inline void toFloat(const uint8_t * src, float * dst, std::size_t pixels, PixelSpan::Layout layout) {
+			int r, g, b;
+			channelOffsets(layout, r, g, b);
+			int step = PixelSpan::channels(layout);
+			for(std::size_t i = 0; i < pixels; i++, src += step, dst += 3) {
+				dst[0] = src[r] * TO_FLOAT;
+				dst[1] = src[g] * TO_FLOAT;
+				dst[2] = src[b] * TO_FLOAT;
+			}
+		}
+
+		/// plain byte stream conversion, same as toFloat() for RGB
+		inline void bytesToFloat(const uint8_t * src, float * dst, std::size_t count) {
+			for(std::size_t i = 0; i < count; i++) {
+				dst[i] = src[i] * TO_FLOAT;
+			}
+		}
+
+		inline void toUnsignedChar(const float * src, uint8_t * dst, std::size_t count) {
+			for(std::size_t i = 0; i < count; i++) {
+				float v = src[i] * TO_UCHAR;
+				v = (v > 0.f) ? v : 0.f; // NaN -> 0
+				v = (v < 255.f) ? v : 255.f;
+				dst[i] = (uint8_t)(int)v;
+			}
+		}
+
+		inline void rgbaToRgb(const uint8_t * src, uint8_t * dst, std::size_t pixels) {
+			for(std::size_t i = 0; i < pixels; i++, src += 4, dst += 3) {
+				dst[0] = src[0];
+				dst[1] = src[1];
+				dst[2] = src[2];
+			}
+		}
+
+		inline void affineToUnsignedChar(const float * a, const float * x, const float * b,
+		                                 uint8_t * dst, std::size_t count) {
+			for(std::size_t i = 0; i < count; i++) {
+				// separate statements: no fused multiply-add, like the SIMD variants
+				float v = a[i] * x[i];
+				v += b[i];
+				v *= TO_UCHAR;
+				v = (v > 0.f) ? v : 0.f; // NaN -> 0
+				v = (v < 255.f) ? v : 255.f;
+				dst[i] = (uint8_t)(int)v;
+			}
+		}
+	}
+
+#ifdef PIXELKERNELS_X86
+
+	// ----- SSE4.1 -----
+
+	namespace sse41 {
+
+		/// pshufb mask packing 4 source pixels to 12 RGB bytes
+		__attribute__((target("sse4.1")))
+		inline __m128i packMask(PixelSpan::Layout layout) {
+			int r, g, b;
+			channelOffsets(layout, r, g, b);
+			int step = PixelSpan::channels(layout);
+			alignas(16) int8_t mask[16];
+			for(int p = 0; p < 4; p++) {
+				mask[p * 3 + 0] = p * step + r;
+				mask[p * 3 + 1] = p * step + g;
+				mask[p * 3 + 2] = p * step + b;
+			}
+			for(int i = 12; i < 16; i++) {
+				mask[i] = -1; // zero
+			}
+			return _mm_load_si128((const __m128i *)mask);
+		}
+
+		__attribute__((target("sse4.1")))
+		inline void store4(float * dst, __m128i bytes, __m128 scale) {
+			_mm_storeu_ps(dst, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(bytes)), scale));
+		}
+
+		__attribute__((target("sse4.1")))
+		inline void toFloat(const uint8_t * src, float * dst, std::size_t pixels, PixelSpan::Layout layout) {
+			const __m128 scale = _mm_set1_ps(TO_FLOAT);
+			const int step = PixelSpan::channels(layout);
+			std::size_t i = 0;
+			if(layout == PixelSpan::RGB) {
+				// no swizzle: plain byte stream conversion
+				std::size_t count = pixels * 3;
+				for(; i + 16 <= count; i += 16) {
+					__m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+					store4(dst + i, v, scale);
+					store4(dst + i + 4, _mm_srli_si128(v, 4), scale);
+					store4(dst + i + 8, _mm_srli_si128(v, 8), scale);
+					store4(dst + i + 12, _mm_srli_si128(v, 12), scale);
+				}
+				scalar::bytesToFloat(src + i, dst + i, count - i);
+				return;
+			}
+			const __m128i mask = packMask(layout);
+			// 4 pixels per iteration, each load reads 16 bytes
+			for(; (pixels - i) * step >= 16 && i + 4 <= pixels; i += 4) {
+				__m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + i * step)), mask);
+				store4(dst + i * 3, v, scale);
+				store4(dst + i * 3 + 4, _mm_srli_si128(v, 4), scale);
+				store4(dst + i * 3 + 8, _mm_srli_si128(v, 8), scale);
+			}
+			scalar::toFloat(src + i * step, dst + i * 3, pixels - i, layout);
+		}
+
+		__attribute__((target("sse4.1")))
+		inline __m128i convert4(const float * src, __m128 scale, __m128 zero, __m128 max) {
+			__m128 v = _mm_mul_ps(_mm_loadu_ps(src), scale);
+			v = _mm_min_ps(_mm_max_ps(v, zero), max);
+			return _mm_cvttps_epi32(v);
+		}
+
+		__attribute__((target("sse4.1")))
+		inline void toUnsignedChar(const float * src, uint8_t * dst, std::size_t count) {
+			const __m128 scale = _mm_set1_ps(TO_UCHAR);
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 max = _mm_set1_ps(255.f);
+			std::size_t i = 0;
+			for(; i + 16 <= count; i += 16) {
+				__m128i a = convert4(src + i, scale, zero, max);
+				__m128i b = convert4(src + i + 4, scale, zero, max);
+				__m128i c = convert4(src + i + 8, scale, zero, max);
+				__m128i d = convert4(src + i + 12, scale, zero, max);
+				__m128i v = _mm_packus_epi16(_mm_packus_epi32(a, b), _mm_packus_epi32(c, d));
+				_mm_storeu_si128((__m128i *)(dst + i), v);
+			}
+			scalar::toUnsignedChar(src + i, dst + i, count - i);
+		}
+
+		__attribute__((target("sse4.1")))
+		inline void rgbaToRgb(const uint8_t * src, uint8_t * dst, std::size_t pixels) {
+			const __m128i mask = packMask(PixelSpan::RGBA);
+			std::size_t i = 0;
+			// the 16 byte store writes 4 bytes past the 12 packed ones
+			for(; i + 6 <= pixels; i += 4) {
+				__m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + i * 4)), mask);
+				_mm_storeu_si128((__m128i *)(dst + i * 3), v);
+			}
+			scalar::rgbaToRgb(src + i * 4, dst + i * 3, pixels - i);
+		}
+
+		__attribute__((target("sse4.1")))
+		inline __m128i affine4(const float * a, const float * x, const float * b,
+		                       __m128 scale, __m128 zero, __m128 max) {
+			__m128 v = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(a), _mm_loadu_ps(x)), _mm_loadu_ps(b));
+			v = _mm_min_ps(_mm_max_ps(_mm_mul_ps(v, scale), zero), max);
+			return _mm_cvttps_epi32(v);
+		}
+
+		__attribute__((target("sse4.1")))
+		inline void affineToUnsignedChar(const float * a, const float * x, const float * b,
+		                                 uint8_t * dst, std::size_t count) {
+			const __m128 scale = _mm_set1_ps(TO_UCHAR);
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 max = _mm_set1_ps(255.f);
+			std::size_t i = 0;
+			for(; i + 16 <= count; i += 16) {
+				__m128i v0 = affine4(a + i, x + i, b + i, scale, zero, max);
+				__m128i v1 = affine4(a + i + 4, x + i + 4, b + i + 4, scale, zero, max);
+				__m128i v2 = affine4(a + i + 8, x + i + 8, b + i + 8, scale, zero, max);
+				__m128i v3 = affine4(a + i + 12, x + i + 12, b + i + 12, scale, zero, max);
+				__m128i v = _mm_packus_epi16(_mm_packus_epi32(v0, v1), _mm_packus_epi32(v2, v3));
+				_mm_storeu_si128((__m128i *)(dst + i), v);
+			}
+			scalar::affineToUnsignedChar(a + i, x + i, b + i, dst + i, count - i);
+		}
+	}
+
+	// ----- AVX2 -----
+
+	namespace avx2 {
+
+		__attribute__((target("avx2")))
+		inline void store8(float * dst, __m128i bytes, __m256 scale) {
+			_mm256_storeu_ps(dst, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes)), scale));
+		}
+
+		__attribute__((target("avx2")))
+		inline void toFloat(const uint8_t * src, float * dst, std::size_t pixels, PixelSpan::Layout layout) {
+			const __m256 scale = _mm256_set1_ps(TO_FLOAT);
+			const int step = PixelSpan::channels(layout);
+			std::size_t i = 0;
+			if(layout == PixelSpan::RGB) {
+				std::size_t count = pixels * 3;
+				for(; i + 16 <= count; i += 16) {
+					__m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+					store8(dst + i, v, scale);
+					store8(dst + i + 8, _mm_srli_si128(v, 8), scale);
+				}
+				scalar::bytesToFloat(src + i, dst + i, count - i);
+				return;
+			}
+			// 8 pixels per iteration: 4 per 128 bit lane packed to 12 bytes,
+			// then the 24 bytes are regrouped into 3 x 8 for conversion
+			const __m128i mask128 = sse41::packMask(layout);
+			const __m256i mask = _mm256_broadcastsi128_si256(mask128);
+			for(; i + 8 <= pixels && (pixels - i) * step >= (std::size_t)(4 * step + 16); i += 8) {
+				const uint8_t * s = src + i * step;
+				__m256i v = _mm256_set_m128i(_mm_loadu_si128((const __m128i *)(s + 4 * step)),
+				                             _mm_loadu_si128((const __m128i *)s));
+				v = _mm256_shuffle_epi8(v, mask);
+				__m128i lo = _mm256_castsi256_si128(v);
+				__m128i hi = _mm256_extracti128_si256(v, 1);
+				// [lo 8-11, hi 0-3, hi 4-7, hi 8-11]
+				__m128i mid = _mm_blend_epi32(_mm_srli_si128(lo, 8), _mm_slli_si128(hi, 4), 0xE);
+				float * d = dst + i * 3;
+				store8(d, lo, scale);
+				store8(d + 8, mid, scale);
+				store8(d + 16, _mm_srli_si128(mid, 8), scale);
+			}
+			sse41::toFloat(src + i * step, dst + i * 3, pixels - i, layout);
+		}
+
+		__attribute__((target("avx2")))
+		inline __m256i convert8(const float * src, __m256 scale, __m256 zero, __m256 max) {
+			__m256 v = _mm256_mul_ps(_mm256_loadu_ps(src), scale);
+			v = _mm256_min_ps(_mm256_max_ps(v, zero), max);
+			return _mm256_cvttps_epi32(v);
+		}
+
+		__attribute__((target("avx2")))
+		inline void toUnsignedChar(const float * src, uint8_t * dst, std::size_t count) {
+			const __m256 scale = _mm256_set1_ps(TO_UCHAR);
+			const __m256 zero = _mm256_setzero_ps();
+			const __m256 max = _mm256_set1_ps(255.f);
+			// packs work per 128 bit lane, this restores the element order
+			const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+			std::size_t i = 0;
+			for(; i + 32 <= count; i += 32) {
+				__m256i a = convert8(src + i, scale, zero, max);
+				__m256i b = convert8(src + i + 8, scale, zero, max);
+				__m256i c = convert8(src + i + 16, scale, zero, max);
+				__m256i d = convert8(src + i + 24, scale, zero, max);
+				__m256i v = _mm256_packus_epi16(_mm256_packus_epi32(a, b), _mm256_packus_epi32(c, d));
+				_mm256_storeu_si256((__m256i *)(dst + i), _mm256_permutevar8x32_epi32(v, order));
+			}
+			sse41::toUnsignedChar(src + i, dst + i, count - i);
+		}
+
+		__attribute__((target("avx2")))
+		inline void rgbaToRgb(const uint8_t * src, uint8_t * dst, std::size_t pixels) {
+			const __m256i mask = _mm256_broadcastsi128_si256(sse41::packMask(PixelSpan::RGBA));
+			// move the 3 packed dwords of the upper lane next to the lower ones
+			const __m256i order = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+			std::size_t i = 0;
+			// the 32 byte store writes 8 bytes past the 24 packed ones
+			for(; i + 11 <= pixels; i += 8) {
+				__m256i v = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(src + i * 4)), mask);
+				_mm256_storeu_si256((__m256i *)(dst + i * 3), _mm256_permutevar8x32_epi32(v, order));
+			}
+			sse41::rgbaToRgb(src + i * 4, dst + i * 3, pixels - i);
+		}
+
+		__attribute__((target("avx2")))
+		inline __m256i affine8(const float * a, const float * x, const float * b,
+		                       __m256 scale, __m256 zero, __m256 max) {
+			// mul + add instead of FMA to match the scalar reference
+			__m256 v = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(a), _mm256_loadu_ps(x)), _mm256_loadu_ps(b));
+			v = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(v, scale), zero), max);
+			return _mm256_cvttps_epi32(v);
+		}
+
+		__attribute__((target("avx2")))
+		inline void affineToUnsignedChar(const float * a, const float * x, const float * b,
+		                                 uint8_t * dst, std::size_t count) {
+			const __m256 scale = _mm256_set1_ps(TO_UCHAR);
+			const __m256 zero = _mm256_setzero_ps();
+			const __m256 max = _mm256_set1_ps(255.f);
+			const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+			std::size_t i = 0;
+			for(; i + 32 <= count; i += 32) {
+				__m256i v0 = affine8(a + i, x + i, b + i, scale, zero, max);
+				__m256i v1 = affine8(a + i + 8, x + i + 8, b + i + 8, scale, zero, max);
+				__m256i v2 = affine8(a + i + 16, x + i + 16, b + i + 16, scale, zero, max);
+				__m256i v3 = affine8(a + i + 24, x + i + 24, b + i + 24, scale, zero, max);
+				__m256i v = _mm256_packus_epi16(_mm256_packus_epi32(v0, v1), _mm256_packus_epi32(v2, v3));
+				_mm256_storeu_si256((__m256i *)(dst + i), _mm256_permutevar8x32_epi32(v, order));
+			}
+			sse41::affineToUnsignedChar(a + i, x + i, b + i, dst + i, count - i);
+		}
+	}
+
+#endif // PIXELKERNELS_X86
+
+#ifdef PIXELKERNELS_NEON
+
+	// ----- NEON -----
+
+	namespace neon {
+
+		inline float32x4_t convert4(uint16x4_t v, float32x4_t scale) {
+			return vmulq_f32(vcvtq_f32_u32(vmovl_u16(v)), scale);
+		}
+
+		inline void toFloat(const uint8_t * src, float * dst, std::size_t pixels, PixelSpan::Layout layout) {
+			int r, g, b;
+			channelOffsets(layout, r, g, b);
+			const int step = PixelSpan::channels(layout);
+			const float32x4_t scale = vdupq_n_f32(TO_FLOAT);
+			std::size_t i = 0;
+			for(; i + 16 <= pixels; i += 16) {
+				uint8x16_t c[4];
+				if(step == 4) {
+					uint8x16x4_t v = vld4q_u8(src + i * 4);
+					c[0] = v.val[0]; c[1] = v.val[1]; c[2] = v.val[2];
+				}
+				else {
+					uint8x16x3_t v = vld3q_u8(src + i * 3);
+					c[0] = v.val[0]; c[1] = v.val[1]; c[2] = v.val[2];
+				}
+				uint16x8_t wr[2] = {vmovl_u8(vget_low_u8(c[r])), vmovl_u8(vget_high_u8(c[r]))};
+				uint16x8_t wg[2] = {vmovl_u8(vget_low_u8(c[g])), vmovl_u8(vget_high_u8(c[g]))};
+				uint16x8_t wb[2] = {vmovl_u8(vget_low_u8(c[b])), vmovl_u8(vget_high_u8(c[b]))};
+				for(int q = 0; q < 4; q++) {
+					float32x4x3_t out;
+					out.val[0] = convert4(q & 1 ? vget_high_u16(wr[q >> 1]) : vget_low_u16(wr[q >> 1]), scale);
+					out.val[1] = convert4(q & 1 ? vget_high_u16(wg[q >> 1]) : vget_low_u16(wg[q >> 1]), scale);
+					out.val[2] = convert4(q & 1 ? vget_high_u16(wb[q >> 1]) : vget_low_u16(wb[q >> 1]), scale);
+					vst3q_f32(dst + (i + q * 4) * 3, out);
+				}
+			}
+			scalar::toFloat(src + i * step, dst + i * 3, pixels - i, layout);
+		}
+
+		inline void toUnsignedChar(const float * src, uint8_t * dst, std::size_t count) {
+			const float32x4_t scale = vdupq_n_f32(TO_UCHAR);
+			const float32x4_t zero = vdupq_n_f32(0.f);
+			const float32x4_t max = vdupq_n_f32(255.f);
+			std::size_t i = 0;
+			for(; i + 8 <= count; i += 8) {
+				// NaN propagates through min/max, the conversion maps it to 0
+				float32x4_t a = vminq_f32(vmaxq_f32(vmulq_f32(vld1q_f32(src + i), scale), zero), max);
+				float32x4_t b = vminq_f32(vmaxq_f32(vmulq_f32(vld1q_f32(src + i + 4), scale), zero), max);
+				uint16x8_t v = vcombine_u16(vmovn_u32(vcvtq_u32_f32(a)), vmovn_u32(vcvtq_u32_f32(b)));
+				vst1_u8(dst + i, vmovn_u16(v));
+			}
+			scalar::toUnsignedChar(src + i, dst + i, count - i);
+		}
+
+		inline void rgbaToRgb(const uint8_t * src, uint8_t * dst, std::size_t pixels) {
+			std::size_t i = 0;
+			for(; i + 16 <= pixels; i += 16) {
+				uint8x16x4_t v = vld4q_u8(src + i * 4);
+				uint8x16x3_t out = {{v.val[0], v.val[1], v.val[2]}};
+				vst3q_u8(dst + i * 3, out);
+			}
+			scalar::rgbaToRgb(src + i * 4, dst + i * 3, pixels - i);
+		}
+
+		inline void affineToUnsignedChar(const float * a, const float * x, const float * b,
+		                                 uint8_t * dst, std::size_t count) {
+			const float32x4_t scale = vdupq_n_f32(TO_UCHAR);
+			const float32x4_t zero = vdupq_n_f32(0.f);
+			const float32x4_t max = vdupq_n_f32(255.f);
+			std::size_t i = 0;
+			for(; i + 8 <= count; i += 8) {
+				// vmulq + vaddq, not vfmaq, to match the scalar reference
+				float32x4_t v0 = vaddq_f32(vmulq_f32(vld1q_f32(a + i), vld1q_f32(x + i)), vld1q_f32(b + i));
+				float32x4_t v1 = vaddq_f32(vmulq_f32(vld1q_f32(a + i + 4), vld1q_f32(x + i + 4)), vld1q_f32(b + i + 4));
+				v0 = vminq_f32(vmaxq_f32(vmulq_f32(v0, scale), zero), max);
+				v1 = vminq_f32(vmaxq_f32(vmulq_f32(v1, scale), zero), max);
+				uint16x8_t v = vcombine_u16(vmovn_u32(vcvtq_u32_f32(v0)), vmovn_u32(vcvtq_u32_f32(v1)));
+				vst1_u8(dst + i, vmovn_u16(v));
+			}
+			scalar::affineToUnsignedChar(a + i, x + i, b + i, dst + i, count - i);
+		}
+	}
+
+#endif // PIXELKERNELS_NEON
+
+	// ----- dispatch -----
+
+	/// best instruction set supported by this CPU
+	inline Isa detectIsa() {
+	#if defined(PIXELKERNELS_X86)
+		__builtin_cpu_init();
+		if(__builtin_cpu_supports("avx2")) {
+			return ISA_AVX2;
+		}
+		if(__builtin_cpu_supports("sse4.1")) {
+			return ISA_SSE41;
+		}
+	#elif defined(PIXELKERNELS_NEON)
+		return ISA_NEON;
+	#endif
+		return ISA_SCALAR;
+	}
+
+	/// returns true if the instruction set can be used on this CPU
+	inline bool isSupported(Isa isa) {
+		Isa best = detectIsa();
+		if(isa == ISA_SCALAR) {
+			return true;
+		}
+		if(best == ISA_NEON) {
+			return isa == ISA_NEON;
+		}
+		return isa != ISA_NEON && isa <= best;
+	}
+
+	/// instruction set name
+	inline const char * isaName(Isa isa) {
+		switch(isa) {
+			case ISA_SSE41: return "sse4.1";
+			case ISA_AVX2: return "avx2";
+			case ISA_NEON: return "neon";
+			default: return "scalar";
+		}
+	}
+
+	/// current instruction set, detected on first use
+	inline Isa & activeIsa() {
+		static Isa isa = detectIsa();
+		return isa;
+	}
+
+	/// force an instruction set, ie. to compare against the scalar reference,
+	/// returns false and keeps the current one if not supported
+	inline bool setIsa(Isa isa) {
+		if(!isSupported(isa)) {
+			return false;
+		}
+		activeIsa() = isa;
+		return true;
+	}
+
+	/// 8 bit pixels to normalized RGB float, dst must hold pixels * 3 floats
+	inline void toFloat(const uint8_t * src, float * dst, std::size_t pixels, PixelSpan::Layout layout) {
+		switch(activeIsa()) {
+		#ifdef PIXELKERNELS_X86
+			case ISA_AVX2: avx2::toFloat(src, dst, pixels, layout); return;
+			case ISA_SSE41: sse41::toFloat(src, dst, pixels, layout); return;
+		#endif
+		#ifdef PIXELKERNELS_NEON
+			case ISA_NEON: neon::toFloat(src, dst, pixels, layout); return;
+		#endif
+			default: scalar::toFloat(src, dst, pixels, layout); return;
+		}
+	}
+
+	/// normalized float to clamped 8 bit
+	inline void toUnsignedChar(const float * src, uint8_t * dst, std::size_t count) {
+		switch(activeIsa()) {
+		#ifdef PIXELKERNELS_X86
+			case ISA_AVX2: avx2::toUnsignedChar(src, dst, count); return;
+			case ISA_SSE41: sse41::toUnsignedChar(src, dst, count); return;
+		#endif
+		#ifdef PIXELKERNELS_NEON
+			case ISA_NEON: neon::toUnsignedChar(src, dst, count); return;
+		#endif
+			default: scalar::toUnsignedChar(src, dst, count); return;
+		}
+	}
+
+	/// 8 bit RGBA to RGB, dst must hold pixels * 3 bytes
+	inline void rgbaToRgb(const uint8_t * src, uint8_t * dst, std::size_t pixels) {
+		switch(activeIsa()) {
+		#ifdef PIXELKERNELS_X86
+			case ISA_AVX2: avx2::rgbaToRgb(src, dst, pixels); return;
+			case ISA_SSE41: sse41::rgbaToRgb(src, dst, pixels); return;
+		#endif
+		#ifdef PIXELKERNELS_NEON
+			case ISA_NEON: neon::rgbaToRgb(src, dst, pixels); return;
+		#endif
+			default: scalar::rgbaToRgb(src, dst, pixels); return;
+		}
+	}
+
+	/// clamped 8 bit of a * x + b, all arrays hold count floats
+	inline void affineToUnsignedChar(const float * a, const float * x, const float * b,
+	                                 uint8_t * dst, std::size_t count) {
+		switch(activeIsa()) {
+		#ifdef PIXELKERNELS_X86
+			case ISA_AVX2: avx2::affineToUnsignedChar(a, x, b, dst, count); return;
+			case ISA_SSE41: sse41::affineToUnsignedChar(a, x, b, dst, count); return;
+		#endif
+		#ifdef PIXELKERNELS_NEON
+			case ISA_NEON: neon::affineToUnsignedChar(a, x, b, dst, count); return;
+		#endif
+			default: scalar::affineToUnsignedChar(a, x, b, dst, count); return;
+		}
+	}
+}
@@ -0,0 +1,134 @@
+/*
+ * AI Dance Mirror
+ *
+ * Non-owning view of 8 bit interleaved pixels.
+ */
+#pragma once
+
+#include "ofMain.h"
+
+/// \struct PixelRect
+/// \brief integer pixel rectangle, ie. a region of a frame
+struct PixelRect {
+	int x = 0;
+	int y = 0;
+	int width = 0;
+	int height = 0;
+
+	PixelRect() {}
+	PixelRect(int x, int y, int width, int height) : x(x), y(y), width(width), height(height) {}
+
+	bool isEmpty() const {return width <= 0 || height <= 0;}
+	int getArea() const {return isEmpty() ? 0 : width * height;}
+
+	/// same rectangle in a frame scaled from one size to another
+	PixelRect scaled(int fromWidth, int fromHeight, int toWidth, int toHeight) const {
+		int x0 = x * toWidth / std::max(fromWidth, 1);
+		int y0 = y * toHeight / std::max(fromHeight, 1);
+		int x1 = ((x + width) * toWidth + fromWidth - 1) / std::max(fromWidth, 1);
+		int y1 = ((y + height) * toHeight + fromHeight - 1) / std::max(fromHeight, 1);
+		return PixelRect(x0, y0, std::min(x1, toWidth) - x0, std::min(y1, toHeight) - y0);
+	}
+
+	/// bounding box of both rectangles, empty rectangles are ignored
+	PixelRect united(const PixelRect & other) const {
+		if(other.isEmpty()) {
+			return *this;
+		}
+		if(isEmpty()) {
+			return other;
+		}
+		int x0 = std::min(x, other.x);
+		int y0 = std::min(y, other.y);
+		int x1 = std::max(x + width, other.x + other.width);
+		int y1 = std::max(y + height, other.y + other.height);
+		return PixelRect(x0, y0, x1 - x0, y1 - y0);
+	}
+};
+
+/// \struct PixelSpan
+/// \brief non-owning view of 8 bit interleaved pixels
+///
+/// lets camera buffers be read in place without copying them into ofPixels
+struct PixelSpan {
+
+	/// channel layout
+	enum Layout {
+		RGB,
+		BGR,
+		RGBA,
+		BGRA
+	};
+
+	const unsigned char * data = nullptr; ///< first pixel of the first row
+	int width = 0;
+	int height = 0;
+	std::size_t stride = 0; ///< bytes per row
+	Layout layout = RGB;
+
+	PixelSpan() {}
+
+	PixelSpan(const unsigned char * data, int width, int height, Layout layout, std::size_t stride=0) :
+		data(data), width(width), height(height),
+		stride(stride ? stride : width * channels(layout)), layout(layout) {}
+
+	/// view of RGB or RGBA ofPixels
+	PixelSpan(const ofPixels & pixels) :
+		PixelSpan(pixels.getData(), pixels.getWidth(), pixels.getHeight(),
+		          pixels.getNumChannels() == 4 ? RGBA : RGB) {}
+
+	/// returns true if the view points to pixels
+	bool isValid() const {return data != nullptr && width > 0 && height > 0;}
+
+	/// bytes per pixel
+	int getNumChannels() const {return channels(layout);}
+
+	/// returns true if rows are stored without padding
+	bool isContiguous() const {return stride == (std::size_t)width * channels(layout);}
+
+	/// pointer to row y
+	const unsigned char * row(int y) const {return data + y * stride;}
+
+	/// view of a rectangle within this view, clamped to its bounds
+	PixelSpan crop(const PixelRect & rect) const {
+		return crop(rect.x, rect.y, rect.width, rect.height);
+	}
+
+	/// view of a rectangle within this view, clamped to its bounds
+	PixelSpan crop(int x, int y, int w, int h) const {
+		x = std::min(std::max(x, 0), width);
+		y = std::min(std::max(y, 0), height);
+		w = std::min(std::max(w, 0), width - x);
+		h = std::min(std::max(h, 0), height - y);
+		return PixelSpan(row(y) + x * getNumChannels(), w, h, layout, stride);
+	}
+
+	/// bytes per pixel for a layout
+	static int channels(Layout layout) {
+		return (layout == RGBA || layout == BGRA) ? 4 : 3;
+	}
+};
+
+/// \struct DepthSpan
+/// \brief non-owning view of 16 bit depth values, ie. a RealSense Z16 frame
+struct DepthSpan {
+	const uint16_t * data = nullptr; ///< first value of the first row
+	int width = 0;
+	int height = 0;
+	std::size_t stride = 0; ///< bytes per row
+	float scale = 0.001f; ///< meters per depth unit
+
+	DepthSpan() {}
+
+	DepthSpan(const uint16_t * data, int width, int height, std::size_t stride=0, float scale=0.001f) :
+		data(data), width(width), height(height),
+		stride(stride ? stride : width * sizeof(uint16_t)), scale(scale) {}
+
+	/// returns true if the view points to depth values
+	bool isValid() const {return data != nullptr && width > 0 && height > 0;}
+
+	/// pointer to row y
+	const uint16_t * row(int y) const {
+		return (const uint16_t *)((const unsigned char *)data + y * stride);
+	}
+};
@@ -0,0 +1,96 @@
+/*
+ * AI Dance Mirror
+ *
+ * Fused input preprocessing: 8 bit camera pixels to normalized float NHWC.
+ */
+#pragma once
+
+#include "PixelSpan.h"
+#include "PixelKernels.h"
+#include <cmath>
+
+/// source taps & weights of output index i for a resize from srcSize to
+/// dstSize, as TensorFlow's legacy resize_bicubic with align_corners: sample
+/// at i * (srcSize - 1) / (dstSize - 1), Keys cubic with a = -0.75, weights
+/// from a 1024 step table, taps clamped to the border
+inline void bicubicTaps(int i, int srcSize, int dstSize, int tap[4], float weight[4]) {
+	const int TABLE_SIZE = 1024;
+	const float A = -0.75f;
+	const float scale = (dstSize > 1 ? (srcSize - 1) / (float)(dstSize - 1) : 0.f);
+	const float in = i * scale;
+	const int loc = (int)std::floor(in);
+	const int offset = (int)std::lrint((in - loc) * TABLE_SIZE);
+	auto inner = [A](float x) {return ((A + 2) * x - (A + 3)) * x * x + 1;}; // |x| <= 1
+	auto outer = [A](float x) {return ((A * x - 5 * A) * x + 8 * A) * x - 4 * A;}; // 1 < |x| < 2
+	const float x = offset / (float)TABLE_SIZE, rest = (TABLE_SIZE - offset) / (float)TABLE_SIZE;
+	weight[0] = outer(x + 1);
+	weight[1] = inner(x);
+	weight[2] = inner(rest);
+	weight[3] = outer(rest + 1);
+	for(int j = 0; j < 4; j++) {
+		tap[j] = std::min(std::max(loc - 1 + j, 0), srcSize - 1);
+	}
+}
+
+/// convert 8 bit pixels to normalized RGB float (0-1) in a single pass:
+/// channel order conversion, alpha removal, resize, and normalization are
+/// done while reading the source exactly once, dst must hold
+/// dstWidth * dstHeight * 3 floats
+///
+/// resizing samples exactly like cppflow::resize_bicubic(t, size, true), the
+/// call it replaces & which the other paths still use: bicubic with aligned
+/// corners, see bicubicTaps()
+inline void preprocess(const PixelSpan & src, float * dst, int dstWidth, int dstHeight) {
+	const int channels = src.getNumChannels();
+	const bool bgr = (src.layout == PixelSpan::BGR || src.layout == PixelSpan::BGRA);
+	const int r = bgr ? 2 : 0;
+	const int b = bgr ? 0 : 2;
+	const float scale = 1.0f / 255.f;
+
+	// same size: straight vectorized conversion
+	if(src.width == dstWidth && src.height == dstHeight) {
+		if(src.isContiguous()) {
+			PixelKernels::toFloat(src.data, dst, (std::size_t)dstWidth * dstHeight, src.layout);
+			return;
+		}
+		for(int y = 0; y < dstHeight; y++, dst += dstWidth * 3) {
+			PixelKernels::toFloat(src.row(y), dst, dstWidth, src.layout);
+		}
+		return;
+	}
+
+	// resize: precompute horizontal taps once per call
+	std::vector<int> xTaps(dstWidth * 4);
+	std::vector<float> xWeights(dstWidth * 4);
+	for(int x = 0; x < dstWidth; x++) {
+		int tap[4];
+		bicubicTaps(x, src.width, dstWidth, tap, &xWeights[x * 4]);
+		for(int i = 0; i < 4; i++) {
+			xTaps[x * 4 + i] = tap[i] * channels;
+		}
+	}
+	for(int y = 0; y < dstHeight; y++) {
+		int yTap[4];
+		float yWeight[4];
+		bicubicTaps(y, src.height, dstHeight, yTap, yWeight);
+		const unsigned char * rows[4];
+		for(int j = 0; j < 4; j++) {
+			rows[j] = src.row(yTap[j]);
+			yWeight[j] *= scale;
+		}
+		for(int x = 0; x < dstWidth; x++, dst += 3) {
+			const int * tap = &xTaps[x * 4];
+			const float * w = &xWeights[x * 4];
+			for(int ch = 0; ch < 3; ch++) {
+				int k = (ch == 0 ? r : (ch == 1 ? 1 : b));
+				float sum = 0;
+				for(int j = 0; j < 4; j++) {
+					const unsigned char * row = rows[j] + k;
+					sum += yWeight[j] * (row[tap[0]] * w[0] + row[tap[1]] * w[1] +
+					                     row[tap[2]] * w[2] + row[tap[3]] * w[3]);
+				}
+				dst[ch] = sum;
+			}
+		}
+	}
+}
@@ -0,0 +1,218 @@
+/*
+ * AI Dance Mirror
+ *
+ * RealSense live camera and .bag playback frame source.
+ */
+#pragma once
+
+#include "FrameSource.h"
+#include <librealsense2/rs.hpp>
+
+/// \class RealSenseFrameSource
+/// \brief color frames from a live RealSense camera or a recorded .bag file
+///
+/// with setDepth() the depth stream is enabled as well and aligned to the
+/// color frame, if the camera or recording has one
+///
+/// .bag files are played back through the librealsense playback device: in
+/// PACING_REALTIME the recording runs at its recorded speed, otherwise
+/// playback is switched to non real time mode so every recorded frame is
+/// delivered in order, either as fast as possible or at the fixed step rate
+class RealSenseFrameSource : public FrameSource {
+	public:
+
+		/// live camera with requested color stream size and rate
+		RealSenseFrameSource(int width=640, int height=480, int fps=30) :
+			requestedWidth(width), requestedHeight(height) {
+			setFrameRate(fps);
+		}
+
+		/// select a specific live camera by serial number, call before open()
+		void setSerial(const std::string & serial) {
+			this->serial = serial;
+		}
+
+		/// play back a .bag recording instead of a live camera,
+		/// call before open()
+		void setFile(const std::string & path) {
+			file = path;
+		}
+
+		bool open() {
+			rs2::config cfg = makeConfig(depthRequested);
+			depthAvailable = depthRequested;
+			if(depthRequested && !canResolve(cfg)) {
+				// ie. a recording without depth or a camera without a depth sensor
+				ofLogWarning("RealSenseFrameSource") << "no depth stream in " << getName()
+				                                     << ", continuing with color only";
+				cfg = makeConfig(false);
+				depthAvailable = false;
+			}
+			try {
+				rs2::pipeline_profile profile = pipe.start(cfg);
+				started = true;
+				if(!file.empty()) {
+					rs2::playback playback = profile.get_device().as<rs2::playback>();
+					playback.set_real_time(pacing == PACING_REALTIME);
+				}
+				rs2::video_stream_profile stream =
+					profile.get_stream(RS2_STREAM_COLOR).as<rs2::video_stream_profile>();
+				width = stream.width();
+				height = stream.height();
+				format = stream.format();
+				if(depthAvailable) {
+					depthScale = profile.get_device().first<rs2::depth_sensor>().get_depth_scale();
+				}
+			}
+			catch(const rs2::error & e) {
+				ofLogError("RealSenseFrameSource") << "failed to start " << getName() << ": " << e.what();
+				close();
+				return false;
+			}
+			if(!isSupported(format)) {
+				ofLogError("RealSenseFrameSource") << "unsupported color format in " << getName();
+				close();
+				return false;
+			}
+			index = 0;
+			finished = false;
+			pacer.setInterval(pacing == PACING_FIXED ? 1.0 / frameRate : 0);
+			ofLogNotice("RealSenseFrameSource") << "started " << getName() << " "
+				<< width << "x" << height << (depthAvailable ? " with depth" : "");
+			return true;
+		}
+
+		void close() {
+			if(started) {
+				pipe.stop();
+				started = false;
+			}
+		}
+
+		bool grab(Frame & frame) {
+			if(finished) {
+				return idle();
+			}
+			pacer.wait();
+			try {
+				rs2::frameset frames;
+				if(!pipe.try_wait_for_frames(&frames, 1000)) {
+					checkFinished();
+					return false;
+				}
+				if(depthAvailable) {
+					// reproject depth into the color camera, pixel for pixel
+					frames = aligner.process(frames);
+				}
+				rs2::video_frame color = frames.get_color_frame();
+				if(!color) {
+					return false;
+				}
+				// read the camera buffers in place, the frame holds a reference
+				// until the grabber reuses it
+				frame.setExternal(PixelSpan((const unsigned char *)color.get_data(),
+				                            width, height, layout(format),
+				                            color.get_stride_in_bytes()),
+				                  std::make_shared<rs2::frameset>(frames));
+				if(depthAvailable) {
+					rs2::depth_frame depth = frames.get_depth_frame();
+					if(depth) {
+						frame.depth = DepthSpan((const uint16_t *)depth.get_data(),
+						                        depth.get_width(), depth.get_height(),
+						                        depth.get_stride_in_bytes(), depthScale);
+					}
+				}
+				frame.sourceTime = (pacing == PACING_FIXED ? stepTime(index) :
+				                    (uint64_t)(color.get_timestamp() * 1000.0));
+				index++;
+				return true;
+			}
+			catch(const rs2::error & e) {
+				ofLogError("RealSenseFrameSource") << "frame capture error: " << e.what();
+				checkFinished();
+				return false;
+			}
+		}
+
+		std::string getName() const {
+			if(!file.empty()) {
+				return "bag " + file;
+			}
+			return serial.empty() ? "realsense" : "realsense " + serial;
+		}
+
+	private:
+
+		/// stream config: color and optionally Z16 depth, a recording provides
+		/// whatever streams it contains
+		rs2::config makeConfig(bool depth) const {
+			rs2::config cfg;
+			if(!file.empty()) {
+				cfg.enable_device_from_file(ofToDataPath(file, true), loop);
+				cfg.enable_stream(RS2_STREAM_COLOR);
+				if(depth) {
+					cfg.enable_stream(RS2_STREAM_DEPTH);
+				}
+			}
+			else {
+				if(!serial.empty()) {
+					cfg.enable_device(serial);
+				}
+				cfg.enable_stream(RS2_STREAM_COLOR, requestedWidth, requestedHeight,
+				                  RS2_FORMAT_RGB8, (int)frameRate);
+				if(depth) {
+					// any depth resolution, it is resampled to color by the aligner
+					cfg.enable_stream(RS2_STREAM_DEPTH, RS2_FORMAT_Z16, (int)frameRate);
+				}
+			}
+			return cfg;
+		}
+
+		/// can the pipeline start with this config?
+		bool canResolve(const rs2::config & cfg) {
+			try {
+				return cfg.can_resolve(pipe);
+			}
+			catch(const rs2::error & e) {
+				return false;
+			}
+		}
+
+		static bool isSupported(rs2_format format) {
+			return format == RS2_FORMAT_RGB8 || format == RS2_FORMAT_BGR8 ||
+			       format == RS2_FORMAT_RGBA8 || format == RS2_FORMAT_BGRA8;
+		}
+
+		/// channel layout of a supported color format
+		static PixelSpan::Layout layout(rs2_format format) {
+			switch(format) {
+				case RS2_FORMAT_BGR8: return PixelSpan::BGR;
+				case RS2_FORMAT_RGBA8: return PixelSpan::RGBA;
+				case RS2_FORMAT_BGRA8: return PixelSpan::BGRA;
+				default: return PixelSpan::RGB;
+			}
+		}
+
+		/// mark a non-looping recording as finished when playback has stopped
+		void checkFinished() {
+			if(file.empty() || loop || !started) {
+				return;
+			}
+			rs2::playback playback = pipe.get_active_profile().get_device().as<rs2::playback>();
+			if(playback.current_status() == RS2_PLAYBACK_STATUS_STOPPED) {
+				finished = true;
+				ofLogNotice("RealSenseFrameSource") << "reached end of " << file;
+			}
+		}
+
+		rs2::pipeline pipe;
+		rs2::align aligner{RS2_STREAM_COLOR}; ///< maps depth to color pixels
+		float depthScale = 0.001f; ///< meters per depth unit
+		bool started = false; ///< is the pipeline running?
+		int requestedWidth; ///< live color stream width
+		int requestedHeight; ///< live color stream height
+		std::string serial; ///< optional live camera serial number
+		std::string file; ///< optional .bag recording path
+		rs2_format format = RS2_FORMAT_RGB8; ///< actual color stream format
+		uint64_t index = 0; ///< next frame index
+};
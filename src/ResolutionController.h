@@ -0,0 +1,156 @@
+/*
+ * AI Dance Mirror
+ *
+ * Closed loop model input size control for a target frame rate.
+ */
+#pragma once
+
+#include "ofMain.h"
+
+/// \class ResolutionController
+/// \brief steps the model input size up or down to hold a target frame rate
+///
+/// sizes form a ladder of multiples of 32 keeping the camera aspect ratio,
+/// feed the measured time per output frame to update() and apply the new
+/// size when it returns true
+///
+/// hysteresis: the size only drops after the smoothed frame time has been
+/// over budget for a number of frames and only rises when the time predicted
+/// for the next step (scaled by pixel count) fits the budget with headroom
+/// for a longer stretch, after every change measurements settle for a while,
+/// so the size does not oscillate around the budget
+class ResolutionController {
+	public:
+
+		/// one model input size
+		struct Step {
+			int width = 0;
+			int height = 0;
+		};
+
+		/// build the size ladder for a maximum size and aspect ratio,
+		/// starts at the step closest to the maximum
+		void setup(int maxWidth, int maxHeight, int minHeight=128) {
+			steps.clear();
+			float aspect = (float)maxWidth / std::max(maxHeight, 1);
+			int top = std::max(roundTo32(maxHeight), 32);
+			for(int height = std::max(roundTo32(minHeight), 32); height <= top; height += 32) {
+				Step step;
+				step.height = height;
+				step.width = std::max(roundTo32(height * aspect), 32);
+				if(steps.empty() || steps.back().width != step.width) {
+					steps.push_back(step);
+				}
+			}
+			current = (int)steps.size() - 1;
+			reset();
+		}
+
+		/// set target frame rate, 0 disables the controller
+		void setTargetFps(float fps) {
+			targetFps = std::max(fps, 0.f);
+			reset();
+		}
+
+		float getTargetFps() const {return targetFps;}
+
+		bool isEnabled() const {return targetFps > 0 && !steps.empty();}
+
+		/// jump to the step closest to a size, ie. the configured start size
+		void setSize(int width, int height) {
+			int best = 0;
+			for(std::size_t i = 0; i < steps.size(); i++) {
+				if(std::abs(steps[i].height - height) < std::abs(steps[best].height - height)) {
+					best = i;
+				}
+			}
+			current = best;
+			reset();
+		}
+
+		/// add a measured time per output frame in ms, returns true if the
+		/// size changed
+		bool update(double frameMs) {
+			if(!isEnabled() || frameMs <= 0) {
+				return false;
+			}
+			if(settle > 0) {
+				// frames still in flight at the previous size
+				settle--;
+				return false;
+			}
+			smoothedMs = (smoothedMs == 0 ? frameMs : smoothedMs * (1 - SMOOTHING) + frameMs * SMOOTHING);
+
+			double budget = 1000.0 / targetFps;
+			if(smoothedMs > budget * (1 + DOWN_MARGIN) && current > 0) {
+				over++;
+				under = 0;
+				if(over >= DOWN_FRAMES) {
+					return change(current - 1);
+				}
+			}
+			else if(current + 1 < (int)steps.size() && predictedMs(current + 1) < budget * (1 - UP_MARGIN)) {
+				under++;
+				over = 0;
+				if(under >= UP_FRAMES) {
+					return change(current + 1);
+				}
+			}
+			else {
+				over = 0;
+				under = 0;
+			}
+			return false;
+		}
+
+		int getWidth() const {return steps.empty() ? 0 : steps[current].width;}
+		int getHeight() const {return steps.empty() ? 0 : steps[current].height;}
+
+		/// smoothed time per frame in ms
+		double getFrameMs() const {return smoothedMs;}
+
+		/// size ladder, smallest first
+		const std::vector<Step> & getSteps() const {return steps;}
+
+		// hysteresis settings
+		static constexpr double SMOOTHING = 0.1; ///< frame time smoothing factor
+		static constexpr double DOWN_MARGIN = 0.05; ///< over budget by more than 5%
+		static constexpr double UP_MARGIN = 0.15; ///< next step fits with 15% headroom
+		static const int DOWN_FRAMES = 15; ///< frames over budget before stepping down
+		static const int UP_FRAMES = 60; ///< frames with headroom before stepping up
+		static const int SETTLE_FRAMES = 30; ///< frames ignored after a change
+
+	protected:
+
+		bool change(int step) {
+			current = step;
+			reset();
+			return true;
+		}
+
+		/// restart measurement: smoothing & counters
+		void reset() {
+			smoothedMs = 0;
+			over = 0;
+			under = 0;
+			settle = SETTLE_FRAMES;
+		}
+
+		/// frame time at another step, assuming cost scales with pixel count
+		double predictedMs(int step) const {
+			double pixels = (double)steps[current].width * steps[current].height;
+			return smoothedMs * (steps[step].width * steps[step].height) / pixels;
+		}
+
+		static int roundTo32(float n) {
+			return (int)std::round(n / 32.f) * 32;
+		}
+
+		std::vector<Step> steps;
+		int current = 0; ///< current step index
+		float targetFps = 0;
+		double smoothedMs = 0;
+		int over = 0; ///< consecutive frames over budget
+		int under = 0; ///< consecutive frames with headroom
+		int settle = 0; ///< frames left to ignore after a change
+};
@@ -0,0 +1,224 @@
+/*
+ * AI Dance Mirror
+ *
+ * Concurrent startup tasks with dependencies, progress & timing.
+ */
+#pragma once
+
+#include "ofMain.h"
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/// \class StartupTasks
+/// \brief runs named startup tasks concurrently, each as soon as its
+///        dependencies have finished
+///
+/// every task gets its own thread, so independent slow steps like model
+/// loading and camera enumeration overlap; a task fails by returning false
+/// or throwing, tasks depending on a failed task are skipped
+///
+/// tasks must not touch OpenGL, finish GL setup on the main thread once
+/// isFinished() returns true
+class StartupTasks {
+	public:
+
+		/// task state
+		enum State {
+			WAITING = 0, ///< dependencies not finished yet
+			RUNNING,
+			DONE,
+			FAILED,
+			SKIPPED ///< a dependency failed
+		};
+
+		/// task progress snapshot
+		struct Status {
+			std::string name;
+			State state = WAITING;
+			double startMs = 0; ///< since start()
+			double durationMs = 0; ///< so far if running
+			std::string error; ///< exception message
+		};
+
+		StartupTasks() {}
+		StartupTasks(const StartupTasks &) = delete;
+		StartupTasks & operator=(const StartupTasks &) = delete;
+
+		~StartupTasks() {
+			wait();
+		}
+
+		/// add a task, dependencies are names of tasks added before it
+		void add(const std::string & name, std::function<bool()> function,
+		         const std::vector<std::string> & dependencies={}) {
+			std::lock_guard<std::mutex> lock(mutex);
+			Task task;
+			task.status.name = name;
+			task.function = function;
+			for(auto & dependency : dependencies) {
+				std::size_t index = find(dependency);
+				if(index == tasks.size()) {
+					ofLogError("StartupTasks") << name << ": unknown dependency " << dependency;
+					task.status.state = SKIPPED;
+					continue;
+				}
+				task.dependencies.push_back(index);
+			}
+			tasks.push_back(task);
+		}
+
+		/// run all tasks
+		void start() {
+			std::lock_guard<std::mutex> lock(mutex);
+			startTime = ofGetElapsedTimeMicros();
+			for(std::size_t i = 0; i < tasks.size(); i++) {
+				threads.emplace_back(&StartupTasks::run, this, i);
+			}
+		}
+
+		/// block until all tasks have finished
+		void wait() {
+			for(auto & thread : threads) {
+				if(thread.joinable()) {
+					thread.join();
+				}
+			}
+			threads.clear();
+		}
+
+		/// have all tasks finished, failed, or been skipped?
+		bool isFinished() const {
+			std::lock_guard<std::mutex> lock(mutex);
+			return finished == tasks.size();
+		}
+
+		/// did all tasks succeed? valid once finished
+		bool isSuccessful() const {
+			std::lock_guard<std::mutex> lock(mutex);
+			for(auto & task : tasks) {
+				if(task.status.state != DONE) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		/// finished tasks / total, 0-1
+		float getProgress() const {
+			std::lock_guard<std::mutex> lock(mutex);
+			return tasks.empty() ? 1 : (float)finished / tasks.size();
+		}
+
+		/// ms since start()
+		double getElapsed() const {
+			return (ofGetElapsedTimeMicros() - startTime) / 1000.0;
+		}
+
+		/// snapshot of all tasks in the order they were added
+		std::vector<Status> getStatus() const {
+			std::lock_guard<std::mutex> lock(mutex);
+			std::vector<Status> status;
+			for(auto & task : tasks) {
+				status.push_back(task.status);
+				if(task.status.state == RUNNING) {
+					status.back().durationMs = getElapsed() - task.status.startMs;
+				}
+			}
+			return status;
+		}
+
+		/// one line per task: name, state, start & duration in ms
+		std::string getSummary() const {
+			std::stringstream summary;
+			summary << std::left << std::setw(16) << "task" << std::setw(9) << "state" << std::right
+			        << std::setw(9) << "start" << std::setw(9) << "ms" << std::endl;
+			for(auto & status : getStatus()) {
+				summary << std::left << std::setw(16) << status.name << std::setw(9) << getName(status.state)
+				        << std::right << std::fixed << std::setprecision(0)
+				        << std::setw(9) << status.startMs << std::setw(9) << status.durationMs;
+				if(!status.error.empty()) {
+					summary << "  " << status.error;
+				}
+				summary << std::endl;
+			}
+			return summary.str();
+		}
+
+		/// state name
+		static const char * getName(State state) {
+			static const char * names[] = {"waiting", "running", "done", "failed", "skipped"};
+			return names[state];
+		}
+
+	protected:
+
+		struct Task {
+			Status status;
+			std::function<bool()> function;
+			std::vector<std::size_t> dependencies; ///< task indices
+		};
+
+		/// task index by name, tasks.size() if not found
+		std::size_t find(const std::string & name) const {
+			for(std::size_t i = 0; i < tasks.size(); i++) {
+				if(tasks[i].status.name == name) {
+					return i;
+				}
+			}
+			return tasks.size();
+		}
+
+		/// task thread: wait for dependencies, run, and wake dependents
+		void run(std::size_t index) {
+			std::unique_lock<std::mutex> lock(mutex);
+			Task & task = tasks[index];
+			bool ready = false;
+			condition.wait(lock, [&] {
+				ready = true;
+				for(std::size_t dependency : task.dependencies) {
+					State state = tasks[dependency].status.state;
+					if(state == FAILED || state == SKIPPED) {
+						task.status.state = SKIPPED;
+						return true;
+					}
+					ready &= (state == DONE);
+				}
+				return ready || task.status.state == SKIPPED;
+			});
+			if(task.status.state != SKIPPED) {
+				task.status.state = RUNNING;
+				task.status.startMs = getElapsed();
+				lock.unlock();
+
+				bool success = false;
+				std::string error;
+				try {
+					success = task.function();
+				}
+				catch(const std::exception & e) {
+					error = e.what();
+				}
+
+				lock.lock();
+				task.status.durationMs = getElapsed() - task.status.startMs;
+				task.status.state = (success ? DONE : FAILED);
+				task.status.error = error;
+				if(!success) {
+					ofLogError("StartupTasks") << task.status.name << " failed"
+						<< (error.empty() ? "" : ": " + error);
+				}
+			}
+			finished++;
+			lock.unlock();
+			condition.notify_all();
+		}
+
+		std::vector<Task> tasks;
+		std::vector<std::thread> threads;
+		std::size_t finished = 0; ///< tasks done, failed, or skipped
+		uint64_t startTime = 0; ///< us
+		mutable std::mutex mutex;
+		std::condition_variable condition;
+};
@@ -0,0 +1,400 @@
+/*
+ * AI Dance Mirror
+ *
+ * Batched style transfer for several input streams.
+ */
+#pragma once
+
+#include "ofxStyleTransfer.h"
+#include "BoundedQueue.h"
+#include "FrameProfiler.h"
+#include "TextureStream.h"
+#include <chrono>
+#include <thread>
+
+/// \class StreamBatcher
+/// \brief stylizes frames of several streams, ie. cameras, in one batched
+///        model run per step, each stream with its own style
+///
+/// every stream holds its newest submitted frame; once all streams have a
+/// frame, or timeout ms after the first frame of a round arrived, the waiting
+/// frames are preprocessed into one NxHxWx3 input tensor, their styles are
+/// stacked along the batch dimension, and the model runs once; the output
+/// batch is split back into one result per stream
+///
+/// a batch keeps the device busy far better than one run per stream, the
+/// timeout bounds how long a slow or stalled camera holds back the others,
+/// which then run in a smaller batch
+///
+/// with setOutputStream() a stream's outputs are converted straight into a
+/// mapped texture upload buffer instead of Result::pixels, see TextureStream
+///
+/// all streams share the style transfer model & size, the style transfer
+/// background thread must not be running
+class StreamBatcher {
+	public:
+
+		/// stylized output frame of a stream
+		struct Result {
+			ofPixels pixels; ///< RGB output at the style transfer size, empty if streamed
+			FrameTimes times; ///< frame index & stage timestamps
+			bool streamed = false; ///< written into the output stream instead of pixels?
+		};
+
+		/// smoothed timings in ms per batch and counters
+		struct Stats {
+			double preprocess = 0; ///< input conversion of the batch
+			double inference = 0; ///< model run of the batch
+			double postprocess = 0; ///< readback & split of the batch
+			double latency = 0; ///< capture to output available
+			double batchSize = 0; ///< smoothed frames per batch
+			int streams = 0;
+			uint64_t batches = 0; ///< model runs
+			uint64_t partial = 0; ///< batches run at the timeout, without all streams
+			uint64_t submitted = 0; ///< frames accepted by submit()
+			uint64_t dropped = 0; ///< frames replaced by a newer one before batching
+			uint64_t completed = 0; ///< frames which reached the output
+			uint64_t failed = 0; ///< frames which failed inference
+		};
+
+		~StreamBatcher() {
+			stop();
+		}
+
+		/// start the batch thread for a number of streams, returns false if
+		/// already running
+		bool start(ofxStyleTransfer & styleTransfer, int streams, int timeoutMs=20) {
+			if(running) {
+				return false;
+			}
+			this->styleTransfer = &styleTransfer;
+			this->streams.clear();
+			for(int i = 0; i < std::min(std::max(streams, 1), (int)MAX_STREAMS); i++) {
+				this->streams.emplace_back(new Stream());
+			}
+			setTimeout(timeoutMs);
+			pending = 0;
+			running = true;
+			thread = std::thread(&StreamBatcher::batchLoop, this);
+			ofLogNotice("StreamBatcher") << "started with " << this->streams.size()
+				<< " streams, " << timeoutMs << " ms timeout";
+			return true;
+		}
+
+		/// stop and join the batch thread, waiting frames are discarded
+		void stop() {
+			if(!running) {
+				return;
+			}
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				running = false;
+			}
+			wake.notify_all();
+			for(auto & stream : streams) {
+				stream->results.close();
+			}
+			thread.join();
+			for(auto & stream : streams) {
+				stream->job = Job(); // release waiting camera buffers
+				stream->hasJob = false;
+			}
+		}
+
+		bool isRunning() const {return running;}
+
+		/// returns number of streams
+		int getStreams() const {return (int)streams.size();}
+
+		/// max wait in ms for the other streams after the first frame of a
+		/// batch arrived, 0 runs whatever is waiting at once
+		void setTimeout(int timeoutMs) {
+			timeout = std::max(timeoutMs, 0);
+		}
+
+		int getTimeout() const {return timeout;}
+
+		/// set the style of a stream, streams without a style use the style
+		/// transfer's current style, may be called while running
+		void setStyle(int stream, const ofxStyleTransfer::Style & style) {
+			if(stream < 0 || stream >= (int)streams.size() || !styleTransfer) {
+				return;
+			}
+			std::lock_guard<std::mutex> lock(mutex);
+			streams[stream]->style = styleTransfer->getStyleTensor(style);
+			streams[stream]->hasStyle = true;
+		}
+
+		/// write a stream's outputs into a texture stream's buffers instead of
+		/// Result::pixels, which are only filled if no buffer was free;
+		/// nullptr to disable, may be called while running
+		void setOutputStream(int stream, TextureStream * output) {
+			if(stream < 0 || stream >= (int)streams.size()) {
+				return;
+			}
+			std::lock_guard<std::mutex> lock(mutex);
+			streams[stream]->outputStream = output;
+		}
+
+		/// queue a frame of a stream, span must stay valid while owner is
+		/// held, see Frame::retain(); never blocks, a frame of the same
+		/// stream still waiting for a batch is replaced
+		bool submit(int stream, const PixelSpan & span, std::shared_ptr<void> owner,
+		            uint64_t index, uint64_t captureTime) {
+			if(!running || !span.isValid() || stream < 0 || stream >= (int)streams.size()) {
+				return false;
+			}
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				Stream & s = *streams[stream];
+				if(s.hasJob) {
+					dropped++;
+				}
+				else {
+					if(pending == 0) {
+						roundStart = std::chrono::steady_clock::now();
+					}
+					pending++;
+				}
+				s.job.span = span;
+				s.job.owner = owner;
+				s.job.times = FrameTimes();
+				s.job.times.index = index;
+				s.job.times.capture = captureTime;
+				s.job.times.submit = ofGetElapsedTimeMicros();
+				s.hasJob = true;
+			}
+			submitted++;
+			wake.notify_one();
+			return true;
+		}
+
+		/// returns true if a new output of a stream is available via
+		/// getOutput(), if several finished since the last call, the newest
+		/// is kept
+		bool poll(int stream) {
+			if(stream < 0 || stream >= (int)streams.size()) {
+				return false;
+			}
+			bool isNew = false;
+			Result result;
+			while(streams[stream]->results.tryPop(result)) {
+				streams[stream]->output = std::move(result);
+				isNew = true;
+			}
+			return isNew;
+		}
+
+		/// most recently polled output of a stream
+		Result & getOutput(int stream) {return streams[stream]->output;}
+
+		/// snapshot of batch timings and counters
+		Stats getStats() const {
+			Stats stats;
+			{
+				std::lock_guard<std::mutex> lock(statsMutex);
+				stats = timings;
+			}
+			stats.streams = (int)streams.size();
+			stats.submitted = submitted;
+			stats.dropped = dropped;
+			stats.completed = completed;
+			stats.failed = failed;
+			return stats;
+		}
+
+		static const int MAX_STREAMS = 8; ///< max streams per batch
+
+	protected:
+
+		/// a frame waiting for a batch
+		struct Job {
+			PixelSpan span;
+			std::shared_ptr<void> owner; ///< keeps span valid until preprocessed
+			FrameTimes times;
+		};
+
+		/// per stream state, guarded by mutex except for results & output
+		struct Stream {
+			Job job; ///< newest frame
+			bool hasJob = false; ///< is job waiting for a batch?
+			cppflow::tensor style; ///< style model input
+			bool hasStyle = false; ///< is style set?
+			TextureStream * outputStream = nullptr; ///< output buffers, if set
+			BoundedQueue<Result> results{1}; ///< finished frames
+			Result output; ///< most recently polled result, main thread only
+		};
+
+		/// gather waiting frames into batches until stopped
+		void batchLoop() {
+			warmUp();
+			std::vector<Job> jobs;
+			std::vector<int> ids;
+			std::vector<cppflow::tensor> styles;
+			std::vector<TextureStream *> outputs;
+			while(true) {
+				{
+					// wait for a first frame, then for the rest until the deadline
+					std::unique_lock<std::mutex> lock(mutex);
+					wake.wait(lock, [this] {return !running || pending > 0;});
+					wake.wait_until(lock, roundStart + std::chrono::milliseconds(timeout), [this] {
+						return !running || pending == (int)streams.size();
+					});
+					if(!running) {
+						break;
+					}
+					jobs.clear();
+					ids.clear();
+					styles.clear();
+					outputs.clear();
+					for(std::size_t i = 0; i < streams.size(); i++) {
+						Stream & s = *streams[i];
+						if(!s.hasJob) {
+							continue;
+						}
+						jobs.push_back(std::move(s.job));
+						ids.push_back((int)i);
+						styles.push_back(s.hasStyle ? s.style : styleTransfer->getStyleTensor());
+						outputs.push_back(s.outputStream);
+						s.hasJob = false;
+					}
+					pending = 0;
+				}
+				if(!processBatch(jobs, ids, styles, outputs)) {
+					break;
+				}
+			}
+		}
+
+		/// preprocess, run & split one batch, returns false if stopping
+		bool processBatch(std::vector<Job> & jobs, const std::vector<int> & ids,
+		                  const std::vector<cppflow::tensor> & styles,
+		                  const std::vector<TextureStream *> & outputs) {
+			const int count = (int)jobs.size();
+			const int modelWidth = styleTransfer->getModelWidth();
+			const int modelHeight = styleTransfer->getModelHeight();
+			const int width = styleTransfer->getOutputWidth();
+			const int height = styleTransfer->getOutputHeight();
+
+			// preprocess straight into the slices of one input tensor
+			uint64_t start = ofGetElapsedTimeMicros();
+			float * data = nullptr;
+			cppflow::tensor input = buffers.allocate({count, modelHeight, modelWidth, 3}, data);
+			const std::size_t slice = (std::size_t)modelWidth * modelHeight * 3;
+			for(int i = 0; i < count; i++) {
+				jobs[i].times.preprocessStart = start;
+				preprocess(jobs[i].span, data + i * slice, modelWidth, modelHeight);
+				jobs[i].owner.reset(); // release the camera buffer early
+			}
+			cppflow::tensor style = (count == 1 ? styles[0] : cppflow::concat(cppflow::tensor(0), styles));
+			uint64_t preprocessEnd = ofGetElapsedTimeMicros();
+
+			cppflow::tensor output;
+			try {
+				output = styleTransfer->run(input, style);
+			}
+			catch(const std::exception & e) {
+				ofLogError("StreamBatcher") << "inference failed for a batch of " << count << ": " << e.what();
+				failed += count;
+				return true;
+			}
+			uint64_t inferenceEnd = ofGetElapsedTimeMicros();
+
+			// resize the whole batch at once, then split it
+			std::vector<int64_t> shape = output.shape(); // NHWC
+			if(shape.size() != 4 || shape[0] != count || shape[3] != 3) {
+				ofLogError("StreamBatcher") << "Unexpected output tensor shape";
+				failed += count;
+				return true;
+			}
+			if(shape[2] != width || shape[1] != height) {
+				output = cppflow::resize_bicubic(output, cppflow::tensor({height, width}), true);
+			}
+			std::shared_ptr<TF_Tensor> outputData = output.get_tensor();
+			const float * out = (const float *)TF_TensorData(outputData.get());
+			for(int i = 0; i < count; i++) {
+				Result result;
+				result.times = jobs[i].times;
+				result.times.preprocessEnd = preprocessEnd;
+				result.times.inferenceStart = preprocessEnd;
+				result.times.inferenceEnd = inferenceEnd;
+				result.times.postprocessStart = inferenceEnd;
+				// convert straight into a mapped texture buffer if one is free
+				const float * stylized = out + (std::size_t)i * width * height * 3;
+				unsigned char * mapped = (outputs[i] ? outputs[i]->beginWrite(width, height, PixelSpan::RGB) : nullptr);
+				if(mapped) {
+					PixelKernels::toUnsignedChar(stylized, mapped, (std::size_t)width * height * 3);
+					outputs[i]->endWrite();
+					result.streamed = true;
+				}
+				else {
+					result.pixels.allocate(width, height, OF_PIXELS_RGB);
+					PixelKernels::toUnsignedChar(stylized, result.pixels.getData(), result.pixels.size());
+				}
+				result.times.postprocessEnd = ofGetElapsedTimeMicros();
+				addTiming(timings.latency, result.times.capture, result.times.postprocessEnd);
+				completed++;
+				streams[ids[i]]->results.pushLatest(std::move(result));
+			}
+			uint64_t end = ofGetElapsedTimeMicros();
+
+			addTiming(timings.preprocess, start, preprocessEnd);
+			addTiming(timings.inference, preprocessEnd, inferenceEnd);
+			addTiming(timings.postprocess, inferenceEnd, end);
+			{
+				std::lock_guard<std::mutex> lock(statsMutex);
+				timings.batchSize = (timings.batches == 0 ? count : timings.batchSize * 0.9 + count * 0.1);
+				timings.batches++;
+				if(count < (int)streams.size()) {
+					timings.partial++;
+				}
+			}
+			return running;
+		}
+
+		/// run every batch size once so the first batches of the show do
+		/// not pay for graph setup
+		void warmUp() {
+			const int modelWidth = styleTransfer->getModelWidth();
+			const int modelHeight = styleTransfer->getModelHeight();
+			cppflow::tensor style = styleTransfer->getStyleTensor();
+			for(int count = 2; count <= (int)streams.size() && running; count++) {
+				float * data = nullptr;
+				cppflow::tensor input = buffers.allocate({count, modelHeight, modelWidth, 3}, data);
+				std::fill(data, data + (std::size_t)count * modelWidth * modelHeight * 3, 0.f);
+				try {
+					styleTransfer->run(input, style);
+				}
+				catch(const std::exception & e) {
+					ofLogWarning("StreamBatcher") << "warm-up with batch " << count << " failed: " << e.what();
+					return;
+				}
+			}
+		}
+
+		/// smooth a time from start until end in us into value, in ms
+		void addTiming(double & value, uint64_t start, uint64_t end) {
+			double ms = (end - start) / 1000.0;
+			std::lock_guard<std::mutex> lock(statsMutex);
+			value = (value == 0 ? ms : value * 0.9 + ms * 0.1);
+		}
+
+		ofxStyleTransfer * styleTransfer = nullptr;
+		TensorBufferPool buffers; ///< batch input tensors, batch thread only
+		std::vector<std::unique_ptr<Stream>> streams;
+		std::thread thread;
+
+		std::atomic<bool> running{false};
+		std::atomic<int> timeout{20}; ///< ms
+		std::mutex mutex; ///< guards waiting frames & styles
+		std::condition_variable wake;
+		int pending = 0; ///< streams with a waiting frame, guarded by mutex
+		std::chrono::steady_clock::time_point roundStart; ///< first frame of the batch arrived
+
+		mutable std::mutex statsMutex;
+		Stats timings; ///< guarded by statsMutex
+		std::atomic<uint64_t> submitted{0};
+		std::atomic<uint64_t> dropped{0};
+		std::atomic<uint64_t> completed{0};
+		std::atomic<uint64_t> failed{0};
+};
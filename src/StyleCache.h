@@ -0,0 +1,139 @@
+/*
+ * AI Dance Mirror
+ *
+ * Prepared style cache.
+ */
+#pragma once
+
+#include "ofxStyleTransfer.h"
+#include "StylePack.h"
+#include <sys/stat.h>
+
+/// \class StyleCache
+/// \brief keeps prepared styles so switching styles is instant
+///
+/// entries are keyed by path and file modification time: a style image is
+/// decoded, resized, and (for split models) run through the style prediction
+/// network only the first time it is used or after the file has changed
+///
+/// with a style pack set, misses are served from the pack by file name as
+/// long as the image on disk is missing or unchanged since the pack was built
+class StyleCache {
+	public:
+
+		/// serve cache misses from a precompiled style pack, ignored if the
+		/// pack does not match the model (style images vs. bottlenecks)
+		void setPack(std::shared_ptr<StylePack> pack, const ofxStyleTransfer & styleTransfer) {
+			this->pack = (pack && isCompatible(*pack, styleTransfer) ? pack : nullptr);
+		}
+
+		/// do the pack's entries match the model (style images vs.
+		/// bottlenecks)? logs a warning if not
+		static bool isCompatible(const StylePack & pack, const ofxStyleTransfer & styleTransfer) {
+			if(pack.hasBottlenecks() != styleTransfer.usesStyleBottleneck()) {
+				ofLogWarning("StyleCache") << "ignoring style pack, "
+					<< (pack.hasBottlenecks() ? "bottleneck" : "image")
+					<< " entries do not match the model";
+				return false;
+			}
+			return true;
+		}
+
+		/// returns current style pack or nullptr
+		std::shared_ptr<StylePack> getPack() const {return pack;}
+
+		/// prepare and cache all given styles up front, missing or broken
+		/// files are skipped, returns the number of cached styles
+		std::size_t preload(const std::vector<std::string> & paths, ofxStyleTransfer & styleTransfer) {
+			std::size_t count = 0;
+			for(const auto & path : paths) {
+				if(get(path, styleTransfer)) {
+					count++;
+				}
+			}
+			return count;
+		}
+
+		/// get prepared style for path, prepares it on a cache miss or if the
+		/// file changed since it was cached, returns nullptr if the style image
+		/// could not be loaded
+		const ofxStyleTransfer::Style * get(const std::string & path, ofxStyleTransfer & styleTransfer) {
+			int64_t mtime = modificationTime(path);
+			auto it = entries.find(path);
+			if(it != entries.end() && it->second.mtime == mtime) {
+				hits++;
+				return &it->second.style;
+			}
+			misses++;
+
+			ofxStyleTransfer::Style style;
+			if(!prepare(path, mtime, styleTransfer, pack.get(), style)) {
+				return nullptr;
+			}
+			Entry & entry = entries[path];
+			entry.mtime = mtime;
+			entry.style = style;
+			return &entry.style;
+		}
+
+		/// prepare the style at path with modification time mtime: from the
+		/// pack by file name if the image on disk is missing or unchanged
+		/// since the pack was built, otherwise by decoding the image;
+		/// returns false if neither worked
+		///
+		/// touches no cache state, so it may run on several threads at once
+		static bool prepare(const std::string & path, int64_t mtime, ofxStyleTransfer & styleTransfer,
+		                    const StylePack * pack, ofxStyleTransfer::Style & style) {
+			if(pack) {
+				int index = pack->find(ofFilePath::getFileName(path));
+				if(index >= 0 && (mtime < 0 || mtime == pack->getModificationTime(index))) {
+					style = pack->getStyle(index);
+					return true;
+				}
+			}
+
+			ofPixels pixels;
+			if(mtime < 0 || !ofLoadImage(pixels, path)) {
+				ofLogError("StyleCache") << "failed to load style image: " << path;
+				return false;
+			}
+			if(pixels.getNumChannels() != 3) {
+				pixels.setImageType(OF_IMAGE_COLOR);
+			}
+			style = styleTransfer.prepareStyle(pixels);
+			ofLogVerbose("StyleCache") << "prepared " << path;
+			return true;
+		}
+
+		/// remove all entries
+		void clear() {
+			entries.clear();
+		}
+
+		/// number of cached styles
+		std::size_t size() const {return entries.size();}
+
+		std::size_t getHits() const {return hits;} ///< lookups served from cache
+		std::size_t getMisses() const {return misses;} ///< lookups which prepared a style
+
+		/// file modification time in ns or -1 if the file does not exist
+		static int64_t modificationTime(const std::string & path) {
+			struct stat info;
+			if(stat(ofToDataPath(path, true).c_str(), &info) != 0) {
+				return -1;
+			}
+			return (int64_t)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+		}
+
+	private:
+
+		struct Entry {
+			int64_t mtime = -1; ///< file modification time when prepared
+			ofxStyleTransfer::Style style;
+		};
+		std::map<std::string, Entry> entries; ///< by path
+		std::shared_ptr<StylePack> pack; ///< optional precompiled styles
+
+		std::size_t hits = 0;
+		std::size_t misses = 0;
+};
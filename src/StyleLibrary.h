@@ -0,0 +1,355 @@
+/*
+ * AI Dance Mirror
+ *
+ * Watched style image folder, prepared on background threads.
+ */
+#pragma once
+
+#include "StyleCache.h"
+#include "BoundedQueue.h"
+#include <atomic>
+#include <condition_variable>
+#include <set>
+#include <thread>
+#ifdef __linux__
+	#include <sys/inotify.h>
+	#include <poll.h>
+	#include <unistd.h>
+#endif
+
+/// \class StyleLibrary
+/// \brief the styles of an image folder, kept up to date while running
+///
+/// the folder is scanned at start() and then watched with inotify (rescanned
+/// when the event queue overflows, polled every POLL_MS where inotify is not
+/// available or the watch is lost): new or changed images are
+/// decoded and prepared by a small pool of decode threads, deleted images
+/// leave the library; entries of a style pack are used for images which are
+/// missing or unchanged since the pack was built, see StyleCache::prepare()
+///
+/// the library is published as an immutable, name sorted snapshot which is
+/// replaced as a whole for every change, so readers never see a half updated
+/// list and never wait for disk or image decode; getVersion() tells when to
+/// fetch a new snapshot
+class StyleLibrary {
+	public:
+
+		/// a prepared style
+		struct Entry {
+			std::string path; ///< folder / file name
+			std::string name; ///< file name
+			int64_t mtime = -1; ///< file modification time, -1 if from the pack only
+			uint64_t version = 0; ///< library version which added or changed it
+			ofxStyleTransfer::Style style;
+		};
+		typedef std::vector<Entry> Entries;
+
+		~StyleLibrary() {
+			stop();
+		}
+
+		/// scan directory and start watching it with threads decode threads,
+		/// pack may be nullptr; returns false if already running
+		bool start(ofxStyleTransfer & styleTransfer, const std::string & directory,
+		           std::shared_ptr<StylePack> pack=nullptr, int threads=2) {
+			if(running) {
+				return false;
+			}
+			this->styleTransfer = &styleTransfer;
+			this->directory = directory;
+			this->pack = pack;
+			usePack = true;
+			running = true;
+			jobs.reset();
+			jobs.setCapacity(MAX_JOBS);
+			for(int i = 0; i < std::max(threads, 1); i++) {
+				workers.emplace_back(&StyleLibrary::decodeLoop, this);
+			}
+			scan();
+			if(pack) {
+				// pack entries whose images are not in the folder
+				for(std::size_t i = 0; i < pack->getCount(); i++) {
+					enqueue(ofFilePath::join(directory, pack->getName(i)));
+				}
+			}
+			watcher = std::thread(&StyleLibrary::watchLoop, this);
+			return true;
+		}
+
+		/// stop watching & decoding, waits for running decodes
+		void stop() {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if(!running) {
+					return;
+				}
+				running = false;
+			}
+			wake.notify_all();
+			if(watcher.joinable()) {
+				watcher.join();
+			}
+			jobs.close();
+			for(auto & worker : workers) {
+				worker.join();
+			}
+			workers.clear();
+			std::lock_guard<std::mutex> lock(mutex);
+			queued.clear(); // dropped jobs
+			requeue.clear();
+		}
+
+		/// block until all queued images are prepared, ie. after start()
+		void waitIdle() {
+			std::unique_lock<std::mutex> lock(mutex);
+			idle.wait(lock, [this] {return !running || (queued.empty() && decoding.empty());});
+		}
+
+		/// prepare all images of the library again, ie. after the model was
+		/// swapped for one with another style prediction network; with
+		/// usePack false the style pack is no longer used as it was built
+		/// with the old model, entries only found in the pack are kept as
+		/// they are, returns the number of queued images
+		std::size_t reprepare(bool usePack) {
+			this->usePack = this->usePack && usePack;
+			std::shared_ptr<const Entries> current = getEntries();
+			std::size_t count = 0;
+			for(auto & entry : *current) {
+				if(entry.mtime >= 0 || this->usePack) {
+					enqueue(entry.path);
+					count++;
+				}
+			}
+			return count;
+		}
+
+		/// current library, sorted by file name, never changes
+		std::shared_ptr<const Entries> getEntries() const {
+			std::lock_guard<std::mutex> lock(mutex);
+			return entries;
+		}
+
+		/// incremented for every change of the library
+		uint64_t getVersion() const {return version;}
+
+		/// copy the style at path from the current library, returns false if
+		/// it is not in the library
+		bool find(const std::string & path, ofxStyleTransfer::Style & style) const {
+			std::shared_ptr<const Entries> current = getEntries();
+			for(auto & entry : *current) {
+				if(entry.path == path) {
+					style = entry.style;
+					return true;
+				}
+			}
+			return false;
+		}
+
+		const std::string & getDirectory() const {return directory;}
+
+		/// is the file an image the library picks up?
+		static bool isImage(const std::string & path) {
+			std::string ext = ofToLower(ofFilePath::getFileExt(path));
+			return ext == "png" || ext == "jpg" || ext == "jpeg" || ext == "bmp" || ext == "tif" || ext == "tiff";
+		}
+
+		static const int POLL_MS = 2000; ///< rescan interval without inotify
+		static const int WATCH_MS = 200; ///< max inotify wait, bounds stop()
+		static const std::size_t MAX_JOBS = 4096; ///< queued images
+
+	protected:
+
+		/// queue an image unless it is queued already
+		void enqueue(const std::string & path) {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if(!queued.insert(path).second) {
+					return;
+				}
+			}
+			if(!jobs.push(path)) {
+				std::lock_guard<std::mutex> lock(mutex);
+				queued.erase(path);
+			}
+		}
+
+		/// queue new & changed images and entries whose image is gone
+		void scan() {
+			std::set<std::string> found;
+			ofDirectory dir(directory);
+			if(dir.exists()) {
+				dir.listDir();
+				for(std::size_t i = 0; i < dir.size(); i++) {
+					if(isImage(dir.getName(i))) {
+						found.insert(ofFilePath::join(directory, dir.getName(i)));
+					}
+				}
+			}
+			std::shared_ptr<const Entries> current = getEntries();
+			for(auto & entry : *current) {
+				if(!found.count(entry.path) && entry.mtime >= 0) {
+					enqueue(entry.path); // deleted, or served from the pack
+				}
+			}
+			for(auto & path : found) {
+				auto it = std::find_if(current->begin(), current->end(),
+				                       [&](const Entry & entry) {return entry.path == path;});
+				if(it == current->end() || it->mtime != StyleCache::modificationTime(path)) {
+					enqueue(path);
+				}
+			}
+		}
+
+		/// queue images as the folder changes
+		void watchLoop() {
+		#ifdef __linux__
+			int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+			if(fd >= 0 && inotify_add_watch(fd, ofToDataPath(directory, true).c_str(),
+			                                IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE) >= 0) {
+				// a file is picked up once it has been written & closed, or
+				// renamed into the folder
+				alignas(inotify_event) char buffer[4096];
+				bool watching = true;
+				while(running && watching) {
+					pollfd events = {fd, POLLIN, 0};
+					if(poll(&events, 1, WATCH_MS) <= 0) {
+						continue;
+					}
+					ssize_t length = read(fd, buffer, sizeof(buffer));
+					bool overflow = false;
+					for(ssize_t offset = 0; offset < length; ) {
+						const inotify_event * event = (const inotify_event *)(buffer + offset);
+						if(event->mask & IN_Q_OVERFLOW) {
+							overflow = true; // events were dropped
+						}
+						else if(event->mask & IN_IGNORED) {
+							watching = false; // folder removed or unmounted
+						}
+						else if(event->len > 0 && isImage(event->name)) {
+							enqueue(ofFilePath::join(directory, event->name));
+						}
+						offset += sizeof(inotify_event) + event->len;
+					}
+					if(overflow || !watching) {
+						scan(); // catch up on whatever was missed
+					}
+				}
+				close(fd);
+				if(watching) {
+					return;
+				}
+				ofLogWarning("StyleLibrary") << "lost the watch on " << directory << ", rescanning every "
+					<< (int)POLL_MS << " ms";
+			}
+			else {
+				if(fd >= 0) {
+					close(fd);
+				}
+				ofLogWarning("StyleLibrary") << "cannot watch " << directory << ", rescanning every "
+					<< (int)POLL_MS << " ms";
+			}
+		#endif
+			while(true) {
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					if(wake.wait_for(lock, std::chrono::milliseconds((int)POLL_MS), [this] {return !running;})) {
+						return;
+					}
+				}
+				scan();
+			}
+		}
+
+		/// prepare queued images and publish the results
+		void decodeLoop() {
+			std::string path;
+			while(jobs.pop(path)) {
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					queued.erase(path); // a change from here on queues it again
+					if(!running) {
+						continue; // stopping, drop the rest
+					}
+					if(!decoding.insert(path).second) {
+						// changed while another worker prepares it: queue it
+						// again once that one is done, not in parallel
+						requeue.insert(path);
+						continue;
+					}
+				}
+				Entry entry;
+				entry.path = path;
+				entry.name = ofFilePath::getFileName(path);
+				entry.mtime = StyleCache::modificationTime(path);
+				const StylePack * styles = (usePack ? pack.get() : nullptr);
+				bool packed = (styles && styles->find(entry.name) >= 0);
+				if((entry.mtime >= 0 || packed) &&
+				   StyleCache::prepare(path, entry.mtime, *styleTransfer, styles, entry.style)) {
+					publish(&entry, path);
+				}
+				else {
+					publish(nullptr, path);
+				}
+				bool again = false;
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					decoding.erase(path);
+					again = (requeue.erase(path) > 0 && running && queued.insert(path).second);
+				}
+				if(again && !jobs.push(path)) {
+					std::lock_guard<std::mutex> lock(mutex);
+					queued.erase(path);
+				}
+				idle.notify_all();
+			}
+		}
+
+		/// replace the snapshot with entry added or changed, or with path
+		/// removed if entry is nullptr
+		void publish(Entry * entry, const std::string & path) {
+			std::lock_guard<std::mutex> lock(mutex);
+			std::shared_ptr<Entries> next = std::make_shared<Entries>(*entries);
+			auto it = std::find_if(next->begin(), next->end(), [&](const Entry & e) {return e.path == path;});
+			if(!entry) {
+				if(it == next->end()) {
+					return;
+				}
+				next->erase(it);
+				ofLogNotice("StyleLibrary") << "removed " << path;
+			}
+			else {
+				entry->version = version + 1;
+				if(it != next->end()) {
+					*it = std::move(*entry);
+					ofLogNotice("StyleLibrary") << "updated " << path;
+				}
+				else {
+					auto position = std::lower_bound(next->begin(), next->end(), *entry,
+						[](const Entry & a, const Entry & b) {return a.name < b.name;});
+					next->insert(position, std::move(*entry));
+					ofLogVerbose("StyleLibrary") << "added " << path;
+				}
+			}
+			entries = next;
+			version++;
+		}
+
+		ofxStyleTransfer * styleTransfer = nullptr;
+		std::string directory;
+		std::shared_ptr<StylePack> pack; ///< optional precompiled styles
+		std::atomic<bool> usePack{true}; ///< is the pack still valid for the model?
+
+		std::thread watcher;
+		std::vector<std::thread> workers; ///< decode pool
+		BoundedQueue<std::string> jobs; ///< images to prepare
+		std::set<std::string> queued; ///< images in jobs, guarded by mutex
+		std::set<std::string> decoding; ///< images being prepared, guarded by mutex
+		std::set<std::string> requeue; ///< changed while being prepared, guarded by mutex
+
+		std::shared_ptr<const Entries> entries = std::make_shared<Entries>(); ///< guarded by mutex
+		std::atomic<uint64_t> version{0};
+		std::atomic<bool> running{false};
+		mutable std::mutex mutex;
+		std::condition_variable wake; ///< stops the polling watcher
+		std::condition_variable idle; ///< all queued images prepared
+};
@@ -0,0 +1,341 @@
+/*
+ * AI Dance Mirror
+ *
+ * Memory-mapped style library pack.
+ */
+#pragma once
+
+#include "ofxStyleTransfer.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/// style pack file layout, all values little endian:
+///
+///   Header
+///   Entry[count]
+///   entry data, each block aligned to StylePackFormat::ALIGNMENT
+///
+/// every entry holds one prepared style: either the 1x256x256x3 style image
+/// or the style bottleneck computed by a split model, stored as float32 or,
+/// for style images only, as uint8 quantized to 0-255: bottleneck values are
+/// unbounded and signed
+namespace StylePackFormat {
+
+	static const char MAGIC[8] = {'D', 'M', 'S', 'T', 'Y', 'L', 'E', 'S'};
+	static const uint32_t VERSION = 1;
+	static const uint32_t NAME_SIZE = 96; ///< max entry name length incl. '\0'
+	static const uint64_t ALIGNMENT = 64; ///< entry data alignment in bytes
+
+	/// what the entries hold
+	enum Kind : uint32_t {
+		KIND_IMAGE = 0, ///< prepared style image
+		KIND_BOTTLENECK = 1 ///< style bottleneck vector
+	};
+
+	/// entry data type
+	enum Type : uint32_t {
+		TYPE_FLOAT32 = 0,
+		TYPE_UINT8 = 1 ///< value * 255, rounded & clamped
+	};
+
+	struct Header {
+		char magic[8];
+		uint32_t version;
+		uint32_t count; ///< number of entries
+		uint32_t kind; ///< Kind
+		uint32_t type; ///< Type
+		int64_t shape[4]; ///< tensor shape of every entry
+		uint64_t entriesOffset; ///< Entry table offset from file start
+		uint8_t reserved[8];
+	};
+
+	struct Entry {
+		char name[NAME_SIZE]; ///< style image file name, '\0' terminated
+		uint64_t offset; ///< data offset from file start
+		uint64_t size; ///< data size in bytes
+		int64_t mtime; ///< source image modification time in ns
+		uint8_t reserved[8];
+	};
+
+	static_assert(sizeof(Header) == 72, "unexpected style pack header size");
+	static_assert(sizeof(Entry) == 128, "unexpected style pack entry size");
+
+	/// number of values in a tensor of the given shape
+	inline uint64_t numValues(const int64_t shape[4]) {
+		return (uint64_t)(shape[0] * shape[1] * shape[2] * shape[3]);
+	}
+}
+
+/// \class StylePackWriter
+/// \brief collects prepared styles and writes a style pack file
+class StylePackWriter {
+	public:
+
+		StylePackWriter(StylePackFormat::Kind kind, StylePackFormat::Type type) :
+			kind(kind), type(type) {}
+
+		/// add entry from prepared style tensor values, all entries must have
+		/// the same shape, returns false on mismatch, if the name is too long,
+		/// or for uint8 bottlenecks
+		bool add(const std::string & name, const cppflow::tensor & tensor, int64_t mtime) {
+			if(!isSupported(kind, type)) {
+				ofLogError("StylePackWriter") << "style bottlenecks can not be stored as uint8";
+				return false;
+			}
+			std::vector<int64_t> tensorShape = tensor.shape();
+			if(tensorShape.size() > 4 || name.size() >= StylePackFormat::NAME_SIZE) {
+				ofLogError("StylePackWriter") << "can not add " << name;
+				return false;
+			}
+			int64_t entryShape[4] = {1, 1, 1, 1};
+			std::copy(tensorShape.begin(), tensorShape.end(), entryShape + 4 - tensorShape.size());
+			if(items.empty()) {
+				std::copy(entryShape, entryShape + 4, shape);
+			}
+			else if(!std::equal(entryShape, entryShape + 4, shape)) {
+				ofLogError("StylePackWriter") << "shape mismatch for " << name;
+				return false;
+			}
+
+			Item item;
+			item.name = name;
+			item.mtime = mtime;
+			std::vector<float> values = tensor.get_data<float>();
+			if(type == StylePackFormat::TYPE_UINT8) {
+				item.data.resize(values.size());
+				for(std::size_t i = 0; i < values.size(); i++) {
+					item.data[i] = (uint8_t)ofClamp(std::round(values[i] * 255.f), 0.f, 255.f);
+				}
+			}
+			else {
+				item.data.resize(values.size() * sizeof(float));
+				std::memcpy(item.data.data(), values.data(), item.data.size());
+			}
+			items.push_back(std::move(item));
+			return true;
+		}
+
+		/// write pack file, returns true on success
+		bool write(const std::string & path) {
+			StylePackFormat::Header header = {};
+			std::memcpy(header.magic, StylePackFormat::MAGIC, sizeof(header.magic));
+			header.version = StylePackFormat::VERSION;
+			header.count = items.size();
+			header.kind = kind;
+			header.type = type;
+			std::copy(shape, shape + 4, header.shape);
+			header.entriesOffset = sizeof(header);
+
+			std::vector<StylePackFormat::Entry> entries(items.size());
+			uint64_t offset = align(header.entriesOffset + entries.size() * sizeof(StylePackFormat::Entry));
+			for(std::size_t i = 0; i < items.size(); i++) {
+				StylePackFormat::Entry & entry = entries[i];
+				std::memset(&entry, 0, sizeof(entry));
+				std::strncpy(entry.name, items[i].name.c_str(), StylePackFormat::NAME_SIZE - 1);
+				entry.offset = offset;
+				entry.size = items[i].data.size();
+				entry.mtime = items[i].mtime;
+				offset = align(offset + entry.size);
+			}
+
+			std::ofstream file(ofToDataPath(path, true), std::ios::binary | std::ios::trunc);
+			if(!file) {
+				ofLogError("StylePackWriter") << "could not open " << path;
+				return false;
+			}
+			file.write((const char *)&header, sizeof(header));
+			file.write((const char *)entries.data(), entries.size() * sizeof(StylePackFormat::Entry));
+			for(std::size_t i = 0; i < items.size(); i++) {
+				pad(file, entries[i].offset);
+				file.write((const char *)items[i].data.data(), items[i].data.size());
+			}
+			pad(file, offset);
+			if(!file) {
+				ofLogError("StylePackWriter") << "failed writing " << path;
+				return false;
+			}
+			return true;
+		}
+
+		/// number of added entries
+		std::size_t size() const {return items.size();}
+
+		/// can entries of this kind be stored as this type? uint8 only holds
+		/// the 0 - 1 range of style images
+		static bool isSupported(StylePackFormat::Kind kind, StylePackFormat::Type type) {
+			return !(kind == StylePackFormat::KIND_BOTTLENECK && type == StylePackFormat::TYPE_UINT8);
+		}
+
+	private:
+
+		static uint64_t align(uint64_t offset) {
+			return (offset + StylePackFormat::ALIGNMENT - 1) & ~(StylePackFormat::ALIGNMENT - 1);
+		}
+
+		static void pad(std::ofstream & file, uint64_t offset) {
+			while((uint64_t)file.tellp() < offset) {
+				file.put(0);
+			}
+		}
+
+		struct Item {
+			std::string name;
+			int64_t mtime = 0;
+			std::vector<uint8_t> data;
+		};
+		std::vector<Item> items;
+		StylePackFormat::Kind kind;
+		StylePackFormat::Type type;
+		int64_t shape[4] = {1, 1, 1, 1};
+};
+
+/// \class StylePack
+/// \brief read-only memory-mapped style pack
+///
+/// opening a pack only maps the file and validates the entry table, entry
+/// data is paged in when a style is first converted to a tensor
+class StylePack {
+	public:
+
+		StylePack() {}
+		StylePack(const StylePack &) = delete;
+		StylePack & operator=(const StylePack &) = delete;
+
+		~StylePack() {
+			close();
+		}
+
+		/// map pack file, returns true on success
+		bool open(const std::string & path) {
+			close();
+			std::string file = ofToDataPath(path, true);
+			int fd = ::open(file.c_str(), O_RDONLY);
+			if(fd < 0) {
+				return false;
+			}
+			struct stat info;
+			if(fstat(fd, &info) == 0 && info.st_size > 0) {
+				size = info.st_size;
+				void * mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+				data = (mapped == MAP_FAILED ? nullptr : (const uint8_t *)mapped);
+			}
+			::close(fd);
+			if(!data || !validate()) {
+				ofLogError("StylePack") << "invalid style pack: " << path;
+				close();
+				return false;
+			}
+			ofLogNotice("StylePack") << "mapped " << getCount() << " styles from " << path;
+			return true;
+		}
+
+		/// unmap pack file
+		void close() {
+			if(data) {
+				munmap((void *)data, size);
+			}
+			data = nullptr;
+			size = 0;
+		}
+
+		bool isOpen() const {return data != nullptr;}
+
+		/// number of entries
+		std::size_t getCount() const {return data ? header()->count : 0;}
+
+		/// entry name, the style image file name
+		std::string getName(std::size_t index) const {return entry(index)->name;}
+
+		/// source image modification time in ns when the pack was written
+		int64_t getModificationTime(std::size_t index) const {return entry(index)->mtime;}
+
+		/// entry index by name or -1 if not found
+		int find(const std::string & name) const {
+			for(std::size_t i = 0; i < getCount(); i++) {
+				if(name == entry(i)->name) {
+					return i;
+				}
+			}
+			return -1;
+		}
+
+		/// returns true if the entries hold style bottlenecks
+		bool hasBottlenecks() const {
+			return data && header()->kind == StylePackFormat::KIND_BOTTLENECK;
+		}
+
+		/// convert entry to a prepared style
+		ofxStyleTransfer::Style getStyle(std::size_t index) const {
+			const StylePackFormat::Header * h = header();
+			const StylePackFormat::Entry * e = entry(index);
+			uint64_t count = StylePackFormat::numValues(h->shape);
+			std::vector<float> values(count);
+			if(h->type == StylePackFormat::TYPE_UINT8) {
+				const uint8_t * src = data + e->offset;
+				for(uint64_t i = 0; i < count; i++) {
+					values[i] = src[i] * (1.0f / 255.f);
+				}
+			}
+			else {
+				std::memcpy(values.data(), data + e->offset, count * sizeof(float));
+			}
+
+			ofxStyleTransfer::Style style;
+			cppflow::tensor tensor(values, {h->shape[0], h->shape[1], h->shape[2], h->shape[3]});
+			if(hasBottlenecks()) {
+				style.bottleneck = tensor;
+				style.hasBottleneck = true;
+			}
+			else {
+				style.image = tensor;
+			}
+			return style;
+		}
+
+	private:
+
+		const StylePackFormat::Header * header() const {
+			return (const StylePackFormat::Header *)data;
+		}
+
+		const StylePackFormat::Entry * entry(std::size_t index) const {
+			return (const StylePackFormat::Entry *)(data + header()->entriesOffset) + index;
+		}
+
+		/// check header & entry table bounds
+		bool validate() const {
+			if(size < sizeof(StylePackFormat::Header)) {
+				return false;
+			}
+			const StylePackFormat::Header * h = header();
+			if(std::memcmp(h->magic, StylePackFormat::MAGIC, sizeof(h->magic)) != 0 ||
+			   h->version != StylePackFormat::VERSION ||
+			   h->type > StylePackFormat::TYPE_UINT8 ||
+			   !StylePackWriter::isSupported((StylePackFormat::Kind)h->kind, (StylePackFormat::Type)h->type)) {
+				return false;
+			}
+			for(int i = 0; i < 4; i++) {
+				if(h->shape[i] < 1) {
+					return false;
+				}
+			}
+			if(h->entriesOffset + (uint64_t)h->count * sizeof(StylePackFormat::Entry) > size) {
+				return false;
+			}
+			uint64_t entrySize = StylePackFormat::numValues(h->shape) *
+				(h->type == StylePackFormat::TYPE_UINT8 ? 1 : sizeof(float));
+			for(std::size_t i = 0; i < h->count; i++) {
+				const StylePackFormat::Entry * e = entry(i);
+				if(e->size != entrySize || e->offset + e->size > size ||
+				   e->name[StylePackFormat::NAME_SIZE - 1] != '\0') {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		const uint8_t * data = nullptr; ///< mapped file
+		std::size_t size = 0; ///< mapped size
+};
@@ -0,0 +1,759 @@
+/*
+ * AI Dance Mirror
+ *
+ * Staged style transfer pipeline with multiple frames in flight.
+ */
+#pragma once
+
+#include "ofxStyleTransfer.h"
+#include "BoundedQueue.h"
+#include "ModelSession.h"
+#include "InferenceDevice.h"
+#include "FrameProfiler.h"
+#include "GuidedUpsampler.h"
+#include "TextureStream.h"
+#include <functional>
+#include <future>
+#include <map>
+#include <thread>
+
+/// \class StylePipeline
+/// \brief runs preprocess, inference, and postprocess on separate threads
+///
+/// frames flow through bounded FIFO queues, one thread per stage, so while
+/// one frame is in the model the next is already being converted and the
+/// previous one is being read back: throughput is set by the slowest stage
+/// instead of the sum of all stages, outputs arrive in submission order
+///
+///     submit() -> [input] -> preprocess -> [tensors] -> inference
+///              -> [outputs] -> postprocess -> [results] -> poll()
+///
+/// depth is the latency vs. throughput knob: at most depth frames are in
+/// flight between preprocess start and postprocess finish, a frame waiting
+/// for a free slot is replaced by a newer one (unless frame dropping is
+/// disabled), so depth 1 gives the lowest glass-to-glass latency and 2-3 keeps every
+/// stage busy at the cost of one extra frame of latency per step
+///
+/// on CPU-only machines a single session does not keep all cores busy with a
+/// small batch, setWorkers() runs several inference threads instead, each
+/// with its own ModelSession pinned to its own set of cores; idle workers
+/// take the next tensor from the shared queue and a reorder buffer before
+/// postprocessing restores submission order, keep depth above the number of
+/// workers so every worker has a frame
+///
+/// with setRegions() enabled a frame may be submitted with a region: only
+/// that crop, grown to 1/4, 1/2 or all of the model size per side at model
+/// scale so only a few input shapes occur & are warmed up, runs through the
+/// model and the result is blended into a copy of the previous output with
+/// feathered edges, see ChangeDetector & DancerRegion
+///
+/// with setUpsampling() the outputs are produced at the size of the submitted
+/// frames instead of the style transfer output size, by upsampling the model output
+/// with the frame as guide, see GuidedUpsampler; the model then runs at the
+/// style transfer size, ie. a fraction of the camera resolution
+///
+/// with setOutputStream() outputs are converted straight into a mapped
+/// texture upload buffer instead of Result::pixels, see TextureStream
+///
+/// the style transfer background thread must not be running, the style
+/// may be changed while the pipeline runs
+class StylePipeline {
+	public:
+
+		/// stylized output frame
+		struct Result {
+			ofPixels pixels; ///< RGB output at the input size, empty if streamed
+			FrameTimes times; ///< frame index & stage timestamps
+			bool streamed = false; ///< written into the output stream instead of pixels?
+		};
+
+		/// smoothed stage timings in ms and counters
+		struct Stats {
+			double preprocess = 0; ///< input conversion time
+			double inference = 0; ///< model run time of full frames
+			double regionInference = 0; ///< model run time of regions
+			double postprocess = 0; ///< readback & conversion time
+			double latency = 0; ///< capture to output available
+			int depth = 0; ///< max frames in flight
+			int workers = 0; ///< inference threads
+			uint64_t submitted = 0; ///< frames accepted by submit()
+			uint64_t dropped = 0; ///< frames replaced before processing
+			uint64_t completed = 0; ///< frames which reached the output
+			uint64_t failed = 0; ///< frames which failed inference
+			uint64_t reordered = 0; ///< frames which finished out of order
+			uint64_t regions = 0; ///< partial frames blended into the previous output
+		};
+
+		/// inference worker settings, see setWorkers()
+		struct WorkerOptions {
+			int workers = 1; ///< inference threads, 1 uses the main model
+			int intraOpThreads = 0; ///< per session, 0 for cores per worker
+			int interOpThreads = 0; ///< per session, 0 for 1
+			bool pin = true; ///< pin each worker to its own cores?
+		};
+
+		~StylePipeline() {
+			stop();
+		}
+
+		/// start the stage threads, returns false if already running
+		bool start(ofxStyleTransfer & styleTransfer, int depth=2, bool dropFrames=true) {
+			if(running) {
+				return false;
+			}
+			this->styleTransfer = &styleTransfer;
+			this->dropFrames = dropFrames;
+			input.reset();
+			tensors.reset();
+			outputs.reset();
+			results.reset();
+			inFlight = 0;
+			running = true;
+			if(workerOptions.workers > 1 && depth <= workerOptions.workers) {
+				depth = workerOptions.workers + 1;
+				ofLogNotice("StylePipeline") << "depth raised to " << depth
+					<< " to keep " << workerOptions.workers << " workers busy";
+			}
+			setDepth(depth);
+			nextSequence = 0;
+			fullWidth = fullHeight = 0;
+			previous.clear();
+			threads.emplace_back(&StylePipeline::preprocessStage, this);
+			if(workerOptions.workers > 1) {
+				for(int i = 0; i < workerOptions.workers; i++) {
+					threads.emplace_back(&StylePipeline::workerStage, this, i);
+				}
+			}
+			else {
+				threads.emplace_back(&StylePipeline::inferenceStage, this);
+			}
+			threads.emplace_back(&StylePipeline::postprocessStage, this);
+			ofLogNotice("StylePipeline") << "started with depth " << getDepth();
+			return true;
+		}
+
+		/// run inference on several workers with their own sessions, call
+		/// before start(), raises the depth to workers + 1 if lower
+		void setWorkers(const WorkerOptions & options) {
+			workerOptions = options;
+			workerOptions.workers = std::max(options.workers, 1);
+		}
+
+		/// returns number of inference threads
+		int getWorkers() const {return workerOptions.workers;}
+
+		/// accept submit() regions, keeps a copy of the last output to blend
+		/// them into, call before start()
+		void setRegions(bool enabled) {
+			regionsEnabled = enabled;
+		}
+
+		bool getRegions() const {return regionsEnabled;}
+
+		/// upsample outputs to the submitted frame size with the frame as
+		/// guide instead of resizing to the style transfer size, call before
+		/// start(), frames are then held until postprocessed
+		void setUpsampling(bool enabled) {
+			upsamplingEnabled = enabled;
+		}
+
+		bool getUpsampling() const {return upsamplingEnabled;}
+
+		/// write outputs into a texture stream's buffers instead of
+		/// Result::pixels, which are only filled if no buffer was free; call
+		/// before start(), nullptr to disable
+		void setOutputStream(TextureStream * stream) {
+			outputStream = stream;
+		}
+
+		/// guided upsampling settings, change before start()
+		GuidedUpsampler & getUpsampler() {return upsampler;}
+
+		/// CPU cores for worker i of n: consecutive blocks of equal size,
+		/// wrapping around if there are more workers than cores
+		static std::vector<int> workerCores(int worker, int workers, int cores) {
+			int count = std::max(cores / std::max(workers, 1), 1);
+			std::vector<int> set;
+			for(int i = 0; i < count; i++) {
+				set.push_back((worker * count + i) % std::max(cores, 1));
+			}
+			return set;
+		}
+
+		/// stop and join the stage threads, frames in flight are discarded
+		void stop() {
+			if(!running) {
+				return;
+			}
+			{
+				std::lock_guard<std::mutex> lock(slotMutex);
+				running = false;
+			}
+			slotFree.notify_all();
+			input.close();
+			tensors.close();
+			outputs.close();
+			results.close();
+			for(auto & thread : threads) {
+				thread.join();
+			}
+			threads.clear();
+		}
+
+		bool isRunning() const {return running;}
+
+		/// set max frames in flight, 1 for lowest latency
+		void setDepth(int depth) {
+			depth = std::min(std::max(depth, 1), (int)MAX_DEPTH);
+			{
+				std::lock_guard<std::mutex> lock(slotMutex);
+				this->depth = depth;
+			}
+			tensors.setCapacity(depth);
+			outputs.setCapacity(depth);
+			results.setCapacity(depth);
+			input.setCapacity(dropFrames ? 1 : depth);
+			slotFree.notify_all();
+		}
+
+		int getDepth() const {return depth;}
+
+		/// queue a frame, span must stay valid while owner is held,
+		/// see Frame::retain(); with setRegions() enabled, a non-empty region
+		/// of the span is stylized and blended into the previous output
+		///
+		/// never blocks: with frame dropping a frame still waiting for a slot
+		/// is replaced, otherwise returns false if the input queue is full
+		bool submit(const PixelSpan & span, std::shared_ptr<void> owner,
+		            uint64_t index, uint64_t captureTime, const PixelRect & region=PixelRect()) {
+			if(!running || !span.isValid()) {
+				return false;
+			}
+			Job job;
+			job.span = span;
+			job.owner = owner;
+			job.times.index = index;
+			job.times.capture = captureTime;
+			job.times.submit = ofGetElapsedTimeMicros();
+			job.width = (upsamplingEnabled ? span.width : styleTransfer->getOutputWidth());
+			job.height = (upsamplingEnabled ? span.height : styleTransfer->getOutputHeight());
+			job.modelWidth = styleTransfer->getModelWidth();
+			job.modelHeight = styleTransfer->getModelHeight();
+			if(regionsEnabled) {
+				job.region = region;
+			}
+			if(dropFrames) {
+				dropped += input.pushLatest(std::move(job));
+			}
+			else if(!input.tryPush(std::move(job))) {
+				return false;
+			}
+			submitted++;
+			return true;
+		}
+
+		/// returns true if a new output is available via getOutput(), if
+		/// several finished since the last call, the newest is kept
+		bool poll() {
+			bool isNew = false;
+			Result result;
+			while(results.tryPop(result)) {
+				output = std::move(result);
+				isNew = true;
+			}
+			return isNew;
+		}
+
+		/// returns true if an output is available and sets getOutput() to the
+		/// oldest unread one, for consumers which need every frame
+		bool next() {
+			return results.tryPop(output);
+		}
+
+		/// most recently polled output
+		Result & getOutput() {return output;}
+
+		/// snapshot of stage timings and counters
+		Stats getStats() const {
+			Stats stats;
+			{
+				std::lock_guard<std::mutex> lock(statsMutex);
+				stats = timings;
+			}
+			stats.depth = depth;
+			stats.workers = workerOptions.workers;
+			stats.submitted = submitted;
+			stats.dropped = dropped;
+			stats.completed = completed;
+			stats.failed = failed;
+			stats.reordered = reordered;
+			stats.regions = regions;
+			return stats;
+		}
+
+		static const int MAX_DEPTH = 8; ///< max frames in flight
+		static const int FEATHER = 16; ///< region blend border in output pixels
+
+	protected:
+
+		/// a frame moving through the stages
+		struct Job {
+			PixelSpan span;
+			std::shared_ptr<void> owner; ///< keeps span valid until preprocessed, postprocessed if upsampling
+			cppflow::tensor tensor;
+			FrameTimes times;
+			uint64_t sequence = 0; ///< preprocess order, for reordering
+			bool failed = false; ///< inference failed, skip output
+			int width = 0, height = 0; ///< output size
+			int modelWidth = 0, modelHeight = 0; ///< model input size
+			PixelRect region; ///< crop of span to stylize, empty for all
+			PixelRect outputRegion; ///< region at the output size
+		};
+
+		void preprocessStage() {
+			Job job;
+			while(acquireSlot()) {
+				if(!input.pop(job)) {
+					break;
+				}
+				job.times.preprocessStart = ofGetElapsedTimeMicros();
+				job.sequence = nextSequence++;
+				float * data = nullptr;
+				if(!job.region.isEmpty() && job.width == fullWidth && job.height == fullHeight) {
+					// crop at model scale, one of the region sizes: grow the
+					// crop to match so it is not stretched
+					int width = alignedSize(job.region.width, job.span.width, job.modelWidth);
+					int height = alignedSize(job.region.height, job.span.height, job.modelHeight);
+					PixelRect region = job.region;
+					growRange(region.x, region.width, width * job.span.width / job.modelWidth, job.span.width);
+					growRange(region.y, region.height, height * job.span.height / job.modelHeight, job.span.height);
+					PixelSpan crop = job.span.crop(region);
+					job.outputRegion = PixelRect(region.x, region.y, crop.width, crop.height)
+						.scaled(job.span.width, job.span.height, job.width, job.height);
+					job.tensor = buffers.allocate({1, height, width, 3}, data);
+					preprocess(crop, data, width, height);
+				}
+				else {
+					// regions need a full output at this size to blend into
+					fullWidth = job.width;
+					fullHeight = job.height;
+					job.tensor = buffers.allocate({1, job.modelHeight, job.modelWidth, 3}, data);
+					preprocess(job.span, data, job.modelWidth, job.modelHeight);
+				}
+				if(!upsamplingEnabled) {
+					job.owner.reset(); // release the camera buffer early
+				}
+				job.times.preprocessEnd = ofGetElapsedTimeMicros();
+				addTiming(timings.preprocess, job.times.preprocessStart, job.times.preprocessEnd);
+				if(!tensors.push(std::move(job))) {
+					break;
+				}
+			}
+		}
+
+		/// single inference thread using the style transfer model
+		void inferenceStage() {
+			if(regionsEnabled) {
+				// the full frame shape was warmed up by the style transfer setup
+				warmUp("inference", [this](const cppflow::tensor & input) {
+					return styleTransfer->run(input);
+				});
+			}
+			Job job;
+			while(tensors.pop(job)) {
+				job.times.inferenceStart = ofGetElapsedTimeMicros();
+				try {
+					job.tensor = styleTransfer->run(job.tensor);
+					job.times.inferenceEnd = ofGetElapsedTimeMicros();
+					addInferenceTiming(job);
+				}
+				catch(const std::exception & e) {
+					ofLogError("StylePipeline") << "inference failed: " << e.what();
+					job.failed = true;
+				}
+				if(!outputs.push(std::move(job))) {
+					break;
+				}
+			}
+		}
+
+		/// one of several inference threads, each with its own session,
+		/// falls back to the style transfer model if the session fails to load
+		///
+		/// when the style transfer model is swapped the worker runs on the new
+		/// shared model while its own session for it loads in the background,
+		/// the old session is released there as well, the new one is warmed up
+		/// there before taking over
+		void workerStage(int worker) {
+			int cores = std::max((int)std::thread::hardware_concurrency(), 1);
+			std::vector<int> set = workerCores(worker, workerOptions.workers, cores);
+			if(workerOptions.pin && !ModelSession::pinThread(set)) {
+				ofLogWarning("StylePipeline") << "worker " << worker << ": failed to pin to cores";
+			}
+			ModelSession::Options options;
+			options.intraOpThreads = (workerOptions.intraOpThreads > 0 ?
+			                          workerOptions.intraOpThreads : (int)set.size());
+			options.interOpThreads = (workerOptions.interOpThreads > 0 ?
+			                          workerOptions.interOpThreads : 1);
+			options.allowGPU = (InferenceDevice::getType() != InferenceDevice::DEVICE_CPU);
+			options.precision = InferenceDevice::getPrecision();
+			uint64_t generation = styleTransfer->getGeneration();
+			std::unique_ptr<ModelSession> session = loadSession(worker, options);
+			if(session) {
+				warmUp(worker, *session);
+			}
+			if(!session) {
+				ofLogWarning("StylePipeline") << "worker " << worker << ": using the shared model";
+			}
+			else {
+				ofLogNotice("StylePipeline") << "worker " << worker << ": cores "
+					<< set.front() << "-" << set.back() << ", " << options.intraOpThreads
+					<< " intra-op / " << options.interOpThreads << " inter-op threads";
+			}
+			std::future<std::unique_ptr<ModelSession>> reload;
+
+			Job job;
+			while(tensors.pop(job)) {
+				if(styleTransfer->getGeneration() != generation) {
+					// model swapped: load a session for the new model, frames
+					// run on the shared model meanwhile
+					generation = styleTransfer->getGeneration();
+					std::shared_ptr<ModelSession> retired(std::move(session));
+					reload = std::async(std::launch::async, [this, worker, options, retired]() mutable {
+						retired.reset();
+						std::unique_ptr<ModelSession> next = loadSession(worker, options);
+						if(next) {
+							warmUp(worker, *next); // no graph setup on the first live frame
+						}
+						return next;
+					});
+				}
+				if(reload.valid() && reload.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+					session = reload.get();
+					if(session && styleTransfer->getGeneration() != generation) {
+						session.reset(); // swapped again while loading
+					}
+				}
+				job.times.worker = worker;
+				job.times.inferenceStart = ofGetElapsedTimeMicros();
+				try {
+					if(session) {
+						cppflow::tensor style = styleTransfer->getStyleTensor();
+						job.tensor = styleTransfer->getTiling().run(job.tensor, [&](const cppflow::tensor & tiles) {
+							return session->run({tiles, ofxStyleTransfer::batchStyle(style, tiles)});
+						});
+					}
+					else {
+						job.tensor = styleTransfer->run(job.tensor);
+					}
+					job.times.inferenceEnd = ofGetElapsedTimeMicros();
+					addInferenceTiming(job);
+				}
+				catch(const std::exception & e) {
+					ofLogError("StylePipeline") << "worker " << worker << ": inference failed: " << e.what();
+					job.failed = true;
+				}
+				if(!outputs.push(std::move(job))) {
+					break;
+				}
+			}
+		}
+
+		/// session for the current style transfer model, nullptr on failure
+		std::unique_ptr<ModelSession> loadSession(int worker, const ModelSession::Options & options) {
+			std::shared_ptr<ofxStyleTransfer::Network> network = styleTransfer->getNetwork();
+			std::unique_ptr<ModelSession> session(new ModelSession);
+			if(!network || !session->load(network->transferPath, network->inputNames,
+			                              network->outputName, options)) {
+				return nullptr;
+			}
+			ofLogVerbose("StylePipeline") << "worker " << worker << ": session for " << network->modelPath;
+			return session;
+		}
+
+		/// run a session once per input shape at the current model size &
+		/// style so graph setup does not delay its first live frames, returns
+		/// false if it failed
+		bool warmUp(int worker, ModelSession & session) {
+			cppflow::tensor style = styleTransfer->getStyleTensor();
+			return warmUp("worker " + ofToString(worker), [&](const cppflow::tensor & input) {
+				return styleTransfer->getTiling().run(input, [&](const cppflow::tensor & tiles) {
+					return session.run({tiles, ofxStyleTransfer::batchStyle(style, tiles)});
+				});
+			});
+		}
+
+		/// run once per input shape at the current model size: the full frame
+		/// and, with regions, every region crop shape, see regionSizes()
+		bool warmUp(const std::string & name, const std::function<cppflow::tensor(const cppflow::tensor &)> & run) {
+			const int modelWidth = styleTransfer->getModelWidth();
+			const int modelHeight = styleTransfer->getModelHeight();
+			std::vector<int> widths = {modelWidth}, heights = {modelHeight};
+			if(regionsEnabled) {
+				widths = regionSizes(modelWidth);
+				heights = regionSizes(modelHeight);
+			}
+			for(int height : heights) {
+				for(int width : widths) {
+					std::vector<float> values((std::size_t)width * height * 3, 0.5f);
+					cppflow::tensor input(values, {1, height, width, 3}); // buffers are not thread-safe
+					try {
+						run(input);
+					}
+					catch(const std::exception & e) {
+						ofLogWarning("StylePipeline") << name << ": warm-up at " << width << "x" << height
+							<< " failed: " << e.what();
+						return false;
+					}
+				}
+			}
+			return true;
+		}
+
+		/// postprocess in sequence order, out of order frames from several
+		/// workers wait in the reorder buffer
+		void postprocessStage() {
+			std::map<uint64_t, Job> reorder;
+			uint64_t expected = 0;
+			Job job;
+			while(outputs.pop(job)) {
+				if(job.sequence != expected) {
+					reordered++;
+				}
+				uint64_t sequence = job.sequence;
+				reorder.emplace(sequence, std::move(job));
+				for(auto it = reorder.find(expected); it != reorder.end(); it = reorder.find(expected)) {
+					bool stopped = !postprocessJob(it->second);
+					reorder.erase(it);
+					expected++;
+					if(stopped) {
+						return;
+					}
+				}
+			}
+		}
+
+		/// convert to the output, returns false if stopping
+		bool postprocessJob(Job & job) {
+			if(job.failed) {
+				failed++;
+				releaseSlot();
+				return true;
+			}
+			Result result;
+			result.times = job.times;
+			result.times.postprocessStart = ofGetElapsedTimeMicros();
+			// convert straight into a mapped texture buffer if one is free
+			unsigned char * mapped = (outputStream ? outputStream->beginWrite(job.width, job.height, PixelSpan::RGB) : nullptr);
+			if(mapped) {
+				result.pixels.setFromExternalPixels(mapped, job.width, job.height, 3);
+			}
+			bool converted = true;
+			if(job.outputRegion.isEmpty() && regionsEnabled) {
+				// a mapped buffer is write-only: convert into the full frame
+				// kept for blending and copy from there
+				converted = toPixels(job, PixelRect(0, 0, job.width, job.height), previous);
+				if(converted && mapped) {
+					std::memcpy(mapped, previous.getData(), previous.size());
+				}
+				else if(converted) {
+					result.pixels = previous;
+				}
+			}
+			else if(job.outputRegion.isEmpty()) {
+				converted = toPixels(job, PixelRect(0, 0, job.width, job.height), result.pixels);
+			}
+			else {
+				ofPixels patch;
+				converted = toPixels(job, job.outputRegion, patch);
+				if(converted) {
+					if(previous.getWidth() != job.width || previous.getHeight() != job.height) {
+						// the full frame before failed
+						previous.allocate(job.width, job.height, OF_PIXELS_RGB);
+						previous.set(0);
+					}
+					blendRegion(patch, previous, job.outputRegion, FEATHER);
+					if(mapped) {
+						std::memcpy(mapped, previous.getData(), previous.size());
+					}
+					else {
+						result.pixels = previous;
+					}
+					regions++;
+				}
+			}
+			if(mapped) {
+				// a buffer which was not written holds undefined contents
+				result.pixels.clear();
+				result.streamed = true;
+				outputStream->endWrite(converted);
+			}
+			job.tensor = cppflow::tensor(); // return the output buffer to TF
+			job.owner.reset();
+			if(!converted) {
+				failed++;
+				releaseSlot();
+				return true;
+			}
+			result.times.postprocessEnd = ofGetElapsedTimeMicros();
+			addTiming(timings.postprocess, result.times.postprocessStart, result.times.postprocessEnd);
+			addTiming(timings.latency, result.times.capture, result.times.postprocessEnd);
+			completed++;
+			releaseSlot();
+			return results.push(std::move(result));
+		}
+
+		/// output tensor to pixels of rect, guided by the frame if upsampling,
+		/// returns false if the output could not be converted
+		bool toPixels(Job & job, const PixelRect & rect, ofPixels & pixels) {
+			if(!upsamplingEnabled) {
+				return ofxStyleTransfer::tensorToPixels(job.tensor, pixels, rect.width, rect.height);
+			}
+			// output size is the frame size, so rect is in frame pixels
+			std::vector<int64_t> shape = job.tensor.shape(); // NHWC
+			if(shape.size() != 4 || shape[3] != 3) {
+				ofLogError("StylePipeline") << "Unexpected output tensor shape";
+				return false;
+			}
+			std::shared_ptr<TF_Tensor> data = job.tensor.get_tensor();
+			return upsampler.process((const float *)TF_TensorData(data.get()), (int)shape[2], (int)shape[1],
+			                         job.span.crop(rect), pixels);
+		}
+
+		/// model scale size of a region side: the smallest of regionSizes()
+		/// which holds it, so crops only use a few warmed up shapes
+		static int alignedSize(int size, int spanSize, int modelSize) {
+			int scaled = (size * modelSize + spanSize - 1) / std::max(spanSize, 1);
+			for(int aligned : regionSizes(modelSize)) {
+				if(aligned >= scaled) {
+					return aligned;
+				}
+			}
+			return modelSize;
+		}
+
+		/// region crop sizes along a model side: 1/4, 1/2, and all of it,
+		/// multiples of 32, ascending; every new input shape costs a graph
+		/// retrace or kernel autotune on its first run
+		static std::vector<int> regionSizes(int modelSize) {
+			std::vector<int> sizes;
+			for(int divisor : {4, 2, 1}) {
+				int size = std::min(ofxStyleTransfer::roundupto(std::max(modelSize / divisor, 1), 32), modelSize);
+				if(sizes.empty() || size > sizes.back()) {
+					sizes.push_back(size);
+				}
+			}
+			return sizes;
+		}
+
+		/// grow a range to at least size, centered on the old range and kept
+		/// within 0 - spanSize
+		static void growRange(int & start, int & size, int target, int spanSize) {
+			target = std::min(std::max(target, size), spanSize);
+			start = std::min(std::max(start - (target - size) / 2, 0), spanSize - target);
+			size = target;
+		}
+
+		/// blend patch into target at rect, fading in over feather pixels
+		/// along edges which are not on the target border
+		static void blendRegion(const ofPixels & patch, ofPixels & target, const PixelRect & rect, int feather) {
+			const int width = std::min(rect.width, (int)patch.getWidth());
+			const int height = std::min(rect.height, (int)patch.getHeight());
+			feather = std::max(std::min({feather, width / 2, height / 2}), 1);
+			const int far = std::numeric_limits<int>::max() / 2;
+			const bool left = rect.x > 0, top = rect.y > 0;
+			const bool right = rect.x + width < (int)target.getWidth();
+			const bool bottom = rect.y + height < (int)target.getHeight();
+			for(int y = 0; y < height; y++) {
+				const unsigned char * src = patch.getData() + y * patch.getBytesStride();
+				unsigned char * dst = target.getData() + (rect.y + y) * target.getBytesStride() + rect.x * 3;
+				int dy = std::min(top ? y : far, bottom ? height - 1 - y : far);
+				int begin = (left ? feather : 0), end = width - (right ? feather : 0);
+				if(dy < feather) {
+					begin = end = 0; // whole row feathered
+				}
+				for(int x = 0; x < width; x++) {
+					if(x == begin && begin < end) {
+						// interior: plain copy
+						std::memcpy(dst + x * 3, src + x * 3, (end - begin) * 3);
+						x = end - 1;
+						continue;
+					}
+					int d = std::min({dy, left ? x : far, right ? width - 1 - x : far});
+					float alpha = std::min((d + 0.5f) / feather, 1.f);
+					for(int c = 0; c < 3; c++) {
+						int i = x * 3 + c;
+						dst[i] = (unsigned char)(dst[i] + (src[i] - dst[i]) * alpha + 0.5f);
+					}
+				}
+			}
+		}
+
+		/// wait until fewer than depth frames are in flight and take a slot,
+		/// returns false when stopping
+		bool acquireSlot() {
+			std::unique_lock<std::mutex> lock(slotMutex);
+			slotFree.wait(lock, [this] {return !running || inFlight < depth;});
+			if(!running) {
+				return false;
+			}
+			inFlight++;
+			return true;
+		}
+
+		void releaseSlot() {
+			{
+				std::lock_guard<std::mutex> lock(slotMutex);
+				inFlight--;
+			}
+			slotFree.notify_one();
+		}
+
+		/// smooth a job's inference time into the full frame or region time,
+		/// regions run smaller inputs & must not look like a faster model
+		void addInferenceTiming(const Job & job) {
+			addTiming(job.outputRegion.isEmpty() ? timings.inference : timings.regionInference,
+			          job.times.inferenceStart, job.times.inferenceEnd);
+		}
+
+		/// smooth a stage time from start until end in us into value, in ms
+		void addTiming(double & value, uint64_t start, uint64_t end) {
+			double ms = (end - start) / 1000.0;
+			std::lock_guard<std::mutex> lock(statsMutex);
+			value = (value == 0 ? ms : value * 0.9 + ms * 0.1);
+		}
+
+		ofxStyleTransfer * styleTransfer = nullptr;
+		TensorBufferPool buffers; ///< input tensors, preprocess thread only
+		bool dropFrames = true; ///< replace waiting frames instead of queueing?
+		WorkerOptions workerOptions;
+		uint64_t nextSequence = 0; ///< preprocess thread only
+		bool regionsEnabled = false; ///< blend regions into the previous output?
+		bool upsamplingEnabled = false; ///< guided upsampling to the frame size?
+		GuidedUpsampler upsampler; ///< postprocess thread only
+		TextureStream * outputStream = nullptr; ///< written by the postprocess thread
+		int fullWidth = 0, fullHeight = 0; ///< last full frame size, preprocess thread only
+		ofPixels previous; ///< last output, postprocess thread only
+
+		BoundedQueue<Job> input; ///< submitted frames
+		BoundedQueue<Job> tensors; ///< preprocessed input tensors
+		BoundedQueue<Job> outputs; ///< inference output tensors
+		BoundedQueue<Result> results; ///< finished frames
+		Result output; ///< most recently polled result
+		std::vector<std::thread> threads;
+
+		std::atomic<bool> running{false};
+		std::atomic<int> depth{2};
+		std::atomic<int> inFlight{0};
+		std::mutex slotMutex;
+		std::condition_variable slotFree;
+
+		mutable std::mutex statsMutex;
+		Stats timings; ///< guarded by statsMutex
+		std::atomic<uint64_t> submitted{0};
+		std::atomic<uint64_t> dropped{0};
+		std::atomic<uint64_t> completed{0};
+		std::atomic<uint64_t> failed{0};
+		std::atomic<uint64_t> reordered{0};
+		std::atomic<uint64_t> regions{0};
+};
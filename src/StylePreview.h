@@ -0,0 +1,326 @@
+/*
+ * AI Dance Mirror
+ *
+ * Contact sheet of the current frame in every style, in batched model runs.
+ */
+#pragma once
+
+#include "ofxStyleTransfer.h"
+#include "Preprocess.h"
+#include "TensorBufferPool.h"
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <thread>
+
+/// \class StylePreview
+/// \brief stylizes one downscaled frame with every style of the library and
+///        lays the thumbnails out as a grid
+///
+/// the frame is preprocessed once at thumbnail size and repeated along the
+/// batch dimension, each batch slot gets another style, so a library of N
+/// styles takes N / batch model runs
+///
+/// preview batches run at low priority on their own thread: each one waits
+/// for allowBatch(), which the app calls after every live output, so at most
+/// one batch runs per live frame; with frames in flight in the pipeline the
+/// batch shares the model with live inference; if no live output arrives for
+/// IDLE_MS, ie. static frames are reused, the batch runs anyway
+///
+/// thumbnails of failed batches stay blank and count as failed, a sheet is
+/// finished once getDone() + getFailed() reaches getCount()
+///
+/// all functions are called from the main thread, the model may be in use by
+/// the pipeline or batcher at the same time
+class StylePreview {
+	public:
+
+		/// throughput of preview batches
+		struct Stats {
+			int batchSize = 0; ///< styles per model run
+			double batchMs = 0; ///< smoothed model run time per batch
+			double sheetMs = 0; ///< request to complete sheet, last sheet
+			uint64_t batches = 0; ///< model runs
+			uint64_t thumbnails = 0; ///< stylized thumbnails
+		};
+
+		~StylePreview() {
+			stop();
+		}
+
+		/// start the preview thread, thumbnail size is rounded to multiples
+		/// of 32, returns false if already running
+		bool start(ofxStyleTransfer & styleTransfer, int thumbWidth=160, int thumbHeight=128, int batchSize=8) {
+			if(running) {
+				return false;
+			}
+			this->styleTransfer = &styleTransfer;
+			this->thumbWidth = std::max((thumbWidth + 31) / 32 * 32, 32);
+			this->thumbHeight = std::max((thumbHeight + 31) / 32 * 32, 32);
+			setBatchSize(batchSize);
+			running = true;
+			thread = std::thread(&StylePreview::previewLoop, this);
+			return true;
+		}
+
+		/// stop the preview thread, waits for a running batch
+		void stop() {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if(!running) {
+					return;
+				}
+				running = false;
+			}
+			wake.notify_all();
+			if(thread.joinable()) {
+				thread.join();
+			}
+		}
+
+		bool isRunning() const {return running;}
+
+		/// styles per model run, applies from the next batch
+		void setBatchSize(int size) {
+			std::lock_guard<std::mutex> lock(mutex);
+			batchSize = std::min(std::max(size, 1), (int)MAX_BATCH);
+		}
+
+		int getBatchSize() const {
+			std::lock_guard<std::mutex> lock(mutex);
+			return batchSize;
+		}
+
+		/// start a sheet of frame in every style, replaces an unfinished sheet
+		void request(const PixelSpan & frame, const std::vector<ofxStyleTransfer::Style> & styles) {
+			if(!frame.isValid() || styles.empty()) {
+				return;
+			}
+			// downscale once here, the frame buffer is reused by the grabber
+			std::vector<float> input((std::size_t)thumbWidth * thumbHeight * 3);
+			preprocess(frame, input.data(), thumbWidth, thumbHeight);
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				content = std::move(input);
+				this->styles = styles;
+				next = 0;
+				done = 0;
+				failed = 0;
+				generation++;
+				requestTime = ofGetElapsedTimeMicros();
+				grid(styles.size(), columns, rows);
+				sheet.allocate(thumbWidth * columns, thumbHeight * rows, OF_PIXELS_RGB);
+				sheet.set(0);
+				changed = true;
+			}
+			wake.notify_all();
+		}
+
+		/// drop the unfinished part of the current sheet
+		void cancel() {
+			std::lock_guard<std::mutex> lock(mutex);
+			next = styles.size();
+			generation++;
+		}
+
+		/// let one preview batch run now, call after each live output
+		void allowBatch() {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				allowed = true;
+			}
+			wake.notify_all();
+		}
+
+		/// copy the sheet into pixels if it changed since the last call,
+		/// returns true if it did
+		bool poll(ofPixels & pixels) {
+			std::lock_guard<std::mutex> lock(mutex);
+			if(!changed) {
+				return false;
+			}
+			pixels = sheet;
+			changed = false;
+			return true;
+		}
+
+		/// cell of a style in sheet pixels
+		ofRectangle getCell(std::size_t index) const {
+			std::lock_guard<std::mutex> lock(mutex);
+			if(columns == 0) {
+				return ofRectangle();
+			}
+			return ofRectangle((index % columns) * thumbWidth, (index / columns) * thumbHeight,
+			                   thumbWidth, thumbHeight);
+		}
+
+		/// style index at a point in sheet pixels, -1 if none
+		int getIndex(float x, float y) const {
+			std::lock_guard<std::mutex> lock(mutex);
+			if(columns == 0 || x < 0 || y < 0) {
+				return -1;
+			}
+			std::size_t index = (std::size_t)(y / thumbHeight) * columns + (std::size_t)(x / thumbWidth);
+			return ((int)(x / thumbWidth) < columns && index < styles.size() ? (int)index : -1);
+		}
+
+		/// thumbnails done & total of the current sheet
+		std::size_t getDone() const {std::lock_guard<std::mutex> lock(mutex); return done;}
+		std::size_t getFailed() const {std::lock_guard<std::mutex> lock(mutex); return failed;}
+		std::size_t getCount() const {std::lock_guard<std::mutex> lock(mutex); return styles.size();}
+
+		Stats getStats() const {
+			std::lock_guard<std::mutex> lock(mutex);
+			return stats;
+		}
+
+		/// smoothed thumbnails per second of the model runs by batch size
+		std::map<int, double> getThroughput() const {
+			std::lock_guard<std::mutex> lock(mutex);
+			return throughput;
+		}
+
+		/// columns x rows close to square for count cells
+		static void grid(std::size_t count, int & columns, int & rows) {
+			columns = std::max((int)std::ceil(std::sqrt((double)count)), 1);
+			rows = std::max((int)((count + columns - 1) / columns), 1);
+		}
+
+		static const int MAX_BATCH = 32; ///< max styles per model run
+		static constexpr int IDLE_MS = 100; ///< max wait for a live output
+
+	protected:
+
+		void previewLoop() {
+			std::vector<cppflow::tensor> batch;
+			while(true) {
+				std::vector<float> input;
+				std::size_t first = 0;
+				uint64_t id = 0;
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					wake.wait(lock, [this] {return !running || next < styles.size();});
+					// low priority: after a live output or once the model idles
+					allowed = false;
+					wake.wait_for(lock, std::chrono::milliseconds(IDLE_MS), [this] {return !running || allowed;});
+					if(!running) {
+						break;
+					}
+					if(next >= styles.size()) {
+						continue; // cancelled meanwhile
+					}
+					first = next;
+					std::size_t count = std::min((std::size_t)batchSize, styles.size() - first);
+					batch.clear();
+					for(std::size_t i = 0; i < count; i++) {
+						batch.push_back(styleTransfer->getStyleTensor(styles[first + i]));
+					}
+					next += count;
+					id = generation;
+					input = content;
+				}
+				runBatch(input, batch, first, id);
+			}
+		}
+
+		/// stylize one batch of styles and write the thumbnails into the sheet
+		void runBatch(const std::vector<float> & input, const std::vector<cppflow::tensor> & batch,
+		              std::size_t first, uint64_t id) {
+			const int count = (int)batch.size();
+			const std::size_t slice = (std::size_t)thumbWidth * thumbHeight * 3;
+			float * data = nullptr;
+			cppflow::tensor tensor = buffers.allocate({count, thumbHeight, thumbWidth, 3}, data);
+			for(int i = 0; i < count; i++) {
+				std::copy(input.begin(), input.end(), data + i * slice);
+			}
+			uint64_t start = ofGetElapsedTimeMicros();
+			cppflow::tensor output;
+			try {
+				cppflow::tensor style = (count == 1 ? batch[0] : cppflow::concat(cppflow::tensor(0), batch));
+				output = styleTransfer->run(tensor, style);
+				std::vector<int64_t> shape = output.shape(); // NHWC
+				if(shape.size() != 4 || shape[0] != count || shape[3] != 3) {
+					ofLogError("StylePreview") << "unexpected output tensor shape";
+					fail(count, id);
+					return;
+				}
+				if(shape[2] != thumbWidth || shape[1] != thumbHeight) {
+					output = cppflow::resize_bicubic(output, cppflow::tensor({thumbHeight, thumbWidth}), true);
+				}
+			}
+			catch(const std::exception & e) {
+				ofLogError("StylePreview") << "preview batch of " << count << " failed: " << e.what();
+				fail(count, id);
+				return;
+			}
+			std::shared_ptr<TF_Tensor> outputData = output.get_tensor();
+			const float * out = (const float *)TF_TensorData(outputData.get());
+			double ms = (ofGetElapsedTimeMicros() - start) / 1000.0;
+
+			std::lock_guard<std::mutex> lock(mutex);
+			stats.batchSize = count;
+			stats.batchMs = (stats.batches == 0 ? ms : stats.batchMs * 0.9 + ms * 0.1);
+			stats.batches++;
+			stats.thumbnails += count;
+			double rate = count * 1000.0 / std::max(ms, 1e-3);
+			auto it = throughput.find(count);
+			throughput[count] = (it == throughput.end() ? rate : it->second * 0.8 + rate * 0.2);
+			if(id != generation) {
+				return; // replaced by a newer request
+			}
+			const std::size_t rowBytes = (std::size_t)thumbWidth * 3;
+			for(int i = 0; i < count; i++) {
+				std::size_t index = first + i;
+				int x = (int)(index % columns) * thumbWidth;
+				int y = (int)(index / columns) * thumbHeight;
+				for(int row = 0; row < thumbHeight; row++) {
+					PixelKernels::toUnsignedChar(out + i * slice + row * rowBytes,
+						sheet.getData() + ((std::size_t)(y + row) * sheet.getWidth() + x) * 3, rowBytes);
+				}
+			}
+			done += count;
+			changed = true;
+			if(done == styles.size()) {
+				stats.sheetMs = (ofGetElapsedTimeMicros() - requestTime) / 1000.0;
+				ofLogNotice("StylePreview") << styles.size() << " styles in " << ofToString(stats.sheetMs, 0)
+					<< " ms, " << ofToString(stats.batchMs, 1) << " ms per batch of up to " << batchSize;
+			}
+		}
+
+		/// count a failed batch of the sheet id, its cells stay blank
+		void fail(int count, uint64_t id) {
+			std::lock_guard<std::mutex> lock(mutex);
+			if(id == generation) {
+				failed += count;
+				changed = true;
+			}
+		}
+
+		ofxStyleTransfer * styleTransfer = nullptr;
+		TensorBufferPool buffers; ///< batch inputs, preview thread only
+		std::thread thread;
+		std::atomic<bool> running{false};
+
+		int thumbWidth = 160;
+		int thumbHeight = 128;
+		int batchSize = 8;
+
+		// current request, guarded by mutex
+		std::vector<float> content; ///< preprocessed thumbnail input
+		std::vector<ofxStyleTransfer::Style> styles;
+		std::size_t next = 0; ///< first style not yet batched
+		std::size_t done = 0; ///< thumbnails in the sheet
+		std::size_t failed = 0; ///< thumbnails of failed batches
+		uint64_t generation = 0; ///< request id, stale batches are discarded
+		uint64_t requestTime = 0; ///< us
+		bool allowed = false; ///< may the next batch run?
+		int columns = 0, rows = 0;
+		ofPixels sheet;
+		bool changed = false; ///< sheet changed since poll()?
+
+		Stats stats;
+		std::map<int, double> throughput; ///< thumbnails/s by batch size
+
+		mutable std::mutex mutex;
+		std::condition_variable wake;
+};
@@ -0,0 +1,128 @@
+/*
+ * AI Dance Mirror
+ *
+ * Timed style crossfades interpolated in style embedding space.
+ */
+#pragma once
+
+#include "ofxStyleTransfer.h"
+
+/// \class StyleTransition
+/// \brief morphs from the current style to a new one over time by blending
+///        the style representation every frame, see
+///        ofxStyleTransfer::blendStyles()
+///
+/// each frame is stylized once with the blended style, so a morph costs the
+/// same as a cut instead of two inferences plus an image crossfade; starting
+/// a transition while one is running morphs on from the current blend
+///
+/// not thread-safe, use from the main thread
+class StyleTransition {
+	public:
+
+		/// transition or cycle length in seconds or musical beats
+		struct Duration {
+			float value = 0; ///< seconds or beats
+			bool beats = false; ///< is value in beats?
+
+			/// length in seconds at bpm beats per minute
+			float getSeconds(float bpm) const {
+				return (beats ? value * 60.f / std::max(bpm, 1.f) : value);
+			}
+
+			/// parse seconds "2.5" or beats "4b", returns false if invalid
+			static bool fromString(const std::string & s, Duration & duration) {
+				if(s.empty()) {
+					return false;
+				}
+				duration.beats = (s.back() == 'b');
+				std::string number = (duration.beats ? s.substr(0, s.size() - 1) : s);
+				if(number.empty() || number.find_first_not_of("0123456789.") != std::string::npos) {
+					return false;
+				}
+				duration.value = ofToFloat(number);
+				return true;
+			}
+
+			std::string toString() const {
+				return ofToString(value) + (beats ? " beats" : " s");
+			}
+		};
+
+		/// blend weight curves over normalized time
+		enum Easing {
+			EASING_LINEAR, ///< constant rate
+			EASING_SMOOTH  ///< smoothstep: eases in & out (default)
+		};
+
+		/// transition length in seconds, 0 cuts
+		void setDuration(float seconds) {duration = std::max(seconds, 0.f);}
+		float getDuration() const {return duration;}
+
+		void setEasing(Easing easing) {this->easing = easing;}
+
+		/// morph to target starting at time now in seconds, cuts if there is
+		/// no current style or the duration is 0
+		void start(const ofxStyleTransfer::Style & target, float now) {
+			to = target;
+			if(!hasStyle || duration <= 0) {
+				current = target;
+				hasStyle = true;
+				active = false;
+				changed = true;
+				return;
+			}
+			from = current; // mid transition: the blend seen last
+			startTime = now;
+			active = true;
+		}
+
+		/// advance to time now in seconds, returns true if getStyle() changed
+		/// and should be applied
+		bool update(const ofxStyleTransfer & styleTransfer, float now) {
+			if(active) {
+				float t = ofClamp((now - startTime) / duration, 0.f, 1.f);
+				if(t >= 1) {
+					current = to;
+					active = false;
+				}
+				else {
+					float w = ease(t);
+					current = styleTransfer.blendStyles({&from, &to}, {1.f - w, w});
+				}
+				changed = true;
+			}
+			bool result = changed;
+			changed = false;
+			return result;
+		}
+
+		/// current, possibly blended, style
+		const ofxStyleTransfer::Style & getStyle() const {return current;}
+
+		bool hasCurrentStyle() const {return hasStyle;}
+
+		/// is a morph running?
+		bool isActive() const {return active;}
+
+		/// 0 - 1 through the running morph, 1 if none
+		float getProgress(float now) const {
+			return (active ? ofClamp((now - startTime) / duration, 0.f, 1.f) : 1.f);
+		}
+
+	protected:
+
+		float ease(float t) const {
+			return (easing == EASING_SMOOTH ? t * t * (3 - 2 * t) : t);
+		}
+
+		ofxStyleTransfer::Style from; ///< morph start
+		ofxStyleTransfer::Style to; ///< morph target
+		ofxStyleTransfer::Style current; ///< applied style
+		bool hasStyle = false; ///< has a style been started?
+		bool active = false; ///< is a morph running?
+		bool changed = false; ///< current changed since the last update()?
+		float startTime = 0; ///< morph start in s
+		float duration = 0; ///< morph length in s
+		Easing easing = EASING_SMOOTH;
+};
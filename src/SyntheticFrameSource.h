@@ -0,0 +1,76 @@
+/*
+ * AI Dance Mirror
+ *
+ * Deterministic synthetic frame generator.
+ */
+#pragma once
+
+#include "FrameSource.h"
+
+/// \class SyntheticFrameSource
+/// \brief generates a deterministic moving test pattern
+///
+/// the pattern only depends on the frame size and frame index: a static
+/// gradient background with a moving block standing in for a dancer, so
+/// frames are identical between runs and machines
+class SyntheticFrameSource : public FrameSource {
+	public:
+
+		SyntheticFrameSource(int width=640, int height=480) {
+			this->width = width;
+			this->height = height;
+		}
+
+		bool open() {
+			index = 0;
+			finished = false;
+			startPacing();
+			return width > 0 && height > 0;
+		}
+
+		bool grab(Frame & frame) {
+			pacer.wait();
+			render(frame.pixels, index, width, height);
+			frame.sourceTime = stepTime(index);
+			index++;
+			return true;
+		}
+
+		std::string getName() const {
+			return "synthetic " + ofToString(width) + "x" + ofToString(height);
+		}
+
+		/// render pattern frame index into pixels
+		static void render(ofPixels & pixels, uint64_t index, int width, int height) {
+			pixels.allocate(width, height, OF_PIXELS_RGB);
+			unsigned char * p = pixels.getData();
+
+			// moving block, one full sweep every 4 s at 30 fps
+			int blockW = width / 4;
+			int blockH = height * 2 / 3;
+			int travel = width - blockW;
+			int phase = (int)(index % 240);
+			int blockX = (phase < 120 ? phase : 240 - phase) * travel / 120;
+			int blockY = (height - blockH) / 2;
+
+			for(int y = 0; y < height; y++) {
+				for(int x = 0; x < width; x++, p += 3) {
+					if(x >= blockX && x < blockX + blockW &&
+					   y >= blockY && y < blockY + blockH) {
+						bool check = ((x - blockX) / 16 + (y - blockY) / 16) & 1;
+						p[0] = check ? 240 : 200;
+						p[1] = check ? 80 : 40;
+						p[2] = 40;
+					}
+					else {
+						p[0] = (unsigned char)(x * 255 / width);
+						p[1] = (unsigned char)(y * 255 / height);
+						p[2] = 128;
+					}
+				}
+			}
+		}
+
+	private:
+		uint64_t index = 0; ///< next frame index
+};
@@ -0,0 +1,93 @@
+/*
+ * AI Dance Mirror
+ *
+ * Reusable float tensor buffers.
+ */
+#pragma once
+
+#include "ofxTensorFlow2.h"
+#include <atomic>
+#include <cstdlib>
+
+/// \class TensorBufferPool
+/// \brief hands out tensors backed by reusable, aligned float buffers
+///
+/// the returned cppflow tensor wraps the buffer without copying it, callers
+/// write their data directly into it; the buffer returns to the pool when
+/// TensorFlow releases the last reference to the tensor, so a buffer still
+/// in use by an in-flight inference is never overwritten
+///
+/// buffers are reallocated when the requested size changes, the pool grows if
+/// all buffers are in flight
+class TensorBufferPool {
+	public:
+
+		/// TensorFlow requires 64 byte alignment for zero-copy tensors
+		static const std::size_t ALIGNMENT = 64;
+
+		/// return a float tensor of the given shape and set data to its buffer
+		cppflow::tensor allocate(const std::vector<int64_t> & shape, float *& data) {
+			std::size_t count = 1;
+			for(auto dim : shape) {
+				count *= dim;
+			}
+			std::shared_ptr<Buffer> buffer = acquire(count);
+			data = buffer->data;
+
+			// the deallocator argument keeps the buffer alive until TF is done
+			auto * owner = new std::shared_ptr<Buffer>(buffer);
+			TF_Tensor * tensor = TF_NewTensor(TF_FLOAT, shape.data(), shape.size(),
+			                                  buffer->data, count * sizeof(float),
+			                                  &TensorBufferPool::release, owner);
+			return cppflow::tensor(tensor);
+		}
+
+		/// number of buffers allocated so far
+		std::size_t size() const {return buffers.size();}
+
+	private:
+
+		struct Buffer {
+			float * data = nullptr;
+			std::size_t count = 0; ///< number of floats
+			std::atomic<bool> inUse{false};
+			~Buffer() {std::free(data);}
+		};
+
+		/// find a free buffer, reallocate or add one as needed
+		std::shared_ptr<Buffer> acquire(std::size_t count) {
+			for(auto & buffer : buffers) {
+				bool expected = false;
+				if(buffer->inUse.compare_exchange_strong(expected, true)) {
+					if(buffer->count != count) {
+						resize(*buffer, count);
+					}
+					return buffer;
+				}
+			}
+			auto buffer = std::make_shared<Buffer>();
+			buffer->inUse = true;
+			resize(*buffer, count);
+			buffers.push_back(buffer);
+			if(buffers.size() > 8) {
+				ofLogWarning("TensorBufferPool") << buffers.size() << " buffers in flight, are tensors leaking?";
+			}
+			return buffer;
+		}
+
+		static void resize(Buffer & buffer, std::size_t count) {
+			std::free(buffer.data);
+			std::size_t bytes = (count * sizeof(float) + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+			buffer.data = (float *)std::aligned_alloc(ALIGNMENT, bytes);
+			buffer.count = count;
+		}
+
+		/// TF_NewTensor deallocator, may be called from any thread
+		static void release(void * data, std::size_t length, void * arg) {
+			auto * owner = (std::shared_ptr<Buffer> *)arg;
+			(*owner)->inUse = false;
+			delete owner;
+		}
+
+		std::vector<std::shared_ptr<Buffer>> buffers;
+};
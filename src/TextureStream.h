@@ -0,0 +1,299 @@
+/*
+ * AI Dance Mirror
+ *
+ * Streaming texture uploads through a ring of pixel buffer objects.
+ */
+#pragma once
+
+#include "PixelSpan.h"
+#include <mutex>
+
+/// \class TextureStream
+/// \brief texture fed from any thread through mapped pixel buffer objects
+///
+/// the GL thread keeps a ring of buffers mapped; a writer thread, ie. the
+/// frame grabber or the pipeline's postprocess stage, writes 8 bit pixels
+/// straight into a mapped buffer, so the render thread never copies frames;
+/// update() unmaps the newest written buffer and starts an asynchronous
+/// upload from it, the buffer is mapped again once a fence shows the upload
+/// has finished
+///
+///     GL: map -> [mapped] -> writer: beginWrite() ... endWrite()
+///         -> [written] -> GL: update(): unmap, upload, fence -> [uploading]
+///
+/// with 3 buffers one can be written while one uploads and one waits; if the
+/// writer is faster than the display, older written buffers are reused
+/// without being uploaded
+///
+/// beginWrite() & write() may be called from any thread, ie. the pipeline's
+/// postprocess stage and the GL thread writing unstreamed outputs; one frame
+/// is written at a time, other writers get no buffer until the thread which
+/// began it calls endWrite(); all other functions from the GL thread only
+class TextureStream {
+	public:
+
+		/// counters
+		struct Stats {
+			uint64_t written = 0; ///< frames written into buffers
+			uint64_t uploaded = 0; ///< frames uploaded to the texture
+			uint64_t skipped = 0; ///< written frames replaced before upload
+			uint64_t busy = 0; ///< writes without a free buffer
+			uint64_t direct = 0; ///< synchronous loadData() fallbacks
+		};
+
+		~TextureStream() {
+			clear();
+		}
+
+		/// set up count buffers for width x height frames with up to
+		/// channels bytes per pixel, larger frames grow the buffers
+		void allocate(int width, int height, int channels=3, int count=3) {
+			clear();
+			std::lock_guard<std::mutex> lock(mutex);
+			required = (std::size_t)width * height * channels;
+			buffers.resize(std::min(std::max(count, 2), (int)MAX_BUFFERS));
+			for(auto & buffer : buffers) {
+				buffer.object.allocate(required, GL_STREAM_DRAW);
+				buffer.capacity = required;
+			}
+			texture.allocate(width, height, GL_RGB);
+			textureWidth = width;
+			textureHeight = height;
+			mapFree();
+		}
+
+		/// unmap & release the buffers, the writer must have stopped
+		void clear() {
+			std::lock_guard<std::mutex> lock(mutex);
+			for(auto & buffer : buffers) {
+				if(buffer.state == MAPPED || buffer.state == WRITING || buffer.state == WRITTEN) {
+					buffer.object.unmapRange();
+				}
+				if(buffer.fence) {
+					glDeleteSync(buffer.fence);
+				}
+			}
+			buffers.clear();
+			writing = -1;
+		}
+
+		bool isAllocated() const {return !buffers.empty();}
+
+		/// pointer to width x height pixels with packed rows to write a frame
+		/// into, nullptr if no buffer is free; finish with endWrite()
+		unsigned char * beginWrite(int width, int height, PixelSpan::Layout layout) {
+			std::lock_guard<std::mutex> lock(mutex);
+			if(writing >= 0 || width <= 0 || height <= 0) {
+				return nullptr;
+			}
+			std::size_t size = (std::size_t)width * height * PixelSpan::channels(layout);
+			for(std::size_t i = 0; i < buffers.size(); i++) {
+				Buffer & buffer = buffers[i];
+				if(buffer.state == MAPPED && buffer.capacity >= size) {
+					buffer.state = WRITING;
+					buffer.width = width;
+					buffer.height = height;
+					buffer.layout = layout;
+					writing = (int)i;
+					return buffer.data;
+				}
+			}
+			// grown by the next update() if too small
+			required = std::max(required, size);
+			stats.busy++;
+			return nullptr;
+		}
+
+		/// finish the frame started by beginWrite(), commit false discards it
+		void endWrite(bool commit=true) {
+			std::lock_guard<std::mutex> lock(mutex);
+			if(writing < 0) {
+				return;
+			}
+			Buffer & buffer = buffers[writing];
+			buffer.state = (commit ? WRITTEN : MAPPED);
+			buffer.sequence = ++sequence;
+			writing = -1;
+			if(commit) {
+				stats.written++;
+			}
+		}
+
+		/// copy a frame into a buffer, returns false if no buffer is free
+		bool write(const PixelSpan & pixels) {
+			if(!pixels.isValid()) {
+				return false;
+			}
+			unsigned char * data = beginWrite(pixels.width, pixels.height, pixels.layout);
+			if(!data) {
+				return false;
+			}
+			const std::size_t rowBytes = (std::size_t)pixels.width * pixels.getNumChannels();
+			if(pixels.isContiguous()) {
+				std::memcpy(data, pixels.data, rowBytes * pixels.height);
+			}
+			else {
+				for(int y = 0; y < pixels.height; y++) {
+					std::memcpy(data + y * rowBytes, pixels.row(y), rowBytes);
+				}
+			}
+			endWrite();
+			return true;
+		}
+
+		/// upload the newest written frame and map buffers whose uploads
+		/// finished, never waits for the GPU, returns true if the texture
+		/// changed; call once per frame on the GL thread
+		bool update() {
+			std::lock_guard<std::mutex> lock(mutex);
+			int newest = -1;
+			for(std::size_t i = 0; i < buffers.size(); i++) {
+				if(buffers[i].state == WRITTEN &&
+				   (newest < 0 || buffers[i].sequence > buffers[newest].sequence)) {
+					newest = (int)i;
+				}
+			}
+			for(std::size_t i = 0; i < buffers.size(); i++) {
+				if(buffers[i].state == WRITTEN && (int)i != newest) {
+					buffers[i].state = MAPPED; // still mapped, write again
+					stats.skipped++;
+				}
+			}
+			if(newest >= 0) {
+				Buffer & buffer = buffers[newest];
+				buffer.object.unmapRange();
+				buffer.data = nullptr;
+				upload(buffer.object, buffer.width, buffer.height, buffer.layout);
+				buffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+				buffer.state = UPLOADING;
+				stats.uploaded++;
+			}
+			mapFree();
+			return newest >= 0;
+		}
+
+		/// synchronous upload from the GL thread, for frames which could not
+		/// be written into a buffer
+		void loadData(const PixelSpan & pixels) {
+			if(!pixels.isValid()) {
+				return;
+			}
+			if(!pixels.isContiguous()) {
+				// padded rows, repack
+				ofPixels packed;
+				packed.allocate(pixels.width, pixels.height, pixels.getNumChannels());
+				for(int y = 0; y < pixels.height; y++) {
+					std::memcpy(packed.getData() + y * packed.getBytesStride(), pixels.row(y), packed.getBytesStride());
+				}
+				loadData(PixelSpan(packed.getData(), pixels.width, pixels.height, pixels.layout));
+				return;
+			}
+			resize(pixels.width, pixels.height);
+			texture.loadData(pixels.data, pixels.width, pixels.height, getGLFormat(pixels.layout));
+			std::lock_guard<std::mutex> lock(mutex);
+			stats.direct++;
+		}
+
+		void draw(float x, float y, float width, float height) const {
+			texture.draw(x, y, width, height);
+		}
+
+		ofTexture & getTexture() {return texture;}
+
+		Stats getStats() const {
+			std::lock_guard<std::mutex> lock(mutex);
+			return stats;
+		}
+
+		/// GL upload format of a pixel layout
+		static int getGLFormat(PixelSpan::Layout layout) {
+			switch(layout) {
+				case PixelSpan::BGR: return GL_BGR;
+				case PixelSpan::RGBA: return GL_RGBA;
+				case PixelSpan::BGRA: return GL_BGRA;
+				default: return GL_RGB;
+			}
+		}
+
+		static const int MAX_BUFFERS = 4; ///< max ring size
+
+	protected:
+
+		/// buffer states, see class description
+		enum State {
+			FREE, ///< unmapped, not in use
+			MAPPED, ///< mapped, ready for the writer
+			WRITING, ///< being written
+			WRITTEN, ///< mapped & holding a frame
+			UPLOADING ///< unmapped, upload pending until the fence signals
+		};
+
+		struct Buffer {
+			ofBufferObject object;
+			std::size_t capacity = 0; ///< bytes
+			State state = FREE;
+			unsigned char * data = nullptr; ///< mapped memory
+			GLsync fence = nullptr; ///< upload finished
+			int width = 0, height = 0; ///< written frame size
+			PixelSpan::Layout layout = PixelSpan::RGB;
+			uint64_t sequence = 0; ///< write order
+		};
+
+		/// upload from a bound unpack buffer, reallocates the texture if
+		/// the frame size changed
+		void upload(const ofBufferObject & object, int width, int height, PixelSpan::Layout layout) {
+			resize(width, height);
+			texture.loadData(object, getGLFormat(layout), GL_UNSIGNED_BYTE);
+		}
+
+		void resize(int width, int height) {
+			if(width != textureWidth || height != textureHeight) {
+				texture.allocate(width, height, GL_RGB);
+				textureWidth = width;
+				textureHeight = height;
+			}
+		}
+
+		/// map buffers whose uploads have finished, grow them if frames no
+		/// longer fit, must hold mutex
+		void mapFree() {
+			for(auto & buffer : buffers) {
+				if(buffer.state == UPLOADING) {
+					GLenum status = glClientWaitSync(buffer.fence, 0, 0); // poll, never wait
+					if(status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+						continue;
+					}
+					glDeleteSync(buffer.fence);
+					buffer.fence = nullptr;
+					buffer.state = FREE;
+				}
+				if(buffer.state == MAPPED && buffer.capacity < required) {
+					buffer.object.unmapRange();
+					buffer.data = nullptr;
+					buffer.state = FREE;
+				}
+				if(buffer.state != FREE) {
+					continue;
+				}
+				if(buffer.capacity < required) {
+					buffer.object.allocate(required, GL_STREAM_DRAW);
+					buffer.capacity = required;
+				}
+				// the fence guarantees the GPU is done with the old contents
+				buffer.data = (unsigned char *)buffer.object.mapRange(0, buffer.capacity,
+					GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+				if(buffer.data) {
+					buffer.state = MAPPED;
+				}
+			}
+		}
+
+		std::vector<Buffer> buffers;
+		int writing = -1; ///< buffer being written, -1 for none
+		uint64_t sequence = 0; ///< last write
+		std::size_t required = 0; ///< bytes the largest frame needs
+		ofTexture texture;
+		int textureWidth = 0, textureHeight = 0;
+		mutable std::mutex mutex; ///< guards buffer states
+		Stats stats;
+};
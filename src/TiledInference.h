@@ -0,0 +1,209 @@
+/*
+ * AI Dance Mirror
+ *
+ * Overlapping tile inference with feathered seams for large model inputs.
+ */
+#pragma once
+
+#include "TensorBufferPool.h"
+#include "PixelSpan.h"
+#include <functional>
+#include <mutex>
+
+/// \class TiledInference
+/// \brief runs a model on overlapping tiles of a large input and blends
+///        the tile outputs back into a full size output
+///
+/// the model only ever sees batch x tile x tile inputs, so its activation
+/// memory is bounded by the tile & batch size instead of growing with the
+/// output resolution; all tiles have the same size, which keeps a single
+/// graph shape: tiles step by tile - overlap and the last row & column are
+/// shifted back to end at the frame border
+///
+/// outputs are blended with weights ramping from 0 to 1 over the overlap
+/// along tile edges inside the frame, normalized by the weight sum, so seams
+/// are feathered and the frame border is unaffected
+///
+/// run() may be called from several threads at once
+class TiledInference {
+	public:
+
+		/// tile settings
+		struct Options {
+			int tileSize = 0; ///< tile width & height, multiple of 32, 0 disables tiling
+			int overlap = 64; ///< tile overlap & feather width, multiple of 32
+			int batch = 1; ///< tiles per model run
+		};
+
+		/// model run on a batch of tiles: NHWC in, NHWC out
+		typedef std::function<cppflow::tensor(const cppflow::tensor & tiles)> RunFunction;
+
+		/// set tile options, sizes are rounded up to multiples of 32
+		void setOptions(const Options & options) {
+			std::lock_guard<std::mutex> lock(mutex);
+			this->options.tileSize = (options.tileSize > 0 ? roundUp(options.tileSize) : 0);
+			this->options.overlap = std::min(roundUp(std::max(options.overlap, 0)),
+			                                 std::max(this->options.tileSize - 32, 0));
+			this->options.batch = std::max(options.batch, 1);
+		}
+
+		Options getOptions() const {
+			std::lock_guard<std::mutex> lock(mutex);
+			return options;
+		}
+
+		/// does a width x height model input need tiles?
+		bool isTiled(int width, int height) const {
+			std::lock_guard<std::mutex> lock(mutex);
+			return options.tileSize > 0 && (width > options.tileSize || height > options.tileSize);
+		}
+
+		/// run a 1xHxWx3 float input through function in tiles, returns the
+		/// 1xHxWx3 blended output, inputs which fit in a tile run as they are
+		cppflow::tensor run(const cppflow::tensor & input, const RunFunction & function) {
+			std::vector<int64_t> shape = input.shape(); // NHWC
+			if(shape.size() != 4 || shape[0] != 1 || shape[3] != 3 || !isTiled((int)shape[2], (int)shape[1])) {
+				return function(input);
+			}
+			const Options settings = getOptions();
+			const int width = (int)shape[2], height = (int)shape[1];
+			const int tileWidth = std::min(settings.tileSize, width);
+			const int tileHeight = std::min(settings.tileSize, height);
+			std::vector<PixelRect> tiles = layout(width, height, tileWidth, tileHeight, settings.overlap);
+
+			std::shared_ptr<TF_Tensor> inputData = input.get_tensor();
+			const float * src = (const float *)TF_TensorData(inputData.get());
+			float * dst = nullptr;
+			cppflow::tensor output = allocate({1, height, width, 3}, dst);
+			std::fill(dst, dst + (std::size_t)width * height * 3, 0.f);
+			std::vector<float> weights((std::size_t)width * height, 0.f);
+			std::vector<float> rampX = ramp(tileWidth, settings.overlap);
+			std::vector<float> rampY = ramp(tileHeight, settings.overlap);
+
+			for(std::size_t first = 0; first < tiles.size(); first += settings.batch) {
+				const int count = (int)std::min((std::size_t)settings.batch, tiles.size() - first);
+				float * batch = nullptr;
+				cppflow::tensor batchTensor = allocate({count, tileHeight, tileWidth, 3}, batch);
+				for(int i = 0; i < count; i++) {
+					copyTile(src, width, tiles[first + i], batch + (std::size_t)i * tileWidth * tileHeight * 3);
+				}
+				cppflow::tensor result = function(batchTensor);
+				std::vector<int64_t> resultShape = result.shape();
+				if(resultShape.size() != 4 || resultShape[0] != count || resultShape[3] != 3) {
+					ofLogError("TiledInference") << "unexpected tile output shape";
+					return output;
+				}
+				if(resultShape[1] != tileHeight || resultShape[2] != tileWidth) {
+					result = cppflow::resize_bicubic(result, cppflow::tensor({tileHeight, tileWidth}), true);
+				}
+				std::shared_ptr<TF_Tensor> resultData = result.get_tensor();
+				const float * out = (const float *)TF_TensorData(resultData.get());
+				for(int i = 0; i < count; i++) {
+					const PixelRect & tile = tiles[first + i];
+					// only edges inside the frame are feathered
+					accumulate(out + (std::size_t)i * tileWidth * tileHeight * 3, tile, width, height,
+					           rampX, rampY, dst, weights);
+				}
+			}
+
+			for(std::size_t i = 0; i < weights.size(); i++) {
+				float scale = 1.f / std::max(weights[i], 1e-6f);
+				dst[i * 3 + 0] *= scale;
+				dst[i * 3 + 1] *= scale;
+				dst[i * 3 + 2] *= scale;
+			}
+			return output;
+		}
+
+		/// tile rectangles covering width x height, all tileWidth x tileHeight
+		static std::vector<PixelRect> layout(int width, int height, int tileWidth, int tileHeight, int overlap) {
+			std::vector<int> xs = positions(width, tileWidth, overlap);
+			std::vector<int> ys = positions(height, tileHeight, overlap);
+			std::vector<PixelRect> tiles;
+			for(int y : ys) {
+				for(int x : xs) {
+					tiles.push_back(PixelRect(x, y, tileWidth, tileHeight));
+				}
+			}
+			return tiles;
+		}
+
+		/// number of tiles for a width x height input
+		int getTileCount(int width, int height) const {
+			Options settings = getOptions();
+			if(!isTiled(width, height)) {
+				return 1;
+			}
+			return (int)(positions(width, std::min(settings.tileSize, width), settings.overlap).size() *
+			             positions(height, std::min(settings.tileSize, height), settings.overlap).size());
+		}
+
+	protected:
+
+		static int roundUp(int n) {
+			return (n + 31) / 32 * 32;
+		}
+
+		/// tile starts along one axis, the last one ends at size
+		static std::vector<int> positions(int size, int tile, int overlap) {
+			std::vector<int> starts;
+			int step = std::max(tile - overlap, 1);
+			for(int start = 0; ; start += step) {
+				if(start + tile >= size) {
+					starts.push_back(std::max(size - tile, 0));
+					break;
+				}
+				starts.push_back(start);
+			}
+			return starts;
+		}
+
+		/// blend weights along one tile axis: 0 - 1 over overlap at both ends
+		static std::vector<float> ramp(int size, int overlap) {
+			std::vector<float> weights(size, 1.f);
+			for(int i = 0; i < size && overlap > 0; i++) {
+				float edge = std::min(i, size - 1 - i) + 0.5f;
+				weights[i] = std::min(edge / overlap, 1.f);
+			}
+			return weights;
+		}
+
+		static void copyTile(const float * src, int width, const PixelRect & tile, float * dst) {
+			for(int y = 0; y < tile.height; y++) {
+				const float * row = src + ((std::size_t)(tile.y + y) * width + tile.x) * 3;
+				std::copy(row, row + tile.width * 3, dst + (std::size_t)y * tile.width * 3);
+			}
+		}
+
+		/// add a weighted tile output, edges on the frame border get full weight
+		static void accumulate(const float * tileData, const PixelRect & tile, int width, int height,
+		                       const std::vector<float> & rampX, const std::vector<float> & rampY,
+		                       float * dst, std::vector<float> & weights) {
+			for(int y = 0; y < tile.height; y++) {
+				bool top = (tile.y == 0 && y < tile.height / 2);
+				bool bottom = (tile.y + tile.height == height && y >= tile.height / 2);
+				float wy = (top || bottom) ? 1.f : rampY[y];
+				const float * in = tileData + (std::size_t)y * tile.width * 3;
+				std::size_t row = (std::size_t)(tile.y + y) * width + tile.x;
+				for(int x = 0; x < tile.width; x++) {
+					bool left = (tile.x == 0 && x < tile.width / 2);
+					bool right = (tile.x + tile.width == width && x >= tile.width / 2);
+					float w = wy * ((left || right) ? 1.f : rampX[x]);
+					float * out = dst + (row + x) * 3;
+					out[0] += in[x * 3 + 0] * w;
+					out[1] += in[x * 3 + 1] * w;
+					out[2] += in[x * 3 + 2] * w;
+					weights[row + x] += w;
+				}
+			}
+		}
+
+		cppflow::tensor allocate(const std::vector<int64_t> & shape, float *& data) {
+			std::lock_guard<std::mutex> lock(mutex);
+			return buffers.allocate(shape, data);
+		}
+
+		Options options;
+		TensorBufferPool buffers; ///< tile batches & outputs
+		mutable std::mutex mutex; ///< guards options & buffers
+};
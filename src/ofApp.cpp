@@ -11,147 +11,553 @@ void ofApp::setup() {
 	ofSetVerticalSync(true);
 	ofSetWindowTitle("AI Dance Mirror - RealSense Style Transfer");
 
-	// ofxTF2 setup with GPU detection
-	ofLogNotice() << "=== TensorFlow GPU Setup ===";
-	ofLogNotice() << "Attempting to configure GPU memory...";
-	
-	// Create a simple test to check if GPU is available before proceeding
-	bool gpuAvailable = false;
-	
-	// Try to set GPU memory - this will fail if no GPU is available
-	if(!ofxTF2::setGPUMaxMemory(ofxTF2::GPU_PERCENT_50, true)) {
-		ofLogError() << "❌ CRITICAL: Failed to set GPU Memory options!";
-		ofLogError() << "❌ CRITICAL: No GPU detected or CUDA libraries not available!";
-		ofLogError() << "❌ CRITICAL: This application requires GPU acceleration!";
-		ofLogError() << "❌ CRITICAL: Exiting application...";
+	// slow independent steps run concurrently: the model loads while the
+	// camera is enumerated, GL setup follows in finishSetup() once all are done
+	styleTransfer.setUseTexture(false); // outputStream is drawn, set up off the main thread
+	startup.add("device", [this] {
+		// pick the inference device before any model is loaded: GPU if
+		// available, otherwise CPU at a reduced default model size
+		InferenceDevice::Type device = InferenceDevice::configure(settings.device, settings.threads, settings.precision);
+		if(settings.device == InferenceDevice::DEVICE_GPU && device != InferenceDevice::DEVICE_GPU) {
+			ofLogWarning() << "GPU requested but not available";
+		}
+		if(device == InferenceDevice::DEVICE_CPU && !settings.modelSizeSet) {
+			settings.modelWidth = AppSettings::CPU_MODEL_WIDTH;
+			settings.modelHeight = AppSettings::CPU_MODEL_HEIGHT;
+		}
+		ofLogNotice() << "Inference device: " << InferenceDevice::getDescription()
+			<< ", model size " << settings.modelWidth << "x" << settings.modelHeight;
+		return true;
+	});
+	startup.add("model", [this] {
+		std::string modelPath = settings.getModelPath(0);
+		if(settings.precision == ModelSession::PRECISION_INT8 && modelPath == settings.models.front()) {
+			ofLogWarning() << "No int8 variant " << ModelSession::precisionPath(modelPath, settings.precision)
+				<< ", run quantize_model.sh first, using fp32";
+		}
+		ofLogNotice() << "Loading TensorFlow model from: " << modelPath;
+		// tile shape before setup, so the warm-up runs the tile graph
+		if(settings.tiling.tileSize > 0) {
+			if(settings.pipelineDepth == 0) {
+				ofLogNotice() << "Tiled inference needs the pipeline, running whole frames";
+			}
+			else {
+				styleTransfer.setTiling(settings.tiling);
+			}
+		}
+		if(!styleTransfer.setup(settings.modelWidth, settings.modelHeight, modelPath)) {
+			ofLogError() << "Failed to load style transfer model!";
+			return false;
+		}
+		ofLogNotice() << "Style transfer model loaded successfully";
+		return true;
+	}, {"device"});
+	startup.add("source", [this] {
+		source = createFrameSource(settings.source, settings.cameraWidth, settings.cameraHeight, settings.fps);
+		if(!source) {
+			return false;
+		}
+		source->setPacing(settings.pacing);
+		source->setLoop(settings.loop);
+		source->setDepth(settings.roi);
+		if(!source->open()) {
+			ofLogError() << "Failed to open input source: " << source->getName();
+			ofLogError() << "Use --source synthetic or --source images:<folder> to run without a camera";
+			return false;
+		}
+		ofLogNotice() << "Input source started: " << source->getName();
+		for(auto & spec : settings.extraSources) {
+			std::unique_ptr<InputStream> stream(new InputStream());
+			stream->source = createFrameSource(spec, settings.cameraWidth, settings.cameraHeight, settings.fps);
+			if(!stream->source) {
+				return false;
+			}
+			stream->source->setPacing(settings.pacing);
+			stream->source->setLoop(settings.loop);
+			if(!stream->source->open()) {
+				ofLogError() << "Failed to open input source: " << stream->source->getName();
+				return false;
+			}
+			ofLogNotice() << "Input source " << streams.size() + 2 << " started: " << stream->source->getName();
+			streams.push_back(std::move(stream));
+		}
+		return true;
+	});
+	startup.add("styles", [this] {
+		// map precompiled style pack if available, its entries stand in for
+		// missing or unchanged images of the style folder
+		auto pack = std::make_shared<StylePack>();
+		if(!ofFile::doesFileExist(settings.stylePack) || !pack->open(settings.stylePack) ||
+		   !StyleCache::isCompatible(*pack, styleTransfer)) {
+			pack = nullptr;
+		}
+
+		// prepare all styles up front so switching styles never decodes
+		// images, later changes to the folder are prepared in the background
+		styleLibrary.start(styleTransfer, settings.styleDir, pack, settings.styleThreads);
+		styleLibrary.waitIdle();
+		std::size_t numStyles = styleLibrary.getEntries()->size();
+		ofLogNotice() << "Prepared " << numStyles << " styles from " << settings.styleDir
+			<< (pack ? " & " + settings.stylePack : "")
+			<< (styleTransfer.usesStyleBottleneck() ? " (style bottlenecks)" : "");
+		if(numStyles == 0) {
+			ofLogWarning() << "No style images in " << settings.styleDir << ", add some while running";
+		}
+		return true;
+	}, {"model"});
+	startup.start();
+}
+
+//--------------------------------------------------------------
+void ofApp::finishSetup() {
+	startup.wait();
+	if(!startup.isSuccessful()) {
+		ofLogError() << "Startup failed\n" << startup.getSummary();
 		std::exit(EXIT_FAILURE);
-	} else {
-		ofLogNotice() << "✓ GPU memory configured successfully";
-		gpuAvailable = true;
 	}
-	
-	// Additional GPU check using environment detection
-	if (gpuAvailable) {
-		// Check if CUDA_VISIBLE_DEVICES is set and valid
-		const char* cudaDevices = std::getenv("CUDA_VISIBLE_DEVICES");
-		if (cudaDevices == nullptr || strlen(cudaDevices) == 0) {
-			ofLogWarning() << "CUDA_VISIBLE_DEVICES not set, setting to 0";
-			setenv("CUDA_VISIBLE_DEVICES", "0", 1);
+
+	// Allocate textures, fed through mapped upload buffers
+	cameraStream.allocate(source->getWidth(), source->getHeight(), 4);
+	sourceInitialized = true;
+
+	// capture on a background thread so update() never waits for the source,
+	// the preview copy into an upload buffer happens there too
+	grabber.start([this](Frame & frame) {
+		if(!source->grab(frame)) {
+			return false;
 		}
-		
-		ofLogNotice() << "✓ GPU environment validated";
-		ofLogNotice() << "✓ Proceeding with GPU-accelerated style transfer";
+		cameraStream.write(frame.getSpan());
+		return true;
+	});
+	for(auto & stream : streams) {
+		InputStream * input = stream.get();
+		input->camera.allocate(input->source->getWidth(), input->source->getHeight(), 4);
+		input->grabber.start([input](Frame & frame) {
+			if(!input->source->grab(frame)) {
+				return false;
+			}
+			input->camera.write(frame.getSpan());
+			return true;
+		});
 	}
 
-	// load model
-	ofLogNotice() << "Loading TensorFlow model from: models/my_model";
-	if(!styleTransfer.setup(imageWidth, imageHeight, "models/my_model")) {
-		ofLogError() << "Failed to load style transfer model!";
-		std::exit(EXIT_FAILURE);
+	// several sources run as one batch per model step, the single stream
+	// options below do not apply
+	if(batched()) {
+		if(settings.reuse != ChangeDetector::MODE_OFF || settings.roi || settings.guidedUpsampling) {
+			ofLogNotice() << "Reuse, dancer region & guided upsampling need a single source, disabled";
+		}
+		settings.reuse = ChangeDetector::MODE_OFF;
+		settings.roi = false;
+		settings.guidedUpsampling = false;
 	}
-	ofLogNotice() << "Style transfer model loaded successfully";
-	
-	#ifdef USE_REALSENSE_CAMERA
-	// Configure RealSense streams
-	cfg.enable_stream(RS2_STREAM_COLOR, cameraWidth, cameraHeight, RS2_FORMAT_RGB8, fps);
-	
-	// Start RealSense pipeline
-	try {
-		pipe.start(cfg);
-		cameraInitialized = true;
-		ofLogNotice() << "RealSense D435 started successfully";
-		
-		// Allocate textures and images
-		colorTex.allocate(cameraWidth, cameraHeight, GL_RGB);
-		colorImage.allocate(cameraWidth, cameraHeight, OF_IMAGE_COLOR);
-		
-	} catch (const rs2::error & e) {
-		ofLogError() << "Failed to start RealSense: " << e.what();
-		cameraInitialized = false;
-		std::exit(EXIT_FAILURE);
+
+	// static frames reuse the last output, changed regions are blended
+	// into it by the pipeline
+	ChangeDetector::Mode reuse = settings.reuse;
+	if(reuse == ChangeDetector::MODE_TILES && settings.pipelineDepth == 0) {
+		ofLogNotice() << "Tile reuse needs the pipeline, skipping static frames only";
+		reuse = ChangeDetector::MODE_SKIP;
+	}
+	changes.setMode(reuse);
+	changes.setThreshold(settings.reuseThreshold);
+
+	// stylize only the dancer, the rest of the output is the last full
+	// frame, refreshed every few seconds
+	bool roi = settings.roi;
+	if(roi && settings.pipelineDepth == 0) {
+		ofLogNotice() << "Dancer region needs the pipeline, stylizing full frames";
+		roi = false;
+	}
+	else if(roi && !source->hasDepth()) {
+		ofLogWarning() << "No depth in " << source->getName() << ", stylizing full frames";
+		roi = false;
+	}
+	dancer.setEnabled(roi);
+	dancer.setRange(settings.roiNear, settings.roiFar);
+
+	// run the model at a fraction of the camera size and upsample with the
+	// camera frame as guide
+	bool guided = settings.guidedUpsampling;
+	if(guided && settings.pipelineDepth == 0) {
+		ofLogNotice() << "Guided upsampling needs the pipeline, resizing bicubic";
+		guided = false;
+	}
+	if(guided) {
+		if(!settings.modelSizeSet) {
+			settings.modelWidth = std::max((int)(source->getWidth() * settings.inferenceScale), 32);
+			settings.modelHeight = std::max((int)(source->getHeight() * settings.inferenceScale), 32);
+			styleTransfer.setSize(settings.modelWidth, settings.modelHeight);
+		}
+		ofLogNotice() << "Model size " << styleTransfer.getModelWidth() << "x" << styleTransfer.getModelHeight()
+			<< ", guided upsampling to " << source->getWidth() << "x" << source->getHeight();
 	}
-	#endif
-	
-	// set initial style
-	setStyle(stylePaths[styleIndex]);
-	
-	// start processing thread
-	styleTransfer.startThread();
 
-	// output image
-	imgOut.allocate(imageWidth, imageHeight, OF_IMAGE_COLOR);
+	// output textures, resized to the output as needed
+	outputStream.allocate(settings.modelWidth, settings.modelHeight);
+	for(auto & stream : streams) {
+		stream->output.allocate(settings.modelWidth, settings.modelHeight);
+	}
+
+	// initial style of every stream
+	updateStyleLibrary();
+
+	// start processing: batched streams, staged pipeline, or single model thread
+	if(batched()) {
+		batcher.start(styleTransfer, (int)streams.size() + 1, settings.batchTimeout);
+		// outputs are converted straight into the upload buffers
+		batcher.setOutputStream(0, &outputStream);
+		for(std::size_t i = 0; i < streams.size(); i++) {
+			batcher.setOutputStream(i + 1, &streams[i]->output);
+		}
+		// a different style per stream to start with
+		for(std::size_t i = 0; i <= streams.size() && !stylePaths.empty(); i++) {
+			getStyleIndex(i) = (styleIndex + i) % stylePaths.size();
+			setStyle(i, stylePaths[getStyleIndex(i)]);
+		}
+	}
+	else if(settings.pipelineDepth > 0 || styleTransfer.usesSession()) {
+		// session models have no model thread, depth 1 is the closest
+		int depth = std::max(settings.pipelineDepth, 1);
+		pipeline.setWorkers(settings.workers);
+		pipeline.setRegions(reuse == ChangeDetector::MODE_TILES || roi);
+		pipeline.setUpsampling(guided);
+		pipeline.setOutputStream(&outputStream);
+		pipeline.start(styleTransfer, depth);
+	}
+	else {
+		styleTransfer.startThread();
+	}
+
+	// preview batches run between live frames
+	preview.start(styleTransfer, 160, 128, settings.previewBatch);
+
+	// style morphs & the style cycle, timed from now
+	updateTransitionDuration();
+	cycleStart = ofGetElapsedTimef();
+	if(settings.styleCycle.value > 0) {
+		ofLogNotice() << "Style cycle every " << settings.styleCycle.toString()
+			<< " at " << settings.bpm << " bpm";
+	}
+
+	// record every frame's stages for the trace file
+	profiler.setTracing(!settings.traceFile.empty());
+
+	// model size ladder up to the configured size
+	resolution.setup(settings.modelWidth, settings.modelHeight);
+	resolution.setTargetFps(settings.targetFps);
+	if(resolution.isEnabled()) {
+		// outputs stay at the configured size, upscaled from smaller steps
+		styleTransfer.setOutputSize(settings.modelWidth, settings.modelHeight);
+		styleTransfer.setSize(resolution.getWidth(), resolution.getHeight());
+		ofLogNotice() << "Adaptive model size for " << settings.targetFps << " fps, "
+			<< resolution.getSteps().front().width << "x" << resolution.getSteps().front().height
+			<< " to " << resolution.getWidth() << "x" << resolution.getHeight();
+	}
+
+	ready = true;
+	ofLogNotice() << "Startup\n" << startup.getSummary()
+		<< "ready after " << ofToString(startup.getElapsed(), 0) << " ms";
 }
 
 //--------------------------------------------------------------
 void ofApp::update() {
-	#ifdef USE_REALSENSE_CAMERA
-	if (!cameraInitialized) return;
+	if(!ready) {
+		if(startup.isFinished()) {
+			finishSetup();
+		}
+		return;
+	}
 	
-	try {
-		// Wait for frames with timeout
-		rs2::frameset frames = pipe.wait_for_frames(1000);
+	// a model loaded in the background takes over from this frame on
+	applyModel();
+
+	// styles added, changed, or removed in the style folder
+	updateStyleLibrary();
+
+	// advance the style cycle & morphs before this frame's input is sent
+	float period = settings.styleCycle.getSeconds(settings.bpm);
+	if(period > 0 && ofGetElapsedTimef() - cycleStart >= period) {
+		cycleStart += period * std::floor((ofGetElapsedTimef() - cycleStart) / period);
+		cycleStyles();
+	}
+	for(std::size_t i = 0; i <= streams.size(); i++) {
+		applyStyle(i);
+	}
+
+	// Poll the latest captured frame, never blocks
+	if (grabber.poll()) {
+		// Read the frame in place: camera buffers are not copied, the
+		// grabber already wrote the preview into an upload buffer
+		Frame & frame = grabber.getFrame();
 		
-		// Get color frame
-		rs2::frame color = frames.get_color_frame();
-		if (color) {
-			// Load data into texture for display
-			colorTex.loadData((unsigned char*)color.get_data(), cameraWidth, cameraHeight, GL_RGB);
-			
-			// Update color image for style transfer processing
-			colorImage.setFromPixels((unsigned char*)color.get_data(), cameraWidth, cameraHeight, OF_IMAGE_COLOR);
-			
-			// Set input for style transfer
-			styleTransfer.setInput(colorImage.getPixels());
+		// Set input for style transfer
+		submitFrame(frame);
+		hasFrame = true;
+	}
+	for(std::size_t i = 0; i < streams.size(); i++) {
+		InputStream & stream = *streams[i];
+		if(stream.grabber.poll()) {
+			submitBatched(i + 1, stream.grabber.getFrame());
+			stream.hasFrame = true;
 		}
-		
-	} catch (const rs2::error & e) {
-		ofLogError() << "Frame capture error: " << e.what();
 	}
-	#endif
 	
 	// check if style transfer processing is complete
-	if(styleTransfer.update()) {
-		imgOut = styleTransfer.getOutput();
-		imgOut.update();
-		ofLog() << "Style transfer completed!";
+	if(batcher.isRunning()) {
+		if(batcher.poll(0)) {
+			presentOutput(batcher.getOutput(0).times, batcher.getOutput(0).pixels);
+		}
+		for(std::size_t i = 0; i < streams.size(); i++) {
+			if(batcher.poll(i + 1) && !batcher.getOutput(i + 1).streamed) {
+				streams[i]->output.loadData(PixelSpan(batcher.getOutput(i + 1).pixels));
+			}
+		}
+	}
+	else if(pipeline.isRunning()) {
+		uint64_t failed = pipeline.getStats().failed;
+		if(failed != pipelineFailed) {
+			// the detector's reference already holds the failed frames'
+			// changes, stylize the next frame in full
+			pipelineFailed = failed;
+			changes.invalidate();
+		}
+		if(pipeline.poll()) {
+			presentOutput(pipeline.getOutput().times, pipeline.getOutput().pixels);
+		}
+	}
+	else if(styleTransfer.update()) {
+		// the model thread does not report which frame an output belongs to,
+		// only upload & present are measured
+		presentOutput(FrameTimes(), styleTransfer.getOutput().getPixels());
+	}
+
+	if(showPreview && preview.poll(previewPixels)) {
+		previewTexture.loadData(previewPixels);
+	}
+
+	// start uploads of newly written buffers, remap finished ones
+	cameraStream.update();
+	outputStream.update();
+	for(auto & stream : streams) {
+		stream->camera.update();
+		stream->output.update();
 	}
 }
 
+//--------------------------------------------------------------
+void ofApp::presentOutput(const FrameTimes & times, const ofPixels & pixels) {
+	outputTimes = times;
+	outputTimes.uploadStart = ofGetElapsedTimeMicros();
+	if(pixels.isAllocated() && !outputStream.write(PixelSpan(pixels))) {
+		// no free upload buffer
+		outputStream.loadData(PixelSpan(pixels));
+	}
+	outputStream.update(); // streamed outputs are already in a buffer
+	outputTimes.uploadEnd = ofGetElapsedTimeMicros();
+	outputPresented = false;
+	adaptResolution();
+	preview.allowBatch(); // one preview batch per live output
+}
+
 //--------------------------------------------------------------
 void ofApp::draw() {
 	ofBackground(20);
+	if(!ready) {
+		drawStartup();
+		return;
+	}
 	
-	#ifdef USE_REALSENSE_CAMERA
-	if (cameraInitialized) {
+	if (sourceInitialized) {
 		// Draw original camera feed on the left
 		ofSetColor(255);
-		colorTex.draw(0, 0, 320, 240);
+		cameraStream.draw(0, 0, 320, 240);
+		if(dancer.isEnabled() && !dancer.getBox().isEmpty()) {
+			// stylized region on the camera preview
+			PixelRect box = dancer.getBox().scaled(source->getWidth(), source->getHeight(), 320, 240);
+			ofPushStyle();
+			ofNoFill();
+			ofSetColor(ofColor::green);
+			ofDrawRectangle(box.x, box.y, box.width, box.height);
+			ofPopStyle();
+		}
 		
 		// Draw style-transferred output on the right
-		imgOut.draw(340, 0, 320, 240);
+		outputStream.draw(340, 0, 320, 240);
 		
 		// Draw labels
 		ofSetColor(255);
-		ofDrawBitmapStringHighlight("Camera Input", 10, 20, ofColor::black, ofColor::white);
-		ofDrawBitmapStringHighlight("Style Transfer Output", 350, 20, ofColor::black, ofColor::white);
-		ofDrawBitmapStringHighlight("Current style: " + ofFilePath::getFileName(stylePaths[styleIndex]), 10, 260, ofColor::black, ofColor::green);
+		ofDrawBitmapStringHighlight("Input: " + source->getName(), 10, 20, ofColor::black, ofColor::white);
+		ofDrawBitmapStringHighlight("Style Transfer Output: " + ofFilePath::getFileName(settings.models[modelIndex]) +
+			(modelSwap.getState() != ModelSwap::STATE_IDLE ?
+				" (" + ofFilePath::getFileName(modelSwap.getPath()) + " " +
+				ModelSwap::toString(modelSwap.getState()) + ")" : ""), 350, 20, ofColor::black, ofColor::white);
+		ofDrawBitmapStringHighlight((batched() ? "Stream 1 style: " : "Current style: ") +
+			getStyleName(styleIndex) +
+			(transition.isActive() ? " " + ofToString(transition.getProgress(ofGetElapsedTimef()) * 100, 0) + "%" : ""), 10, 260,
+			ofColor::black, (selectedStream == 0 ? ofColor::green : ofColor::gray));
 		ofDrawBitmapStringHighlight("FPS: " + ofToString(ofGetFrameRate(), 1), 10, 280, ofColor::black, ofColor::green);
+		FrameGrabber::Stats stats = grabber.getStats();
+		ofDrawBitmapStringHighlight("Camera frames: " + ofToString(stats.captured) +
+			" dropped: " + ofToString(stats.dropped) +
+			" stale: " + ofToString(stats.stale), 10, 300, ofColor::black, ofColor::green);
+		ofDrawBitmapStringHighlight("Model size: " + ofToString(styleTransfer.getWidth()) + "x" +
+			ofToString(styleTransfer.getHeight()) + " on " + InferenceDevice::getDescription() +
+			(pipeline.getUpsampling() ? " guided to " + ofToString(source->getWidth()) + "x" +
+			                            ofToString(source->getHeight()) : "") +
+			(styleTransfer.getTiling().isTiled(styleTransfer.getWidth(), styleTransfer.getHeight()) ?
+				" tiles: " + ofToString(styleTransfer.getTiling().getTileCount(styleTransfer.getWidth(),
+				                                                                styleTransfer.getHeight())) : "") +
+			(resolution.isEnabled() ? " target: " + ofToString(resolution.getTargetFps(), 0) + " fps" +
+			                          " frame: " + ofToString(resolution.getFrameMs(), 1) + " ms" : "") +
+			(changes.getMode() != ChangeDetector::MODE_OFF ?
+				" reused: " + ofToString(changes.getStats().skipped) +
+				" regions: " + ofToString(changes.getStats().regions) +
+				" pixels: " + ofToString(changes.getStats().pixels * 100, 0) + "%" : "") +
+			(dancer.isEnabled() ?
+				" dancer: " + ofToString(dancer.getBox().width) + "x" + ofToString(dancer.getBox().height) +
+				" pixels: " + ofToString(dancer.getStats().pixels * 100, 0) + "%" : ""),
+			10, 340, ofColor::black, ofColor::green);
+		if(pipeline.isRunning()) {
+			StylePipeline::Stats pipe = pipeline.getStats();
+			ofDrawBitmapStringHighlight("Pipeline depth: " + ofToString(pipe.depth) +
+				" workers: " + ofToString(pipe.workers) +
+				" pre: " + ofToString(pipe.preprocess, 1) +
+				" infer: " + ofToString(pipe.inference, 1) +
+				(pipe.regions > 0 ? " region: " + ofToString(pipe.regionInference, 1) : std::string()) +
+				" post: " + ofToString(pipe.postprocess, 1) +
+				" latency: " + ofToString(pipe.latency, 1) + " ms", 10, 320, ofColor::black, ofColor::green);
+		}
+		if(batcher.isRunning()) {
+			StreamBatcher::Stats batch = batcher.getStats();
+			ofDrawBitmapStringHighlight("Batch streams: " + ofToString(batch.streams) +
+				" size: " + ofToString(batch.batchSize, 1) +
+				" partial: " + ofToString(batch.partial) + "/" + ofToString(batch.batches) +
+				" pre: " + ofToString(batch.preprocess, 1) +
+				" infer: " + ofToString(batch.inference, 1) +
+				" post: " + ofToString(batch.postprocess, 1) +
+				" latency: " + ofToString(batch.latency, 1) + " ms", 10, 320, ofColor::black, ofColor::green);
+		}
+
+		// further streams in a column each to the right
+		for(std::size_t i = 0; i < streams.size(); i++) {
+			InputStream & stream = *streams[i];
+			float x = 680 + i * 170;
+			ofSetColor(255);
+			stream.camera.draw(x, 0, 160, 120);
+			stream.output.draw(x, 130, 160, 120);
+			ofDrawBitmapStringHighlight("Stream " + ofToString(i + 2) + ": " + stream.source->getName(), x, 270,
+				ofColor::black, ofColor::white);
+			ofDrawBitmapStringHighlight(getStyleName(stream.styleIndex), x, 290,
+				ofColor::black, (selectedStream == i + 1 ? ofColor::green : ofColor::gray));
+		}
 	} else {
 		ofSetColor(255, 0, 0);
-		ofDrawBitmapString("Camera not initialized!", ofGetWidth()/2 - 100, ofGetHeight()/2);
+		ofDrawBitmapString("Input source not initialized!", ofGetWidth()/2 - 100, ofGetHeight()/2);
 	}
-	#else
-	// draw the output image (fallback for non-camera mode)
-	imgOut.draw(20, 20, 320, 240);
-	#endif
 	
 	// Instructions
 	ofSetColor(200);
-	ofDrawBitmapString("LEFT/RIGHT arrows: change style, 'f': fullscreen, 'ESC': exit", 10, ofGetHeight() - 20);
+	ofDrawBitmapString("LEFT/RIGHT arrows: change style, '[' / ']': pipeline depth, 'p': latency, 'b': tap tempo, 'm': next model, 'f': fullscreen, 'ESC': exit" +
+		std::string(batched() ? ", '1'-'" + ofToString(streams.size() + 1) + "': select stream" : ""), 10, ofGetHeight() - 20);
+
+	// the newest output is on screen now
+	if(!outputPresented) {
+		outputTimes.present = ofGetElapsedTimeMicros();
+		profiler.add(outputTimes);
+		outputPresented = true;
+		if(!firstFramePresented) {
+			ofLogNotice() << "First stylized frame after " << ofToString(startup.getElapsed(), 0) << " ms";
+			firstFramePresented = true;
+		}
+	}
+	if(showProfile && sourceInitialized) {
+		ofDrawBitmapStringHighlight(profiler.getSummary(), 10, 370, ofColor::black, ofColor::yellow);
+	}
+	if(showPreview) {
+		drawPreview();
+	}
+}
+
+//--------------------------------------------------------------
+void ofApp::drawPreview() {
+	ofSetColor(0, 220);
+	ofDrawRectangle(0, 0, ofGetWidth(), ofGetHeight());
+	if(!previewTexture.isAllocated()) {
+		return;
+	}
+
+	// fit the sheet above the status lines
+	previewRect.set(0, 0, previewTexture.getWidth(), previewTexture.getHeight());
+	previewRect.scaleTo(ofRectangle(10, 30, ofGetWidth() - 20, ofGetHeight() - 110));
+	float scale = previewRect.width / previewTexture.getWidth();
+	ofSetColor(255);
+	previewTexture.draw(previewRect);
+	for(std::size_t i = 0; i < previewStyles.size(); i++) {
+		ofRectangle cell = preview.getCell(i);
+		cell.x = previewRect.x + cell.x * scale;
+		cell.y = previewRect.y + cell.y * scale;
+		cell.width *= scale;
+		cell.height *= scale;
+		bool current = (previewStyles[i] == getStyleIndex());
+		ofDrawBitmapStringHighlight(ofFilePath::getBaseName(stylePaths[previewStyles[i]]),
+			cell.x + 4, cell.y + cell.height - 6, ofColor::black, (current ? ofColor::green : ofColor::white));
+		if(current) {
+			ofNoFill();
+			ofSetColor(ofColor::green);
+			ofDrawRectangle(cell);
+			ofFill();
+			ofSetColor(255);
+		}
+	}
+
+	// throughput by batch size, change the batch with '-' / '+'
+	StylePreview::Stats stats = preview.getStats();
+	std::string throughput;
+	for(auto & rate : preview.getThroughput()) {
+		throughput += "  " + ofToString(rate.first) + ": " + ofToString(rate.second, 0) + "/s";
+	}
+	ofDrawBitmapStringHighlight("Style preview " + ofToString(preview.getDone()) + "/" +
+		ofToString(preview.getCount()) +
+		(preview.getFailed() > 0 ? " (" + ofToString(preview.getFailed()) + " failed)" : "") +
+		", batch " + ofToString(preview.getBatchSize()) +
+		(stats.sheetMs > 0 ? ", last sheet " + ofToString(stats.sheetMs, 0) + " ms" : "") +
+		", click to select, 'v' closes, '-' / '+' batch size", 10, 20, ofColor::black, ofColor::yellow);
+	ofDrawBitmapStringHighlight("thumbnails/s by batch size:" + (throughput.empty() ? " -" : throughput),
+		10, ofGetHeight() - 60, ofColor::black, ofColor::yellow);
+}
+
+//--------------------------------------------------------------
+void ofApp::drawStartup() {
+	// one line per startup task and an overall progress bar
+	float x = 40, y = 60;
+	ofSetColor(255);
+	ofDrawBitmapString("Starting AI Dance Mirror... " + ofToString(startup.getElapsed() / 1000.0, 1) + " s", x, y);
+	float width = ofGetWidth() - 2 * x;
+	ofNoFill();
+	ofDrawRectangle(x, y + 15, width, 12);
+	ofFill();
+	ofDrawRectangle(x, y + 15, width * startup.getProgress(), 12);
+	y += 60;
+	for(auto & status : startup.getStatus()) {
+		switch(status.state) {
+			case StartupTasks::DONE: ofSetColor(ofColor::green); break;
+			case StartupTasks::RUNNING: ofSetColor(ofColor::yellow); break;
+			case StartupTasks::FAILED: case StartupTasks::SKIPPED: ofSetColor(ofColor::red); break;
+			default: ofSetColor(150); break;
+		}
+		std::string time = (status.state == StartupTasks::WAITING ? "" :
+		                    ofToString(status.durationMs / 1000.0, 1) + " s");
+		ofDrawBitmapString(status.name + " " + StartupTasks::getName(status.state) + " " + time, x, y);
+		y += 20;
+	}
 }
 
 //--------------------------------------------------------------
 void ofApp::keyPressed(int key) {
+	if(!ready) {
+		return;
+	}
 	switch(key) {
 		case OF_KEY_LEFT:
 			prevStyle();
@@ -163,10 +569,54 @@ void ofApp::keyPressed(int key) {
 		case 'F':
 			ofToggleFullscreen();
 			break;
+		case 'p':
+			showProfile = !showProfile;
+			break;
+		case 'v':
+		case 'V':
+			togglePreview();
+			break;
+		case '-':
+		case '+':
+		case '=':
+			// preview throughput per batch size
+			if(showPreview) {
+				preview.setBatchSize(preview.getBatchSize() + (key == '-' ? -1 : 1));
+				requestPreview();
+			}
+			break;
+		case 'P':
+			profiler.reset();
+			break;
+		case '[':
+		case ']':
+			// latency vs. throughput
+			if(pipeline.isRunning()) {
+				pipeline.setDepth(pipeline.getDepth() + (key == ']' ? 1 : -1));
+				ofLog() << "Pipeline depth: " << pipeline.getDepth();
+			}
+			break;
+		case '1': case '2': case '3': case '4':
+		case '5': case '6': case '7': case '8':
+			// stream the arrow keys change the style of
+			if(batched() && (std::size_t)(key - '1') <= streams.size()) {
+				selectedStream = key - '1';
+				ofLog() << "Selected stream " << selectedStream + 1;
+			}
+			break;
+		case 'b':
+		case 'B':
+			tapTempo();
+			break;
+		case 'm':
+		case 'M':
+			loadNextModel();
+			break;
 		case 'r':
 		case 'R':
 			// reprocess current camera frame with current style
 			ofLog() << "Reprocessing current frame...";
+			reprocessImage();
 			break;
 		default: break;
 	}
@@ -189,7 +639,17 @@ void ofApp::mouseDragged(int x, int y, int button) {
 
 //--------------------------------------------------------------
 void ofApp::mousePressed(int x, int y, int button) {
-
+	if(!showPreview || !previewTexture.isAllocated() || !previewRect.inside(x, y)) {
+		return;
+	}
+	// pick a style from the preview sheet
+	float scale = previewTexture.getWidth() / previewRect.width;
+	int index = preview.getIndex((x - previewRect.x) * scale, (y - previewRect.y) * scale);
+	if(index >= 0 && (std::size_t)index < previewStyles.size()) {
+		getStyleIndex() = previewStyles[index];
+		setStyle(stylePaths[getStyleIndex()]);
+		reprocessImage();
+	}
 }
 
 //--------------------------------------------------------------
@@ -224,72 +684,367 @@ void ofApp::gotMessage(ofMessage msg) {
 
 //--------------------------------------------------------------
 void ofApp::prevStyle() {
-	if(styleIndex == 0) {
-		styleIndex = stylePaths.size()-1;
+	std::size_t & index = getStyleIndex();
+	if(stylePaths.empty()) {
+		return;
+	}
+	if(index == 0) {
+		index = stylePaths.size()-1;
 	}
 	else {
-		styleIndex--;
+		index--;
 	}
-	setStyle(stylePaths[styleIndex]);
+	setStyle(stylePaths[index]);
 	reprocessImage();
 }
 
 //--------------------------------------------------------------
 void ofApp::nextStyle() {
-	styleIndex++;
-	if(styleIndex >= stylePaths.size()) {
-		styleIndex = 0;
+	std::size_t & index = getStyleIndex();
+	if(stylePaths.empty()) {
+		return;
 	}
-	setStyle(stylePaths[styleIndex]);
+	index++;
+	if(index >= stylePaths.size()) {
+		index = 0;
+	}
+	setStyle(stylePaths[index]);
 	reprocessImage();
 }
 
+//--------------------------------------------------------------
+std::size_t & ofApp::getStyleIndex() {
+	return getStyleIndex(selectedStream);
+}
+
+//--------------------------------------------------------------
+std::size_t & ofApp::getStyleIndex(std::size_t stream) {
+	return (stream == 0 ? styleIndex : streams[stream - 1]->styleIndex);
+}
+
+//--------------------------------------------------------------
+std::string ofApp::getStyleName(std::size_t index) const {
+	return (index < stylePaths.size() ? ofFilePath::getFileName(stylePaths[index]) : "none");
+}
+
+//--------------------------------------------------------------
+void ofApp::updateStyleLibrary() {
+	uint64_t version = styleLibrary.getVersion();
+	if(version == styleVersion) {
+		return;
+	}
+	std::shared_ptr<const StyleLibrary::Entries> entries = styleLibrary.getEntries();
+	std::vector<std::string> paths;
+	for(auto & entry : *entries) {
+		paths.push_back(entry.path);
+	}
+	std::vector<std::string> previous;
+	previous.swap(stylePaths);
+	stylePaths = paths;
+	for(std::size_t i = 0; i <= streams.size() && !stylePaths.empty(); i++) {
+		std::size_t & index = getStyleIndex(i);
+		std::string path = (index < previous.size() ? previous[index] : "");
+		auto found = std::find(stylePaths.begin(), stylePaths.end(), path);
+		if(found == stylePaths.end()) {
+			// deleted: the style now at its place, if there was a style at all
+			index = std::min(index, stylePaths.size() - 1);
+			setStyle(i, stylePaths[index]);
+			continue;
+		}
+		index = found - stylePaths.begin();
+		if((*entries)[index].version > styleVersion && styleVersion > 0) {
+			setStyle(i, stylePaths[index]); // image changed, morph to the new version
+		}
+	}
+	styleVersion = version;
+	if(showPreview) {
+		requestPreview();
+	}
+}
+
+//--------------------------------------------------------------
+void ofApp::loadNextModel() {
+	if(settings.models.size() < 2) {
+		ofLogNotice() << "No other model, add variants with --model";
+		return;
+	}
+	std::size_t next = (modelIndex + 1) % settings.models.size();
+	if(modelSwap.isReady() && modelSwap.getPath() == settings.getModelPath(next)) {
+		return; // switches on the next update()
+	}
+	// warm up with what the live path runs next: this frame, this style,
+	// all streams in one batch
+	PixelSpan frame = (hasFrame ? grabber.getFrame().getSpan() : PixelSpan());
+	ofxStyleTransfer::Style style;
+	if(!stylePaths.empty()) {
+		styleLibrary.find(stylePaths[styleIndex], style);
+	}
+	if(!modelSwap.load(styleTransfer, settings.getModelPath(next), frame, style, (int)streams.size() + 1)) {
+		ofLogNotice() << "Model swap in progress, try again";
+		return;
+	}
+	ofLogNotice() << "Loading model " << settings.getModelPath(next) << " in the background";
+}
+
+//--------------------------------------------------------------
+void ofApp::applyModel() {
+	if(!modelSwap.isReady()) {
+		return;
+	}
+	if(!modelSwap.apply(styleTransfer)) {
+		ofLogError() << "Cannot switch to " << modelSwap.getPath() << ", keeping "
+			<< settings.models[modelIndex];
+		return;
+	}
+	for(std::size_t i = 0; i < settings.models.size(); i++) {
+		if(settings.getModelPath(i) == modelSwap.getCurrent()) {
+			modelIndex = i;
+		}
+	}
+	if(styleTransfer.usesStyleBottleneck()) {
+		// the styles' bottlenecks come from the old style prediction
+		// network, they fit the new one until prepared again
+		std::size_t count = styleLibrary.reprepare(false);
+		ofLogNotice() << "Preparing " << count << " styles for " << modelSwap.getCurrent();
+	}
+	ofLogNotice() << "Switched to model " << modelSwap.getCurrent() << ", loaded in "
+		<< ofToString(modelSwap.getLoadMs(), 0) << " ms";
+}
+
+//--------------------------------------------------------------
+StyleTransition & ofApp::getTransition(std::size_t stream) {
+	return (stream == 0 ? transition : streams[stream - 1]->transition);
+}
+
 //--------------------------------------------------------------
 void ofApp::setStyle(std::string & path) {
-	ofImage styleImg;
-	styleImg.setUseTexture(false); // We don't need texture for processing
-	if(!styleImg.load(path)) {
-		ofLogError() << "Failed to load style image: " << path;
+	setStyle(selectedStream, path);
+}
+
+//--------------------------------------------------------------
+void ofApp::setStyle(std::size_t stream, const std::string & path) {
+	ofxStyleTransfer::Style style;
+	if(!styleLibrary.find(path, style)) {
+		return;
+	}
+	// morphs from the current style, cuts the first time
+	getTransition(stream).start(style, ofGetElapsedTimef());
+	applyStyle(stream);
+	if(batched()) {
+		ofLog() << "Stream " << stream + 1 << " style changed to: " << ofFilePath::getFileName(path);
+	}
+	else {
+		ofLog() << "Style changed to: " << ofFilePath::getFileName(path);
+	}
+}
+
+//--------------------------------------------------------------
+void ofApp::applyStyle(std::size_t stream) {
+	StyleTransition & transition = getTransition(stream);
+	if(!transition.update(styleTransfer, ofGetElapsedTimef())) {
+		return;
+	}
+	if(batcher.isRunning()) {
+		batcher.setStyle(stream, transition.getStyle());
+	}
+	if(stream > 0) {
+		return;
+	}
+	styleTransfer.setStyle(transition.getStyle());
+	changes.invalidate(); // restyle the whole frame
+	dancer.invalidate();
+}
+
+//--------------------------------------------------------------
+void ofApp::cycleStyles() {
+	if(stylePaths.empty()) {
+		return;
+	}
+	for(std::size_t i = 0; i <= streams.size(); i++) {
+		std::size_t & index = getStyleIndex(i);
+		index = (index + 1) % stylePaths.size();
+		setStyle(i, stylePaths[index]);
+	}
+}
+
+//--------------------------------------------------------------
+void ofApp::tapTempo() {
+	float now = ofGetElapsedTimef();
+	if(!taps.empty() && now - taps.back() > 2) {
+		taps.clear(); // a pause starts a new tap sequence
+	}
+	taps.push_back(now);
+	if(taps.size() > 8) {
+		taps.erase(taps.begin());
+	}
+	cycleStart = now; // the cycle follows the taps' beat
+	if(taps.size() < 2) {
+		return;
+	}
+	settings.bpm = ofClamp(60.f * (taps.size() - 1) / (taps.back() - taps.front()), 20.f, 300.f);
+	updateTransitionDuration();
+	ofLog() << "Tempo: " << ofToString(settings.bpm, 1) << " bpm";
+}
+
+//--------------------------------------------------------------
+void ofApp::togglePreview() {
+	showPreview = !showPreview;
+	if(showPreview) {
+		requestPreview();
+	}
+	else {
+		preview.cancel();
+	}
+}
+
+//--------------------------------------------------------------
+void ofApp::requestPreview() {
+	bool streamHasFrame = (selectedStream == 0 ? hasFrame : streams[selectedStream - 1]->hasFrame);
+	if(!streamHasFrame) {
 		return;
 	}
-	// Ensure RGB format
-	if(styleImg.getPixels().getNumChannels() != 3) {
-		styleImg.getPixels().setImageType(OF_IMAGE_COLOR);
+	std::vector<ofxStyleTransfer::Style> styles;
+	previewStyles.clear();
+	for(auto & entry : *styleLibrary.getEntries()) {
+		auto found = std::find(stylePaths.begin(), stylePaths.end(), entry.path);
+		if(found != stylePaths.end()) {
+			styles.push_back(entry.style);
+			previewStyles.push_back(found - stylePaths.begin());
+		}
+	}
+	FrameGrabber & frames = (selectedStream == 0 ? grabber : streams[selectedStream - 1]->grabber);
+	preview.request(frames.getFrame().getSpan(), styles);
+}
+
+//--------------------------------------------------------------
+void ofApp::updateTransitionDuration() {
+	float seconds = settings.styleTransition.getSeconds(settings.bpm);
+	for(std::size_t i = 0; i <= streams.size(); i++) {
+		getTransition(i).setDuration(seconds);
 	}
-	styleTransfer.setStyle(styleImg.getPixels());
-	ofLog() << "Style changed to: " << ofFilePath::getFileName(path) << " (" << styleImg.getPixels().getNumChannels() << " channels)";
 }
 
 //--------------------------------------------------------------
 void ofApp::reprocessImage() {
-	#ifdef USE_REALSENSE_CAMERA
-	// With camera input, we don't need to reload anything
-	// The current frame will be processed with the new style automatically
-	ofLog() << "Style changed, processing will continue with new style on next frame";
-	#else
-	// reload and reprocess the input image with current style (fallback)
-	ofImage inputImage;
-	inputImage.setUseTexture(false); // We don't need texture for processing
-	if(inputImage.load("promyczek.jpg")) {
-		// Ensure RGB format
-		if(inputImage.getPixels().getNumChannels() != 3) {
-			inputImage.getPixels().setImageType(OF_IMAGE_COLOR);
+	// a live source picks up the new style with the next frame anyway,
+	// resend the last frame so paused or finished sources update too
+	if(selectedStream > 0) {
+		InputStream & stream = *streams[selectedStream - 1];
+		if(stream.hasFrame) {
+			submitBatched(selectedStream, stream.grabber.getFrame());
 		}
-		styleTransfer.setInput(inputImage.getPixels());
-		ofLog() << "Reprocessing image with current style...";
+		return;
+	}
+	if(!hasFrame) {
+		return;
+	}
+	changes.invalidate();
+	dancer.invalidate();
+	submitFrame(grabber.getFrame());
+	ofLog() << "Reprocessing last frame with current style...";
+}
+
+//--------------------------------------------------------------
+void ofApp::submitFrame(const Frame & frame) {
+	// static frames keep the last output
+	ChangeDetector::Decision decision = changes.analyze(frame.getSpan());
+	if(decision.skip) {
+		skippedSinceOutput = true;
+		return;
+	}
+	if(batcher.isRunning()) {
+		submitBatched(0, frame);
+	}
+	else if(pipeline.isRunning()) {
+		// the grabber reuses the frame, hold on to its pixels
+		PixelSpan pixels;
+		std::shared_ptr<void> owner = frame.retain(pixels);
+		PixelRect region = decision.region;
+		if(dancer.isEnabled()) {
+			// the dancer plus any changed tiles, changes elsewhere are picked
+			// up by the next background refresh; a full frame requested by
+			// the tile detector stays full, its reference is the whole frame
+			PixelRect box = dancer.update(frame.depth, pixels.width, pixels.height);
+			bool full = (changes.getMode() == ChangeDetector::MODE_TILES && decision.region.isEmpty());
+			if(!full) {
+				region = (box.isEmpty() ? box : box.united(decision.region));
+			}
+		}
+		uint64_t dropped = pipeline.getStats().dropped;
+		pipeline.submit(pixels, owner, frame.index, frame.captureTime, region);
+		if(changes.getMode() != ChangeDetector::MODE_OFF && pipeline.getStats().dropped != dropped) {
+			// the replaced frame's changes were never stylized
+			changes.invalidate();
+		}
+	}
+	else {
+		styleTransfer.setInput(frame.getSpan());
+	}
+}
+
+//--------------------------------------------------------------
+void ofApp::submitBatched(std::size_t stream, const Frame & frame) {
+	// the grabber reuses the frame, hold on to its pixels
+	PixelSpan pixels;
+	std::shared_ptr<void> owner = frame.retain(pixels);
+	batcher.submit((int)stream, pixels, owner, frame.index, frame.captureTime);
+}
+
+//--------------------------------------------------------------
+void ofApp::adaptResolution() {
+	uint64_t now = ofGetElapsedTimeMicros();
+	double frameMs = (lastOutputTime > 0 && !skippedSinceOutput ? (now - lastOutputTime) / 1000.0 : 0);
+	lastOutputTime = now;
+	skippedSinceOutput = false; // reused frames stretch the output interval
+	if(!resolution.isEnabled()) {
+		return;
+	}
+	if(pipeline.isRunning()) {
+		// pipelined throughput is set by the slowest stage, the output
+		// interval also includes waiting for camera frames
+		StylePipeline::Stats stats = pipeline.getStats();
+		frameMs = std::max({stats.preprocess, stats.inference / stats.workers, stats.postprocess});
+	}
+	if(resolution.update(frameMs)) {
+		styleTransfer.setSize(resolution.getWidth(), resolution.getHeight());
+		changes.invalidate();
+		dancer.invalidate();
+		ofLogNotice() << "Model size " << resolution.getWidth() << "x" << resolution.getHeight()
+			<< " for " << resolution.getTargetFps() << " fps";
 	}
-	#endif
 }
 
 //--------------------------------------------------------------
 void ofApp::exit() {
-	#ifdef USE_REALSENSE_CAMERA
-	if (cameraInitialized) {
-		pipe.stop();
-		ofLogNotice() << "RealSense camera stopped";
+	startup.wait();
+	if (sourceInitialized) {
+		grabber.stop();
+		source->close();
+		for(auto & stream : streams) {
+			stream->grabber.stop();
+			stream->source->close();
+		}
+		ofLogNotice() << "Input source stopped";
 	}
-	#endif
 	
-	// Stop style transfer thread
+	// Stop style transfer threads
+	styleLibrary.stop();
+	preview.stop();
+	batcher.stop();
+	pipeline.stop();
 	styleTransfer.stopThread();
+
+	// release upload buffers while the GL context is still there, all
+	// writers have stopped
+	cameraStream.clear();
+	outputStream.clear();
+	for(auto & stream : streams) {
+		stream->camera.clear();
+		stream->output.clear();
+	}
+
+	ofLogNotice() << "Latency\n" << profiler.getSummary();
+	if(!settings.traceFile.empty()) {
+		profiler.writeTrace(settings.traceFile);
+	}
 }
\ No newline at end of file
@@ -8,10 +8,33 @@
 #include "ofMain.h"
 #include "ofxTensorFlow2.h"
 #include "ofxStyleTransfer.h"
-#include <librealsense2/rs.hpp>
+#include "StylePipeline.h"
+#include "StyleLibrary.h"
+#include "FrameGrabber.h"
+#include "FrameSources.h"
+#include "AppSettings.h"
+#include "ResolutionController.h"
+#include "FrameProfiler.h"
+#include "StartupTasks.h"
+#include "ChangeDetector.h"
+#include "DancerRegion.h"
+#include "StreamBatcher.h"
+#include "TextureStream.h"
+#include "StyleTransition.h"
+#include "StylePreview.h"
+#include "ModelSwap.h"
 
-// use RealSense camera for live input
-#define USE_REALSENSE_CAMERA
+/// \struct InputStream
+/// \brief an input source after the first, batched with it by StreamBatcher
+struct InputStream {
+	std::shared_ptr<FrameSource> source;
+	FrameGrabber grabber; ///< captures off the render thread
+	TextureStream camera; ///< camera preview
+	TextureStream output; ///< stylized output
+	std::size_t styleIndex = 0; ///< current style path index
+	StyleTransition transition; ///< style morph
+	bool hasFrame = false; ///< has at least one frame been received?
+};
 
 class ofApp : public ofBaseApp {
 
@@ -39,36 +62,134 @@ class ofApp : public ofBaseApp {
 		/// goto next style in the stylePaths vector
 		void nextStyle();
 
-		/// set style from given input image
+		/// set style from given input image in the style library
 		void setStyle(std::string & path);
+
+		/// morph the style of a stream to the given input image
+		void setStyle(std::size_t stream, const std::string & path);
+
+		/// apply a stream's style if its transition changed it
+		void applyStyle(std::size_t stream);
+
+		/// next style on every stream, see AppSettings::styleCycle
+		void cycleStyles();
+
+		/// set the tempo from the intervals of repeated taps and start the
+		/// style cycle on the beat
+		void tapTempo();
+
+		/// transition length at the current tempo
+		void updateTransitionDuration();
+
+		/// show or hide the style preview sheet
+		void togglePreview();
+
+		/// start a preview sheet of the selected stream's current frame
+		void requestPreview();
+
+		/// style preview sheet over the window
+		void drawPreview();
+
+		/// load the next model of AppSettings::models in the background,
+		/// warmed up with the current frame & style
+		void loadNextModel();
+
+		/// switch to a loaded model between two frames
+		void applyModel();
 		
-		/// reprocess the input image with current style
+		/// GL setup & thread start on the main thread once all startup tasks
+		/// have finished, exits if one failed
+		void finishSetup();
+
+		/// startup progress screen
+		void drawStartup();
+
+		/// reprocess the last input frame with current style
 		void reprocessImage();
 
+		/// send a frame to the style pipeline or model thread
+		void submitFrame(const Frame & frame);
+
+		/// send a frame of a stream to the batcher
+		void submitBatched(std::size_t stream, const Frame & frame);
+
+		/// style path index of the selected stream
+		std::size_t & getStyleIndex();
+
+		/// style path index of a stream
+		std::size_t & getStyleIndex(std::size_t stream);
+
+		/// file name of a style path index, "none" if the library is empty
+		std::string getStyleName(std::size_t index) const;
+
+		/// pick up style library changes: keep each stream's style by path,
+		/// move on if it was deleted, morph to it if it changed
+		void updateStyleLibrary();
+
+		/// style morph of a stream
+		StyleTransition & getTransition(std::size_t stream);
+
+		/// feed the time per output frame to the resolution controller and
+		/// apply size changes
+		void adaptResolution();
+
+		/// upload a new output and record its frame times, pixels may be
+		/// empty if the output was written into outputStream already
+		void presentOutput(const FrameTimes & times, const ofPixels & pixels);
+
+		/// are several sources batched?
+		bool batched() const {return !streams.empty();}
+
+		AppSettings settings; ///< command line options, set before setup()
+
+		StartupTasks startup; ///< concurrent model load, camera open, ...
+		bool ready = false; ///< has startup finished?
+		bool firstFramePresented = false; ///< logs time to the first output
+
 		ofxStyleTransfer styleTransfer; ///< model wrapper
-		ofFloatImage imgOut; ///< output image
-
-		// RealSense camera
-		#ifdef USE_REALSENSE_CAMERA
-			rs2::pipeline pipe;
-			rs2::config cfg;
-			ofTexture colorTex;
-			ofImage colorImage;
-			int cameraWidth = 640;
-			int cameraHeight = 480;
-			int fps = 30;
-			bool cameraInitialized = false;
-		#endif
-
-		// image input & output size
-		const static int imageWidth = 640;  // Match camera resolution
-		const static int imageHeight = 480; // Match camera resolution
-
-		// paths to available style images
-		std::vector<std::string> stylePaths = {
-			"style/milton.png",
-			"style/picasso.jpeg",
-			"style/mama.jpg"
-		};
-		std::size_t styleIndex = 0; ///< current model path index
+		StylePipeline pipeline; ///< staged inference, used if depth > 0
+		ResolutionController resolution; ///< adaptive model input size
+		uint64_t lastOutputTime = 0; ///< previous output time in us
+		ChangeDetector changes; ///< skips static frames, finds changed regions
+		bool skippedSinceOutput = false; ///< was a frame reused since the last output?
+		uint64_t pipelineFailed = 0; ///< pipeline inference failures seen so far
+		DancerRegion dancer; ///< depth based performer region
+		StreamBatcher batcher; ///< batched inference, used with several sources
+		std::size_t selectedStream = 0; ///< stream whose style is changed
+
+		// latency instrumentation
+		FrameProfiler profiler; ///< stage histograms & trace
+		FrameTimes outputTimes; ///< timestamps of the newest output frame
+		bool outputPresented = true; ///< has the newest output been drawn?
+		bool showProfile = false; ///< draw the latency overlay?
+		StyleLibrary styleLibrary; ///< prepared styles of the style folder
+		uint64_t styleVersion = 0; ///< style library version of stylePaths
+		StyleTransition transition; ///< style morph of the first stream
+		float cycleStart = 0; ///< current style cycle period start in s
+		std::vector<float> taps; ///< recent tap tempo times in s
+
+		// style preview
+		StylePreview preview; ///< every style on the current frame
+		bool showPreview = false; ///< draw the preview sheet?
+		ofPixels previewPixels; ///< latest sheet
+		ofTexture previewTexture;
+		ofRectangle previewRect; ///< sheet on screen, for picking
+		std::vector<std::size_t> previewStyles; ///< style path index per cell
+		TextureStream outputStream; ///< output texture, 8 bit end to end
+
+		// model variants
+		ModelSwap modelSwap; ///< background load of the next model
+		std::size_t modelIndex = 0; ///< current model in AppSettings::models
+
+		// input frames
+		std::shared_ptr<FrameSource> source; ///< camera, recording, or generator
+		FrameGrabber grabber; ///< captures off the render thread
+		TextureStream cameraStream; ///< camera preview texture
+		bool sourceInitialized = false;
+		bool hasFrame = false; ///< has at least one frame been received?
+		std::vector<std::unique_ptr<InputStream>> streams; ///< further sources, stream 1 onwards
+
+		// paths to available style images, sorted by name
+		std::vector<std::string> stylePaths;
+		std::size_t styleIndex = 0; ///< current style path index
 };
\ No newline at end of file
@@ -10,6 +10,15 @@
 
 #include "ofxTensorFlow2.h"
 #include "ofFileUtils.h"
+#include "PixelSpan.h"
+#include "Preprocess.h"
+#include "PixelKernels.h"
+#include "TensorBufferPool.h"
+#include "InferenceDevice.h"
+#include "ModelSignature.h"
+#include "TiledInference.h"
+#include <atomic>
+#include <mutex>
 
 /// \class ofxStyleTransfer
 /// \brief wrapper for the arbitrary style transfer model
@@ -23,6 +32,11 @@
 /// note: input style images are required to 256x256, style images are resized
 ///       as needed, style images must be RGB
 ///
+/// note: if the model folder contains "style_predict" and "style_transform"
+///       SavedModel subfolders, the style bottleneck is computed once per
+///       style by prepareStyle() and each inference only runs the transform
+///       network, otherwise the style image itself is passed to the model
+///
 /// basic usage example:
 ///
 /// class ofApp : public ofBaseApp {
@@ -55,31 +69,104 @@ class ofxStyleTransfer {
 		static const int STYLE_W = 256; ///< style image width expected by the model
 		static const int STYLE_H = 256; ///< style image height expected by the model
 
+		/// prepared style, see prepareStyle()
+		struct Style {
+			cppflow::tensor image; ///< 1x256x256x3 float style image
+			cppflow::tensor bottleneck; ///< style bottleneck, split models only
+			bool hasBottleneck = false; ///< is bottleneck set?
+		};
+
+		/// a loaded model, see loadNetwork()
+		struct Network {
+			ofxTF2::ThreadedModel model; ///< full model or style transform network
+			ofxTF2::Model predictor; ///< style prediction network, split models only
+			std::unique_ptr<ModelSession> session; ///< runs instead of model if set, see loadNetwork()
+			bool split = false; ///< separate style prediction & transform?
+			std::string modelPath; ///< model folder
+			std::string transferPath; ///< full model or style transform network path
+			std::vector<std::string> inputNames; ///< model input names in use
+			std::string outputName; ///< model output name in use
+			std::vector<int64_t> styleShape; ///< style model input shape, set by warm-up
+		};
+
 		/// load and set up style transfer model with input/output image size
 		/// returns true on success
 		bool setup(int width, int height, const std::string & modelPath="model") {
 
-			// CRITICAL: GPU Memory Setup - Exit if fails
-			ofLogNotice("ofxStyleTransfer") << "Setting up GPU memory allocation...";
-			if(!ofxTF2::setGPUMaxMemory(ofxTF2::GPU_PERCENT_90, true)) {
-				ofLogError("ofxStyleTransfer") << "❌ CRITICAL: Failed to set GPU Memory options!";
-				ofLogError("ofxStyleTransfer") << "❌ CRITICAL: GPU acceleration required but not available!";
-				ofLogError("ofxStyleTransfer") << "❌ CRITICAL: Exiting application...";
-				std::exit(EXIT_FAILURE);
+			// GPU if available, otherwise CPU, keeps the app's selection if
+			// already configured
+			InferenceDevice::configure();
+
+			std::shared_ptr<Network> loaded = loadNetwork(modelPath);
+			if(!loaded) {
+				return false;
 			}
-			ofLogNotice("ofxStyleTransfer") << "✓ GPU memory configured for 90% usage";
+
+			// input
+			inputVector = {cppflow::tensor(0), cppflow::tensor(0)};
+			setSize(width, height);
+			warmUp(*loaded);
+			{
+				std::lock_guard<std::mutex> lock(networkMutex);
+				network = loaded;
+				generation++;
+			}
+
+			// output
+			outputImage.allocate(getOutputWidth(), getOutputHeight(), OF_IMAGE_COLOR);
 			
-			ofLogNotice("ofxStyleTransfer") << "Loading model from: " << modelPath;
-			if(!model.load(modelPath)) {
-				ofLogError("ofxStyleTransfer") << "Failed to load model from: " << modelPath;
-				return false;
+			ofLogNotice("ofxStyleTransfer") << "✓ Style transfer setup completed on "
+			                                << InferenceDevice::getDescription();
+			return true;
+		}
+
+		/// load and bind a model without touching the model in use, ie. on a
+		/// background thread to swap it in with swapNetwork() later
+		/// returns nullptr on failure
+		///
+		/// fp16 needs the mixed precision rewrite in the session options, which
+		/// ofxTF2::Model can not take: the style transfer network then runs in
+		/// a ModelSession with InferenceDevice::getSessionOptions() instead
+		std::shared_ptr<Network> loadNetwork(const std::string & modelPath,
+		                                     ModelSession::Precision precision=InferenceDevice::getPrecision()) const {
+			std::shared_ptr<Network> network = std::make_shared<Network>();
+			network->modelPath = modelPath;
+
+			// a model folder with separate style prediction and style transform
+			// networks allows computing the style bottleneck once per style
+			std::string predictPath = ofFilePath::join(modelPath, "style_predict");
+			std::string transformPath = ofFilePath::join(modelPath, "style_transform");
+			network->split = ofDirectory::doesDirectoryExist(predictPath) &&
+			             ofDirectory::doesDirectoryExist(transformPath);
+			if(network->split) {
+				ofLogNotice("ofxStyleTransfer") << "Loading style prediction model from: " << predictPath;
+				if(!network->predictor.load(predictPath)) {
+					ofLogError("ofxStyleTransfer") << "Failed to load model from: " << predictPath;
+					return nullptr;
+				}
+				std::vector<std::vector<std::string>> predictorInputNameVariants = {
+					{"serving_default_style_image"},
+					{"serving_default_input_1"},
+					{"serving_default_placeholder"},
+					{"style_image"},
+					{"style"}
+				};
+				std::vector<std::string> predictorInputNames;
+				std::string predictorOutputName;
+				if(!bindModel(network->predictor, predictPath, predictorInputNameVariants, bottleneckOutputNameVariants(),
+				              predictorInputNames, predictorOutputName)) {
+					return nullptr;
+				}
+			}
+
+			network->transferPath = (network->split ? transformPath : modelPath);
+			ofLogNotice("ofxStyleTransfer") << "Loading model from: " << network->transferPath;
+			if(!network->model.load(network->transferPath)) {
+				ofLogError("ofxStyleTransfer") << "Failed to load model from: " << network->transferPath;
+				return nullptr;
 			}
 			ofLogNotice("ofxStyleTransfer") << "Model loaded successfully";
 			
-			// Monitor for GPU device creation messages in TensorFlow logs
-			ofLogNotice("ofxStyleTransfer") << "Monitoring TensorFlow for GPU device creation...";
-			ofLogNotice("ofxStyleTransfer") << "If you see 'Skipping registering GPU devices' messages, GPU is not working!";
-			
 			// Try different input name combinations that are commonly used
 			// for style transfer models
 			std::vector<std::vector<std::string>> inputNameVariants = {
@@ -97,6 +184,16 @@ class ofxStyleTransfer {
 				{"content_image", "style_image"},
 				{"content", "style"}
 			};
+			if(network->split) {
+				// style transform network: content image, style bottleneck
+				inputNameVariants = {
+					{"serving_default_content_image", "serving_default_style_bottleneck"},
+					{"serving_default_input_1", "serving_default_input_2"},
+					{"serving_default_placeholder", "serving_default_placeholder_1"},
+					{"content_image", "style_bottleneck"},
+					{"content", "bottleneck"}
+				};
+			}
 			
 			std::vector<std::string> outputNameVariants = {
 				"StatefulPartitionedCall",  // Actual output tensor name from saved_model_cli
@@ -106,81 +203,337 @@ class ofxStyleTransfer {
 				"stylized_image"
 			};
 			
-			bool setupSuccess = false;
-			std::string lastError = "";
-			
-			// Try each combination
-			for (const auto& inputNames : inputNameVariants) {
-				for (const auto& outputName : outputNameVariants) {
-					try {
-						ofLogNotice("ofxStyleTransfer") << "Trying input names: " 
-							<< inputNames[0] << ", " << inputNames[1] 
-							<< " | output: " << outputName;
-						
-						model.setup(inputNames, {outputName});
-						setupSuccess = true;
-						
-						ofLogNotice("ofxStyleTransfer") << "✓ Successfully configured with inputs: " 
-							<< inputNames[0] << ", " << inputNames[1] 
-							<< " | output: " << outputName;
-						break;
-					} catch (const std::exception& e) {
-						lastError = e.what();
-						ofLogWarning("ofxStyleTransfer") << "✗ Failed with inputs: " 
-							<< inputNames[0] << ", " << inputNames[1] 
-							<< " | error: " << lastError;
-					}
+			if(!bindModel(network->model, network->transferPath, inputNameVariants, outputNameVariants,
+			              network->inputNames, network->outputName)) {
+				return nullptr;
+			}
+
+			if(precision == ModelSession::PRECISION_FP16) {
+				std::unique_ptr<ModelSession> session(new ModelSession);
+				if(session->load(network->transferPath, network->inputNames, network->outputName,
+				                 InferenceDevice::getSessionOptions(precision))) {
+					network->session = std::move(session);
+					network->model.clear(); // bound names are all that is needed
+					ofLogNotice("ofxStyleTransfer") << "Running model with mixed precision";
+				}
+				else {
+					ofLogWarning("ofxStyleTransfer") << "Failed to load mixed precision session, using fp32";
 				}
-				if (setupSuccess) break;
 			}
-			
-			if (!setupSuccess) {
-				ofLogError("ofxStyleTransfer") << "Failed to setup model with any input/output combination. Last error: " << lastError;
+
+			return network;
+		}
+
+		/// run one inference at the current model size with the given content
+		/// & style image on a loaded network, so graph initialization & kernel
+		/// selection do not delay its first live frame; empty tensors use a
+		/// blank content or style image, returns false if the run failed
+		bool warmUp(Network & network, cppflow::tensor content=cppflow::tensor(0),
+		            cppflow::tensor styleImage=cppflow::tensor(0)) {
+			uint64_t start = ofGetElapsedTimeMicros();
+			try {
+				if(content.shape().size() != 4) {
+					std::vector<float> values(modelSize.width * modelSize.height * 3, 0.5f);
+					content = cppflow::tensor(values, {1, modelSize.height, modelSize.width, 3});
+				}
+				if(styleImage.shape().size() != 4) {
+					std::vector<float> image(STYLE_W * STYLE_H * 3, 0.5f);
+					styleImage = cppflow::tensor(image, {1, STYLE_H, STYLE_W, 3});
+				}
+				cppflow::tensor style = styleImage;
+				if(network.split) {
+					style = network.predictor.runModel(style);
+				}
+				network.styleShape = style.shape();
+				run(network, content, style);
+			}
+			catch(const std::exception & e) {
+				ofLogWarning("ofxStyleTransfer") << "Warm-up inference failed: " << e.what();
 				return false;
 			}
+			ofLogNotice("ofxStyleTransfer") << "Warm-up inference: "
+				<< ofToString((ofGetElapsedTimeMicros() - start) / 1000.0, 1) << " ms";
+			return true;
+		}
 
-			// input
-			inputVector = {cppflow::tensor(0), cppflow::tensor(0)};
-			setSize(width, height);
-
-			// output
-			outputImage.allocate(size.width, size.height, OF_IMAGE_COLOR);
-			
-			ofLogNotice("ofxStyleTransfer") << "✓ Style transfer setup completed with GPU acceleration";
+		/// switch to a network loaded by loadNetwork() & warmed up, runs
+		/// started from now on use it while runs in flight finish on the old
+		/// one; previous is set to the old network so the caller decides
+		/// where its session is released
+		///
+		/// the style input must match: a split model can only replace a split
+		/// model with the same bottleneck size, a full model a full model;
+		/// returns false if it does not
+		///
+		/// call from the thread calling update(), if the background thread
+		/// is running it is restarted on the new network, which waits for its
+		/// current inference
+		bool swapNetwork(std::shared_ptr<Network> next, std::shared_ptr<Network> & previous) {
+			std::shared_ptr<Network> current = getNetwork();
+			if(!next || !current) {
+				return false;
+			}
+			if(next->split != current->split ||
+			   (!next->styleShape.empty() && next->styleShape != current->styleShape)) {
+				ofLogError("ofxStyleTransfer") << "Cannot swap to " << next->modelPath
+					<< ", its style input does not match " << current->modelPath;
+				return false;
+			}
+			bool threaded = current->model.isThreadRunning();
+			if(threaded) {
+				current->model.stopThread(); // its output in flight is dropped
+			}
+			{
+				std::lock_guard<std::mutex> lock(networkMutex);
+				network = next;
+				generation++;
+			}
+			if(threaded && !next->session) {
+				sizeChanged = false;
+				next->model.startThread();
+			}
+			previous = current;
+			ofLogNotice("ofxStyleTransfer") << "Switched to model " << next->modelPath;
 			return true;
 		}
 
+		/// model in use, nullptr before setup(), thread-safe
+		std::shared_ptr<Network> getNetwork() const {
+			std::lock_guard<std::mutex> lock(networkMutex);
+			return network;
+		}
+
+		/// incremented each time the model in use changes, thread-safe
+		uint64_t getGeneration() const {return generation;}
+
+		/// enable or disable the output image texture, disable before setup()
+		/// when running without a GL context, ie. headless tools
+		void setUseTexture(bool useTexture) {
+			outputImage.setUseTexture(useTexture);
+		}
+
+		/// run model inputs larger than a tile as overlapping batched tiles
+		/// with feathered seams, bounds model memory by the tile & batch size
+		/// instead of the output size, tileSize 0 disables; call before setup()
+		/// so the warm-up uses the tile shape
+		///
+		/// applies to run() & blocking update(), the background thread started
+		/// by startThread() always runs whole frames
+		void setTiling(const TiledInference::Options & options) {
+			tiling.setOptions(options);
+		}
+
+		/// tile settings & helpers, ie. for other sessions running the model
+		TiledInference & getTiling() {return tiling;}
+
 		/// clear model
 		void clear() {
-			model.clear();
+			std::lock_guard<std::mutex> lock(networkMutex);
+			network.reset();
 		}
 
 		/// set input pixels to process, resizes as needed
-		/// image type must be RGB without alpha
+		/// image type must be RGB or RGBA
 		/// note: set the style image before calling this!
 		void setInput(const ofPixels & pixels) {
-			cppflow::tensor image = pixelsToFloatTensor(pixels);
-			if(pixels.getHeight() != modelSize.width || pixels.getWidth() != modelSize.height) {
-				image = cppflow::resize_bicubic(image, cppflow::tensor({size.height, size.width}), true);
+			if(pixels.getNumChannels() != 3 && pixels.getNumChannels() != 4) {
+				ofLogError("ofxStyleTransfer") << "Unsupported pixel format with " << pixels.getNumChannels() << " channels";
+				return;
 			}
-			inputVector[0] = image;
+			setInput(PixelSpan(pixels));
+		}
+
+		/// set input pixels to process from a pixel view, ie. a camera buffer
+		///
+		/// channel conversion, resizing to the model size, and normalization
+		/// are fused into a single pass which writes directly into a reusable
+		/// input tensor buffer, the source is not copied
+		/// note: set the style image before calling this!
+		void setInput(const PixelSpan & pixels) {
+			float * data = nullptr;
+			inputVector[0] = inputBuffers.allocate({1, modelSize.height, modelSize.width, 3}, data);
+			preprocess(pixels, data, modelSize.width, modelSize.height);
 			newInput = true;
 		}
 
 		/// set input style image, resizes as needed
 		/// image type must be RGB without alpha
+		/// note: prefer caching prepareStyle() results when switching styles
 		void setStyle(const ofPixels & pixels) {
-			auto style = pixelsToFloatTensor(pixels);
+			setStyle(prepareStyle(pixels));
+		}
+
+		/// set a style prepared by prepareStyle(), this is cheap: no image
+		/// conversion or style prediction is done
+		void setStyle(const Style & style) {
+			std::lock_guard<std::mutex> lock(styleMutex);
+			inputVector[1] = getStyleTensor(style);
+		}
+
+		/// prepare a style image for setStyle(), resizes as needed
+		/// image type must be RGB without alpha
+		///
+		/// when the model has a separate style prediction network, the style
+		/// bottleneck is computed here once, so later inferences only run the
+		/// style transform network
+		Style prepareStyle(const ofPixels & pixels) {
+			Style style;
+			style.image = pixelsToFloatTensor(pixels);
 			if(pixels.getHeight() != STYLE_W || pixels.getWidth() != STYLE_H) {
-				style = cppflow::resize_bicubic(style, cppflow::tensor({STYLE_H, STYLE_W}), true);
+				style.image = cppflow::resize_bicubic(style.image, cppflow::tensor({STYLE_H, STYLE_W}), true);
+			}
+			std::shared_ptr<Network> current = getNetwork();
+			if(current && current->split) {
+				style.bottleneck = current->predictor.runModel(style.image);
+				style.hasBottleneck = true;
+			}
+			return style;
+		}
+
+		/// weighted mix of prepared styles, ie. for crossfades: the style
+		/// bottlenecks are interpolated if the model has a style prediction
+		/// network, otherwise the style images; weights are normalized,
+		/// returns the first style if the styles do not match
+		///
+		/// one inference with a blended style costs the same as with any
+		/// other style, a bottleneck blend is only a few hundred floats
+		Style blendStyles(const std::vector<const Style *> & styles, const std::vector<float> & weights) const {
+			if(styles.empty() || styles.size() != weights.size()) {
+				return (styles.empty() ? Style() : *styles.front());
+			}
+			float total = 0;
+			for(float weight : weights) {
+				total += std::max(weight, 0.f);
+			}
+			if(styles.size() == 1 || total <= 0) {
+				return *styles.front();
+			}
+			std::vector<std::shared_ptr<TF_Tensor>> inputs;
+			for(auto style : styles) {
+				const cppflow::tensor & tensor = getStyleTensor(*style);
+				std::shared_ptr<TF_Tensor> data = tensor.get_tensor();
+				if(!data || TF_TensorType(data.get()) != TF_FLOAT ||
+				   (!inputs.empty() && TF_TensorByteSize(data.get()) != TF_TensorByteSize(inputs.front().get()))) {
+					ofLogError("ofxStyleTransfer") << "Cannot blend styles of different shapes";
+					return *styles.front();
+				}
+				inputs.push_back(data);
+			}
+			std::vector<float> mix(TF_TensorByteSize(inputs.front().get()) / sizeof(float), 0.f);
+			for(std::size_t i = 0; i < inputs.size(); i++) {
+				float weight = std::max(weights[i], 0.f) / total;
+				const float * values = (const float *)TF_TensorData(inputs[i].get());
+				for(std::size_t j = 0; j < mix.size(); j++) {
+					mix[j] += values[j] * weight;
+				}
+			}
+			Style style;
+			cppflow::tensor blended(mix, getStyleTensor(*styles.front()).shape());
+			if(usesStyleBottleneck()) {
+				style.bottleneck = blended;
+				style.hasBottleneck = true;
 			}
-			inputVector[1] = style;
+			else {
+				style.image = blended;
+			}
+			return style;
+		}
+
+		/// returns true if the model runs in a ModelSession, see loadNetwork(),
+		/// which has no background thread: update() blocks
+		bool usesSession() const {
+			std::shared_ptr<Network> current = getNetwork();
+			return current && current->session;
+		}
+
+		/// returns true if styles are applied as precomputed bottlenecks
+		bool usesStyleBottleneck() const {
+			std::shared_ptr<Network> current = getNetwork();
+			return current && current->split;
+		}
+
+		/// run the model on a 1xHxWx3 input tensor with the current style,
+		/// blocks until finished and returns the output tensor
+		///
+		/// may be called from other threads, ie. by StylePipeline, as long as
+		/// the background thread is not running
+		cppflow::tensor run(const cppflow::tensor & input) {
+			return run(input, getStyleTensor());
+		}
+
+		/// run the model on a NxHxWx3 input tensor with a style model input,
+		/// see getStyleTensor(), either batch 1 or one style per input image
+		cppflow::tensor run(const cppflow::tensor & input, const cppflow::tensor & style) {
+			// the network stays alive until this run is done, even if swapped
+			std::shared_ptr<Network> current = getNetwork();
+			return run(*current, input, style);
+		}
+
+		/// run a network loaded by loadNetwork() which is not necessarily
+		/// in use, ie. to compare precisions
+		cppflow::tensor run(Network & network, const cppflow::tensor & input, const cppflow::tensor & style) {
+			return tiling.run(input, [&](const cppflow::tensor & tiles) {
+				if(network.session) {
+					return network.session->run({tiles, batchStyle(style, tiles)});
+				}
+				return network.model.runMultiModel({tiles, batchStyle(style, tiles)})[0];
+			});
+		}
+
+		/// repeat a batch 1 style tensor along the batch dimension to match
+		/// the content batch
+		static cppflow::tensor batchStyle(const cppflow::tensor & style, const cppflow::tensor & content) {
+			std::vector<int64_t> shape = content.shape();
+			std::vector<int64_t> styleShape = style.shape();
+			if(shape.empty() || shape[0] <= 1 || styleShape.empty() || styleShape[0] == shape[0]) {
+				return style;
+			}
+			std::vector<int32_t> multiples(styleShape.size(), 1);
+			multiples[0] = (int32_t)shape[0];
+			return cppflow::tile(style, cppflow::tensor(multiples, {(int64_t)multiples.size()}));
+		}
+
+		/// current style model input: the style image or bottleneck,
+		/// thread-safe
+		cppflow::tensor getStyleTensor() {
+			std::lock_guard<std::mutex> lock(styleMutex);
+			return inputVector[1];
+		}
+
+		/// model input of a prepared style: the style image or bottleneck
+		cppflow::tensor getStyleTensor(const Style & style) const {
+			return (usesStyleBottleneck() ? style.bottleneck : style.image);
+		}
+
+		/// convert a float output tensor to 8 bit RGB pixels of the given
+		/// size, resizes as needed, returns false on an unexpected shape
+		static bool tensorToPixels(cppflow::tensor tensor, ofPixels & pixels, int width, int height) {
+			std::vector<int64_t> shape = tensor.shape(); // NHWC
+			if(shape.size() != 4 || shape[3] != 3) {
+				ofLogError("ofxStyleTransfer") << "Unexpected output tensor shape";
+				return false;
+			}
+			if(shape[2] != width || shape[1] != height) {
+				tensor = cppflow::resize_bicubic(tensor, cppflow::tensor({height, width}), true);
+			}
+			if(pixels.getWidth() != width || pixels.getHeight() != height || pixels.getNumChannels() != 3) {
+				pixels.allocate(width, height, OF_PIXELS_RGB);
+			}
+			// vectorized clamp & convert straight from the tensor buffer
+			std::shared_ptr<TF_Tensor> data = tensor.get_tensor();
+			PixelKernels::toUnsignedChar((const float *)TF_TensorData(data.get()),
+			                             pixels.getData(), pixels.size());
+			return true;
 		}
 
 		/// run model on current input, either synchronously by blocking until
 		/// finished or asynchronously if background thread is running
 		/// returns true if output image is new
 		bool update() {
+			if(!network) {
+				return false;
+			}
+			ofxTF2::ThreadedModel & model = network->model;
 			if(model.isThreadRunning()) {
 				// non-blocking
 				if(newInput && model.readyForInput()) {
@@ -192,11 +545,11 @@ class ofxStyleTransfer {
 					auto output = model.getOutputs();
 					if(sizeChanged) {
 						// reallocate for new input size
-						outputImage.allocate(size.width, size.height, OF_IMAGE_COLOR);
+						outputImage.allocate(getOutputWidth(), getOutputHeight(), OF_IMAGE_COLOR);
 						sizeChanged = false;
 					}
-					if(size.width != outputImage.getWidth() ||
-					   size.height != outputImage.getHeight()) {
+					if(getOutputWidth() != outputImage.getWidth() ||
+					   getOutputHeight() != outputImage.getHeight()) {
 						// change size in next output frame
 						sizeChanged = true;
 					}
@@ -212,12 +565,12 @@ class ofxStyleTransfer {
 			else {
 				// blocking
 				if(newInput) {
-					auto output = model.runMultiModel(inputVector);
+					cppflow::tensor output = run(inputVector[0]);
 					if(modelSize.width != outputImage.getWidth() ||
 					   modelSize.height != outputImage.getHeight()) {
-						resizeTensorToImage(output[0], outputImage);
+						resizeTensorToImage(output, outputImage);
 					}
-					floatTensorToImage(output[0], outputImage);
+					floatTensorToImage(output, outputImage);
 					outputImage.update();
 					newInput = false;
 					inputVector[0] = cppflow::tensor(0); // clear input image
@@ -245,19 +598,27 @@ class ofxStyleTransfer {
 			outputImage.draw(x, y, w, h);
 		}
 
-		/// start background thread processing
+		/// start background thread processing, not available if the model runs
+		/// in a ModelSession, see usesSession()
 		void startThread() {
 			sizeChanged = false; // reset change detection
-			model.startThread();
+			if(network && network->session) {
+				ofLogWarning("ofxStyleTransfer") << "No background thread for session models, update() blocks";
+			}
+			else if(network) {
+				network->model.startThread();
+			}
 		}
 
 		/// stop background thread processing
 		void stopThread() {
-			model.stopThread();
+			if(network) {
+				network->model.stopThread();
+			}
 		}
 
 		/// returns true if background thread is running
-		bool isThreadRunning() {return model.isThreadRunning();}
+		bool isThreadRunning() {return network && network->model.isThreadRunning();}
 
 		/// returns input width
 		/// note: output width may differ if setSize() called while model is
@@ -271,6 +632,40 @@ class ofxStyleTransfer {
 		///       check the outputImage size
 		int getHeight() {return size.height;}
 
+		/// keep outputs at width x height while setSize() changes the input &
+		/// model size, ie. for adaptive resolution, outputs are resized to it;
+		/// 0 follows setSize()
+		void setOutputSize(int width, int height) {
+			outputSize.width = std::max(width, 0);
+			outputSize.height = std::max(height, 0);
+			if(isThreadRunning() && network->model.readyForInput()) {
+				sizeChanged = true;
+			}
+		}
+
+		/// returns output width, the input width unless set by setOutputSize()
+		int getOutputWidth() {return (outputSize.width > 0 ? outputSize.width : size.width);}
+
+		/// returns output height, the input height unless set by setOutputSize()
+		int getOutputHeight() {return (outputSize.height > 0 ? outputSize.height : size.height);}
+
+		/// returns the loaded model path, the style transform network for
+		/// split models, use with getInputNames() & getOutputName() to load
+		/// additional sessions, ie. ModelSession
+		std::string getModelPath() const {return getNetwork()->transferPath;}
+
+		/// returns model input names: {content image, style}
+		std::vector<std::string> getInputNames() const {return getNetwork()->inputNames;}
+
+		/// returns model output name
+		std::string getOutputName() const {return getNetwork()->outputName;}
+
+		/// returns model input width, input width rounded up to a multiple of 32
+		int getModelWidth() {return modelSize.width;}
+
+		/// returns model input height, input height rounded up to a multiple of 32
+		int getModelHeight() {return modelSize.height;}
+
 		/// set new input size
 		void setSize(int width, int height) {
 			size.width = width;
@@ -282,7 +677,7 @@ class ofxStyleTransfer {
 			//		<< " not multiple(s) of 32, rounding up to "
 			//		<< modelSize.width << "x" << modelSize.height;
 			//}
-			if(model.isThreadRunning() && model.readyForInput()) {
+			if(isThreadRunning() && network->model.readyForInput()) {
 				// resize output image if not processing in background thread
 				sizeChanged = true;
 			}
@@ -294,41 +689,161 @@ class ofxStyleTransfer {
 		}
 
 	protected:
-		ofxTF2::ThreadedModel model;
+		/// model in use: replaced on the thread calling setup() & update()
+		/// under networkMutex, other threads read it with getNetwork()
+		std::shared_ptr<Network> network;
+		mutable std::mutex networkMutex;
+		std::atomic<uint64_t> generation{0}; ///< model changes
+
+		/// style prediction network output names
+		static std::vector<std::string> bottleneckOutputNameVariants() {
+			return {
+				"StatefulPartitionedCall",
+				"output_0",
+				"style_bottleneck",
+				"output"
+			};
+		}
+
+		/// set up model input & output names: from the cached binding next to
+		/// the model if its fingerprint still matches, otherwise from the
+		/// serving_default signature, falling back to trying the known name
+		/// variants; new bindings are cached, returns true on success
+		static bool bindModel(ofxTF2::Model & model, const std::string & path,
+		                      const std::vector<std::vector<std::string>> & inputNameVariants,
+		                      const std::vector<std::string> & outputNameVariants,
+		                      std::vector<std::string> & inputNames,
+		                      std::string & outputName) {
+			ModelBinding binding;
+			std::string fingerprint = ModelSignature::fingerprint(path);
+			if(binding.load(path, fingerprint) && setupNames(model, binding.inputNames, binding.outputName)) {
+				ofLogNotice("ofxStyleTransfer") << "Using cached binding " << ModelBinding::getCachePath(path);
+			}
+			else {
+				ModelSignature signature;
+				if(signature.read(path) && bindingFromSignature(signature, binding) &&
+				   setupNames(model, binding.inputNames, binding.outputName)) {
+					ofLogNotice("ofxStyleTransfer") << "Resolved names from the serving_default signature";
+				}
+				else if(!setupModelNames(model, inputNameVariants, outputNameVariants,
+				                         binding.inputNames, binding.outputName)) {
+					return false;
+				}
+				binding.fingerprint = fingerprint;
+				if(fingerprint.empty() || !binding.save(path)) {
+					ofLogWarning("ofxStyleTransfer") << "Could not cache binding for " << path;
+				}
+			}
+			ofLogNotice("ofxStyleTransfer") << "Model inputs: " << ofJoinString(binding.inputNames, ", ")
+				<< " | output: " << binding.outputName;
+			inputNames = binding.inputNames;
+			outputName = binding.outputName;
+			return true;
+		}
+
+		/// order signature inputs as the model is run: content image first,
+		/// then style image or bottleneck, otherwise by key, and use the first
+		/// output; returns false if the signature has no inputs or outputs
+		static bool bindingFromSignature(const ModelSignature & signature, ModelBinding & binding) {
+			auto rank = [](const ModelSignature::Tensor & tensor) {
+				if(tensor.key.find("content") != std::string::npos) {
+					return 0;
+				}
+				if(tensor.key.find("style") != std::string::npos ||
+				   tensor.key.find("bottleneck") != std::string::npos) {
+					return 2;
+				}
+				return 1;
+			};
+			std::vector<ModelSignature::Tensor> inputs = signature.getInputs();
+			std::stable_sort(inputs.begin(), inputs.end(), [&rank](const ModelSignature::Tensor & a,
+			                                                       const ModelSignature::Tensor & b) {
+				return rank(a) < rank(b);
+			});
+			binding.inputNames.clear();
+			for(auto & input : inputs) {
+				binding.inputNames.push_back(ModelSignature::operationName(input.name));
+			}
+			if(signature.getOutputs().empty() || binding.inputNames.empty()) {
+				return false;
+			}
+			binding.outputName = ModelSignature::operationName(signature.getOutputs().front().name);
+			return true;
+		}
+
+		/// set up model names, returns false if the model rejects them
+		static bool setupNames(ofxTF2::Model & model, const std::vector<std::string> & inputNames,
+		                       const std::string & outputName) {
+			try {
+				model.setup(inputNames, {outputName});
+				return true;
+			}
+			catch(const std::exception & e) {
+				ofLogWarning("ofxStyleTransfer") << "Model names rejected: " << e.what();
+				return false;
+			}
+		}
+
+		/// try input/output name combinations until model setup succeeds,
+		/// sets the working names and returns true on success
+		static bool setupModelNames(ofxTF2::Model & model,
+		                            const std::vector<std::vector<std::string>> & inputNameVariants,
+		                            const std::vector<std::string> & outputNameVariants,
+		                            std::vector<std::string> & inputNames,
+		                            std::string & outputName) {
+			bool setupSuccess = false;
+			std::string lastError = "";
+			
+			// Try each combination
+			for (const auto& inputVariant : inputNameVariants) {
+				std::string names = ofJoinString(inputVariant, ", ");
+				for (const auto& outputVariant : outputNameVariants) {
+					try {
+						ofLogNotice("ofxStyleTransfer") << "Trying input names: " 
+							<< names << " | output: " << outputVariant;
+						
+						model.setup(inputVariant, {outputVariant});
+						inputNames = inputVariant;
+						outputName = outputVariant;
+						setupSuccess = true;
+						
+						ofLogNotice("ofxStyleTransfer") << "✓ Successfully configured with inputs: " 
+							<< names << " | output: " << outputVariant;
+						break;
+					} catch (const std::exception& e) {
+						lastError = e.what();
+						ofLogWarning("ofxStyleTransfer") << "✗ Failed with inputs: " 
+							<< names << " | error: " << lastError;
+					}
+				}
+				if (setupSuccess) break;
+			}
+			
+			if (!setupSuccess) {
+				ofLogError("ofxStyleTransfer") << "Failed to setup model with any input/output combination. Last error: " << lastError;
+			}
+			return setupSuccess;
+		}
 
 		// convert ofPixels to a float image tensor
 		cppflow::tensor pixelsToFloatTensor(const ofPixels & pixels) {
-			// Ensure we have RGB format (3 channels) by creating a copy
-			ofPixels rgbPixels;
-			if(pixels.getNumChannels() == 4) {
-				// Convert RGBA to RGB
-				rgbPixels.allocate(pixels.getWidth(), pixels.getHeight(), OF_PIXELS_RGB);
-				for(size_t i = 0; i < pixels.getWidth() * pixels.getHeight(); i++) {
-					rgbPixels[i*3 + 0] = pixels[i*4 + 0]; // R
-					rgbPixels[i*3 + 1] = pixels[i*4 + 1]; // G
-					rgbPixels[i*3 + 2] = pixels[i*4 + 2]; // B
-					// Skip alpha channel
-				}
-			} else if(pixels.getNumChannels() == 3) {
-				// Already RGB, just copy
-				rgbPixels = pixels;
-			} else {
+			if(pixels.getNumChannels() != 3 && pixels.getNumChannels() != 4) {
 				ofLogError("ofxStyleTransfer") << "Unsupported pixel format with " << pixels.getNumChannels() << " channels";
 				return cppflow::tensor(0);
 			}
-			
-			auto t = ofxTF2::pixelsToTensor(rgbPixels);
-			t = cppflow::expand_dims(t, 0);
-			t = cppflow::cast(t, TF_UINT8, TF_FLOAT);
-			t = cppflow::mul(t, cppflow::tensor({1.0f / 255.f}));
-			return t;
+			// vectorized RGB(A) -> normalized RGB float, alpha is dropped
+			std::size_t count = pixels.getWidth() * pixels.getHeight();
+			std::vector<float> values(count * 3);
+			PixelKernels::toFloat(pixels.getData(), values.data(), count, PixelSpan(pixels).layout);
+			return cppflow::tensor(values, {1, (int64_t)pixels.getHeight(), (int64_t)pixels.getWidth(), 3});
 		}
 
 		// convert float image tensor to ofImage
-		void floatTensorToImage(cppflow::tensor tensor, ofImage & image) {
-			tensor = cppflow::mul(tensor, cppflow::tensor({255.f}));
-			tensor = cppflow::cast(tensor, TF_FLOAT, TF_UINT8);
-			ofxTF2::tensorToImage(tensor, image);
+		void floatTensorToImage(const cppflow::tensor & tensor, ofImage & image) {
+			std::vector<int64_t> shape = tensor.shape(); // NHWC
+			if(shape.size() == 4) {
+				tensorToPixels(tensor, image.getPixels(), shape[2], shape[1]);
+			}
 		}
 
 		// resize tensor to match ofImage
@@ -345,8 +860,12 @@ class ofxStyleTransfer {
 			int height = 1;
 		};
 		struct Size size; ///< pixel input (& output) size
+		struct Size outputSize = {0, 0}; ///< fixed output size, 0 follows size
 		struct Size modelSize; ///< pixel size for the model, multiples of 32
 		std::vector<cppflow::tensor> inputVector; // {input image, style image}
+		std::mutex styleMutex; ///< guards the style tensor for run()
+		TensorBufferPool inputBuffers; ///< input image tensor buffers
+		TiledInference tiling; ///< tiles for large inputs, disabled by default
 		ofImage outputImage; ///< output image
 		bool newInput = false; ///< is the input tensor new?
 
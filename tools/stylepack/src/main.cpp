@@ -0,0 +1,106 @@
+/*
+ * AI Dance Mirror
+ *
+ * Style pack precompiler: prepares every style image in a folder with
+ * ofxStyleTransfer and writes a single memory-mappable style pack.
+ */
+#include "ofMain.h"
+#include "ofxStyleTransfer.h"
+#include "StyleCache.h"
+#include "StylePack.h"
+
+void printUsage() {
+	std::cout << "Usage: stylepack [options] STYLE_FOLDER OUTPUT_PACK" << std::endl
+	          << "  --format f32|u8   entry data type, u8 for style images only" << std::endl
+	          << "                    (default f32)" << std::endl
+	          << "  --model DIR       split model folder, stores style bottlenecks" << std::endl
+	          << "                    instead of style images" << std::endl;
+}
+
+//========================================================================
+int main(int argc, char *argv[]) {
+	StylePackFormat::Type type = StylePackFormat::TYPE_FLOAT32;
+	std::string modelPath;
+	std::vector<std::string> paths;
+	for(int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if(arg == "--format" && i + 1 < argc) {
+			std::string format = argv[++i];
+			if(format == "u8") {
+				type = StylePackFormat::TYPE_UINT8;
+			}
+			else if(format != "f32") {
+				printUsage();
+				return EXIT_FAILURE;
+			}
+		}
+		else if(arg == "--model" && i + 1 < argc) {
+			modelPath = ofFilePath::getAbsolutePath(argv[++i], false);
+		}
+		else if(arg.size() > 0 && arg[0] != '-') {
+			paths.push_back(ofFilePath::getAbsolutePath(arg, false));
+		}
+		else {
+			printUsage();
+			return EXIT_FAILURE;
+		}
+	}
+	if(paths.size() != 2) {
+		printUsage();
+		return EXIT_FAILURE;
+	}
+
+	// style images are prepared exactly as the app does, the model is only
+	// needed to compute bottlenecks for split models
+	ofxStyleTransfer styleTransfer;
+	styleTransfer.setUseTexture(false); // no GL context
+	if(!modelPath.empty()) {
+		if(!styleTransfer.setup(ofxStyleTransfer::STYLE_W, ofxStyleTransfer::STYLE_H, modelPath)) {
+			return EXIT_FAILURE;
+		}
+		if(!styleTransfer.usesStyleBottleneck()) {
+			std::cout << "model is not a split model, storing style images" << std::endl;
+		}
+	}
+	StylePackFormat::Kind kind = (styleTransfer.usesStyleBottleneck() ?
+	                              StylePackFormat::KIND_BOTTLENECK : StylePackFormat::KIND_IMAGE);
+	if(!StylePackWriter::isSupported(kind, type)) {
+		// bottlenecks are unbounded & signed, 0-255 would destroy them
+		std::cout << "--format u8 can not store style bottlenecks, use f32" << std::endl;
+		return EXIT_FAILURE;
+	}
+	StylePackWriter writer(kind, type);
+
+	ofDirectory dir(paths[0]);
+	dir.allowExt("png");
+	dir.allowExt("jpg");
+	dir.allowExt("jpeg");
+	if(!dir.exists() || dir.listDir() == 0) {
+		std::cout << "no style images found in " << paths[0] << std::endl;
+		return EXIT_FAILURE;
+	}
+	dir.sort();
+	for(std::size_t i = 0; i < dir.size(); i++) {
+		std::string path = dir.getPath(i);
+		ofPixels pixels;
+		if(!ofLoadImage(pixels, path)) {
+			std::cout << "skipping " << path << ": failed to load" << std::endl;
+			continue;
+		}
+		if(pixels.getNumChannels() != 3) {
+			pixels.setImageType(OF_IMAGE_COLOR);
+		}
+		ofxStyleTransfer::Style style = styleTransfer.prepareStyle(pixels);
+		const cppflow::tensor & tensor = (style.hasBottleneck ? style.bottleneck : style.image);
+		if(writer.add(dir.getName(i), tensor, StyleCache::modificationTime(path))) {
+			std::cout << "added " << dir.getName(i) << std::endl;
+		}
+	}
+
+	if(writer.size() == 0 || !writer.write(paths[1])) {
+		std::cout << "failed to write " << paths[1] << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << "wrote " << writer.size() << " styles to " << paths[1] << std::endl;
+	return EXIT_SUCCESS;
+}